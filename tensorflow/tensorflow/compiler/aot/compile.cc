@@ -86,7 +86,8 @@ Status CompileXla(xla::CompileOnlyClient* client,
  *        Convert graph definition to object file that include graph's function
  * 1. [TODO] Fiddling about client
  * 2. Call `ConvertGraphDefToXla`
- * 3. `CompileXLA`
+ * 3. Set `max_parallelism` from `flags` so multi-threaded AOT can be requested
+ * 4. `CompileXLA`
  */
 Status CompileGraph(const GraphDef& graph_def, const tf2xla::Config& config,
                     const MainFlags& flags, CompileResult* compile_result) {
@@ -116,6 +117,11 @@ Status CompileGraph(const GraphDef& graph_def, const tf2xla::Config& config,
       flags.target_triple, flags.target_cpu, flags.target_features,
       flags.entry_point,
       xla::cpu::CpuAotCompilationOptions::RelocationModel::BigPic);
+  if (flags.max_parallelism < 1) {
+    return errors::InvalidArgument("max_parallelism must be at least 1, got ",
+                                   flags.max_parallelism);
+  }
+  aot_opts.set_max_parallelism(flags.max_parallelism);
   return CompileXla(client, computation, aot_opts, compile_result);
 }
 }  // namespace tfcompile
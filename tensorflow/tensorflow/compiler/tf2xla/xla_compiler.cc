@@ -112,8 +112,30 @@ XlaCompiler::~XlaCompiler() = default;
 int64 XlaCompiler::NextStepId() { return next_step_id_++; }
 
 uint64 XlaCompiler::SignatureHash::operator()(
-    const std::pair<string, std::vector<Argument>>& signature) const {
-  return std::hash<string>()(signature.first);
+    const Signature& signature) const {
+  uint64 h = Hash64(signature.first);
+  for (const Argument& arg : signature.second) {
+    h = Hash64Combine(h, static_cast<uint64>(arg.kind));
+    h = Hash64Combine(h, static_cast<uint64>(arg.type));
+    h = Hash64Combine(h, static_cast<uint64>(arg.resource_kind));
+    h = Hash64Combine(h, arg.initialized);
+    h = Hash64Combine(h, static_cast<uint64>(arg.tensor_array_size));
+    h = Hash64Combine(h, Hash64(arg.name));
+    for (int64 dim : arg.shape.dim_sizes()) {
+      h = Hash64Combine(h, static_cast<uint64>(dim));
+    }
+    for (const string& gradient : arg.tensor_array_gradients) {
+      h = Hash64Combine(h, Hash64(gradient));
+    }
+    if (arg.kind == Argument::kConstant) {
+      for (int64 dim : arg.constant_value.shape().dim_sizes()) {
+        h = Hash64Combine(h, static_cast<uint64>(dim));
+      }
+      const StringPiece data = arg.constant_value.tensor_data();
+      h = Hash64Combine(h, Hash64(data.data(), data.size()));
+    }
+  }
+  return h;
 }
 
 static Status GetFunctionBody(const NameAttrList& function,
@@ -170,9 +192,13 @@ Status XlaCompiler::CompileFunction(const XlaCompiler::CompileOptions& options,
 
   auto it = cache_.find({function_id, args});
   if (it != cache_.end()) {
-    *result = it->second;
+    ++function_cache_stats_.hits;
+    function_cache_lru_.splice(function_cache_lru_.begin(),
+                               function_cache_lru_, it->second);
+    *result = it->second->second;
     return Status::OK();
   }
+  ++function_cache_stats_.misses;
 
   const FunctionBody* fbody;
   TF_RETURN_IF_ERROR(FindFunctionBody(function, &fbody));
@@ -214,7 +240,15 @@ Status XlaCompiler::CompileFunction(const XlaCompiler::CompileOptions& options,
       CompileGraph(options, function_id, std::move(graph), args, result));
   VLOG(1) << "====================================================";
 
-  cache_[{function_id, args}] = *result;
+  Signature signature(function_id, std::move(args));
+  function_cache_lru_.emplace_front(signature, *result);
+  cache_[std::move(signature)] = function_cache_lru_.begin();
+  const int64 capacity = options_.function_cache_capacity;
+  while (capacity > 0 && static_cast<int64>(cache_.size()) > capacity) {
+    cache_.erase(function_cache_lru_.back().first);
+    function_cache_lru_.pop_back();
+    ++function_cache_stats_.evictions;
+  }
   return Status::OK();
 }
 
@@ -18,6 +18,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_TF2XLA_XLA_COMPILER_H_
 #define TENSORFLOW_COMPILER_TF2XLA_XLA_COMPILER_H_
 
+#include <list>
+
 #include "tensorflow/compiler/tf2xla/host_compute_metadata.pb.h"
 #include "tensorflow/compiler/tf2xla/xla_compilation_device.h"
 #include "tensorflow/compiler/xla/client/local_client.h"
@@ -275,6 +277,23 @@ class XlaCompiler {
     // allocate most or all available memory on the device, leaving none for the
     // compiler to access, unless it can use TensorFlow's allocator.
     xla::DeviceMemoryAllocator* device_allocator = nullptr;
+
+    // Maximum number of CompileFunction() results to keep, keyed on the
+    // function and its arguments. When the cache is full, the least recently
+    // used entry is evicted. Zero means the cache is unbounded.
+    int64 function_cache_capacity = 0;
+  };
+
+  // Counters for the CompileFunction() result cache.
+  struct FunctionCacheStats {
+    // Calls to CompileFunction() answered from the cache.
+    int64 hits = 0;
+
+    // Calls to CompileFunction() that had to compile the function.
+    int64 misses = 0;
+
+    // Entries dropped to stay within `function_cache_capacity`.
+    int64 evictions = 0;
   };
 
   explicit XlaCompiler(Options options);
@@ -333,6 +352,12 @@ class XlaCompiler {
   xla::Client* client() const { return options_.client; }
   FunctionLibraryRuntime* flib_runtime() const { return flib_runtime_; }
 
+  const FunctionCacheStats& function_cache_stats() const {
+    return function_cache_stats_;
+  }
+  // Number of CompileFunction() results currently cached.
+  int64 function_cache_size() const { return cache_.size(); }
+
  private:
   // Sets the function body `fbody` to the one registered as `function`.
   Status FindFunctionBody(const NameAttrList& function,
@@ -381,14 +406,22 @@ class XlaCompiler {
   FunctionLibraryRuntime* local_flib_runtime_;  // owned by local_pflr_.
   FunctionLibraryRuntime* flib_runtime_;        // owned by pflr_.
 
+  // A function (canonicalized with its attributes) together with the
+  // arguments it was compiled for.
+  using Signature = std::pair<string, std::vector<Argument>>;
+
+  // Hashes everything Argument::operator== compares, so that argument-shape
+  // and constant-value variants of one function land in distinct buckets.
   struct SignatureHash {
-    uint64 operator()(
-        const std::pair<string, std::vector<Argument>>& signature) const;
+    uint64 operator()(const Signature& signature) const;
   };
 
-  std::unordered_map<std::pair<string, std::vector<Argument>>,
-                     CompilationResult, SignatureHash>
+  // Cached results, most recently used first. `cache_` indexes into it.
+  using FunctionCacheList = std::list<std::pair<Signature, CompilationResult>>;
+  FunctionCacheList function_cache_lru_;
+  std::unordered_map<Signature, FunctionCacheList::iterator, SignatureHash>
       cache_;
+  FunctionCacheStats function_cache_stats_;
 
   std::unordered_map<string, xla::ChannelHandle> channels_;
 
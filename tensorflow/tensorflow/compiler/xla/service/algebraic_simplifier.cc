@@ -1902,20 +1902,11 @@ Status AlgebraicSimplifierVisitor::HandleMinimum(HloInstruction* minimum) {
   }
   return Status::OK();
 }
-StatusOr<bool> AlgebraicSimplifier::Run(HloModule* module) {
-  XLA_VLOG_LINES(2,
-                 "AlgebraicSimplifier::Run(), before:\n" + module->ToString());
-  bool changed = false;
-  for (auto* comp : module->MakeNonfusionComputations()) {
-    if (AlgebraicSimplifierVisitor::Run(
-            comp, is_layout_sensitive_, valid_bitcast_callback_,
-            enable_dot_strength_reduction_, enable_conv_simplification_)) {
-      changed = true;
-    }
-  }
-  XLA_VLOG_LINES(2,
-                 "AlgebraicSimplifier::Run(), after:\n" + module->ToString());
-  return changed;
+StatusOr<bool> AlgebraicSimplifier::RunOnComputation(
+    HloComputation* computation) {
+  return AlgebraicSimplifierVisitor::Run(
+      computation, is_layout_sensitive_, valid_bitcast_callback_,
+      enable_dot_strength_reduction_, enable_conv_simplification_);
 }
 }  // namespace xla
 
@@ -15,12 +15,12 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_ALGEBRAIC_SIMPLIFIER_H_
 #include <utility>
 #include "tensorflow/compiler/xla/service/hlo_module.h"
-#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/service/hlo_computation_pass.h"
 namespace xla {
 /** As the class name says
  * \todo Contains lots of code including broadcast sementics
  */
-class AlgebraicSimplifier : public HloPassInterface {
+class AlgebraicSimplifier : public HloComputationPass {
  public:
   // Given shapes 'from_shape' and 'to_shape', determines if it is valid to
   // bitcast from 'from_shape' to 'to_shape' after considering platform
@@ -48,7 +48,7 @@ class AlgebraicSimplifier : public HloPassInterface {
   tensorflow::StringPiece name() const override { return "algsimp"; }
   // Run algebraic simplification on the given computation. Returns whether the
   // computation was changed.
-  StatusOr<bool> Run(HloModule* module) override;
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
  private:
   bool is_layout_sensitive_;
   ValidBitcastCallback valid_bitcast_callback_;
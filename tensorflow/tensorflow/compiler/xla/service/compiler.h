@@ -24,8 +24,10 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_module_config.h"
 #include "tensorflow/compiler/xla/service/logical_buffer.h"
+#include "tensorflow/compiler/xla/service/versioned_computation_handle.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/stream_executor_no_cuda.h"
@@ -140,6 +142,35 @@ class Compiler {
   virtual StatusOr<std::vector<std::unique_ptr<AotCompilationResult>>>
   CompileAheadOfTime(std::vector<std::unique_ptr<HloModule>> modules,
                      const AotCompilationOptions& options) = 0;
+  // Returns a string identifying the code this compiler would generate for
+  // the device given by the executor, e.g. the target triple, CPU model and
+  // feature set.  Executables serialized under one target fingerprint must not
+  // be deserialized under another.  Used to key the persistent compilation
+  // cache.
+  virtual StatusOr<string> TargetFingerprint(
+      const HloModuleConfig& module_config,
+      perftools::gputools::StreamExecutor* executor) const {
+    return Unimplemented("TargetFingerprint is not supported on this platform");
+  }
+  // Serializes an executable returned by RunBackend so that it can be
+  // restored by DeserializeExecutable in another process without re-running
+  // HLO passes or code generation.  Compilers which cannot do this (or cannot
+  // do it for this particular executable) return an error, in which case the
+  // executable is simply not cached.
+  virtual StatusOr<string> SerializeExecutable(const Executable& executable) {
+    return Unimplemented(
+        "SerializeExecutable is not supported on this platform");
+  }
+  // Restores an executable from the output of SerializeExecutable.
+  // 'module_config' and 'entry_computation_handle' describe the computation
+  // the executable was originally built for, as passed to RunHloPasses.
+  virtual StatusOr<std::unique_ptr<Executable>> DeserializeExecutable(
+      const string& serialized, const HloModuleConfig& module_config,
+      const VersionedComputationHandle& entry_computation_handle,
+      perftools::gputools::StreamExecutor* executor) {
+    return Unimplemented(
+        "DeserializeExecutable is not supported on this platform");
+  }
   /////
   // The Compiler class also serves as a point to register compiler objects
   // for the various platforms.
@@ -0,0 +1,153 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/batch_dot_emitter.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_batch_matmul.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+
+namespace xla {
+namespace cpu {
+
+bool PotentiallyImplementedAsEigenBatchDot(const HloInstruction& dot) {
+  if (dot.opcode() != HloOpcode::kDot) {
+    return false;
+  }
+  const DotDimensionNumbers& dnums = dot.dot_dimension_numbers();
+  const int64 num_batch_dims = dnums.lhs_batch_dimensions_size();
+  if (num_batch_dims == 0 ||
+      dnums.rhs_batch_dimensions_size() != num_batch_dims) {
+    return false;
+  }
+
+  const Shape& lhs_shape = dot.operand(0)->shape();
+  const Shape& rhs_shape = dot.operand(1)->shape();
+  const PrimitiveType type = dot.shape().element_type();
+  if ((type != F32 && type != F64) || lhs_shape.element_type() != type ||
+      rhs_shape.element_type() != type) {
+    return false;
+  }
+
+  // Each batch element must be a contiguous matrix, so the batch dimensions
+  // have to be the leading dimensions of both operands, in order.
+  if (ShapeUtil::Rank(lhs_shape) != num_batch_dims + 2 ||
+      ShapeUtil::Rank(rhs_shape) != num_batch_dims + 2) {
+    return false;
+  }
+  for (int64 i = 0; i < num_batch_dims; ++i) {
+    if (dnums.lhs_batch_dimensions(i) != i ||
+        dnums.rhs_batch_dimensions(i) != i) {
+      return false;
+    }
+  }
+
+  if (dnums.lhs_contracting_dimensions_size() != 1 ||
+      dnums.rhs_contracting_dimensions_size() != 1) {
+    return false;
+  }
+  const int64 lhs_contracting_dim = dnums.lhs_contracting_dimensions(0);
+  const int64 rhs_contracting_dim = dnums.rhs_contracting_dimensions(0);
+  return lhs_contracting_dim >= num_batch_dims &&
+         rhs_contracting_dim >= num_batch_dims &&
+         !ShapeUtil::HasZeroElements(dot.shape());
+}
+
+Status EmitBatchDotOperation(const HloInstruction& dot,
+                             const llvm_ir::IrArray& target_array,
+                             const llvm_ir::IrArray& lhs_array,
+                             const llvm_ir::IrArray& rhs_array,
+                             llvm::Value* executable_run_options_value,
+                             llvm::IRBuilder<>* ir_builder,
+                             const HloModuleConfig& hlo_module_config) {
+  TF_RET_CHECK(PotentiallyImplementedAsEigenBatchDot(dot));
+  const Shape& lhs_shape = dot.operand(0)->shape();
+  const Shape& rhs_shape = dot.operand(1)->shape();
+  const Shape& dot_shape = dot.shape();
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(lhs_shape.layout()));
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(rhs_shape.layout()));
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(dot_shape.layout()));
+
+  const DotDimensionNumbers& dnums = dot.dot_dimension_numbers();
+  const int64 num_batch_dims = dnums.lhs_batch_dimensions_size();
+  int64 batch = 1;
+  for (int64 i = 0; i < num_batch_dims; ++i) {
+    batch *= dot_shape.dimensions(i);
+  }
+  const int64 m = dot_shape.dimensions(num_batch_dims);
+  const int64 n = dot_shape.dimensions(num_batch_dims + 1);
+  const int64 k = lhs_shape.dimensions(dnums.lhs_contracting_dimensions(0));
+  // The operands are [..., m, k] and [..., k, n] unless their contracting
+  // dimension says otherwise.
+  const bool transpose_lhs =
+      dnums.lhs_contracting_dimensions(0) == num_batch_dims;
+  const bool transpose_rhs =
+      dnums.rhs_contracting_dimensions(0) == num_batch_dims + 1;
+
+  const PrimitiveType type = dot_shape.element_type();
+  const bool multi_threaded_eigen =
+      hlo_module_config.debug_options().xla_cpu_multi_thread_eigen();
+  const char* fn_name;
+  llvm::Type* float_type;
+  if (type == F32) {
+    fn_name = multi_threaded_eigen
+                  ? runtime::kEigenBatchMatMulF32SymbolName
+                  : runtime::kEigenSingleThreadedBatchMatMulF32SymbolName;
+    float_type = ir_builder->getFloatTy();
+  } else {
+    fn_name = multi_threaded_eigen
+                  ? runtime::kEigenBatchMatMulF64SymbolName
+                  : runtime::kEigenSingleThreadedBatchMatMulF64SymbolName;
+    float_type = ir_builder->getDoubleTy();
+  }
+
+  llvm::Module* module = ir_builder->GetInsertBlock()->getModule();
+  llvm::Type* float_ptr_type = float_type->getPointerTo();
+  llvm::Type* int64_type = ir_builder->getInt64Ty();
+  llvm::Type* int32_type = ir_builder->getInt32Ty();
+  llvm::Type* int8_ptr_type = ir_builder->getInt8Ty()->getPointerTo();
+  llvm::FunctionType* batch_matmul_type = llvm::FunctionType::get(
+      ir_builder->getVoidTy(),
+      {int8_ptr_type, float_ptr_type, float_ptr_type, float_ptr_type,
+       int64_type, int64_type, int64_type, int64_type, int32_type, int32_type},
+      /*isVarArg=*/false);
+  llvm::Function* batch_matmul_func = llvm::cast<llvm::Function>(
+      module->getOrInsertFunction(fn_name, batch_matmul_type));
+  batch_matmul_func->setCallingConv(llvm::CallingConv::C);
+  batch_matmul_func->setDoesNotThrow();
+  batch_matmul_func->setOnlyAccessesArgMemory();
+
+  ir_builder->CreateCall(
+      batch_matmul_func,
+      {ir_builder->CreateBitCast(executable_run_options_value, int8_ptr_type),
+       ir_builder->CreateBitCast(target_array.GetBasePointer(),
+                                 float_ptr_type),
+       ir_builder->CreateBitCast(lhs_array.GetBasePointer(), float_ptr_type),
+       ir_builder->CreateBitCast(rhs_array.GetBasePointer(), float_ptr_type),
+       ir_builder->getInt64(batch), ir_builder->getInt64(m),
+       ir_builder->getInt64(n), ir_builder->getInt64(k),
+       ir_builder->getInt32(transpose_lhs),
+       ir_builder->getInt32(transpose_rhs)});
+  return Status::OK();
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,59 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_BATCH_DOT_EMITTER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_BATCH_DOT_EMITTER_H_
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Value.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/ir_array.h"
+#include "tensorflow/compiler/xla/status.h"
+
+namespace xla {
+namespace cpu {
+
+/**
+ * Returns true if 'dot' is a kDot with batch dimensions that can be lowered to
+ * a single call into the batched GEMM runtime (runtime_batch_matmul.h):
+ * F32 or F64 operands, the batch dimensions are the leading dimensions of
+ * both operands in the same order, and each operand has exactly one
+ * contracting and one non-contracting dimension after them.
+ *
+ * Batch dots for which this returns false are left to DotDecomposer.
+ */
+bool PotentiallyImplementedAsEigenBatchDot(const HloInstruction& dot);
+
+/**
+ * Emits a call to the batched GEMM runtime computing 'dot' into
+ * 'target_array'.  All of 'dot' and its operands must have row-major layouts;
+ * CpuLayoutAssignment sets these up for every batch dot accepted by
+ * PotentiallyImplementedAsEigenBatchDot.
+ */
+Status EmitBatchDotOperation(const HloInstruction& dot,
+                             const llvm_ir::IrArray& target_array,
+                             const llvm_ir::IrArray& lhs_array,
+                             const llvm_ir::IrArray& rhs_array,
+                             llvm::Value* executable_run_options_value,
+                             llvm::IRBuilder<>* ir_builder,
+                             const HloModuleConfig& hlo_module_config);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_BATCH_DOT_EMITTER_H_
@@ -14,6 +14,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/cpu_compiler.h"
 #include <stddef.h>
 #include <string.h>
+#include <algorithm>
 #include <map>
 #include <mutex>  // NOLINT(build/c++11): only using std::call_once, not mutex.
 #include <string>
@@ -22,14 +23,18 @@ limitations under the License.
 #include <vector>
 // IWYU pragma: no_include "llvm/Config/Disassemblers.def.inc"
 // IWYU pragma: no_include "llvm/Config/Targets.def.inc"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
@@ -44,6 +49,8 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/buffer_liveness.h"
 #include "tensorflow/compiler/xla/service/call_inliner.h"
 #include "tensorflow/compiler/xla/service/conditional_simplifier.h"
+#include "tensorflow/compiler/xla/service/cpu/batch_dot_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/cached_executable.pb.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/service/cpu/conv_canonicalization.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_copy_insertion.h"
@@ -53,12 +60,16 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/cpu_layout_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_parallelization_preparation.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_rematerialization.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/disassembler.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelization.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_cpu_executable.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_aot_fork_join.h"
 #include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
 #include "tensorflow/compiler/xla/service/dfs_hlo_visitor_with_default.h"
 #include "tensorflow/compiler/xla/service/dot_decomposer.h"
@@ -87,12 +98,14 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/tuple_simplifier.h"
 #include "tensorflow/compiler/xla/service/while_loop_invariant_code_motion.h"
 #include "tensorflow/compiler/xla/service/while_loop_simplifier.h"
+#include "tensorflow/compiler/xla/service/xfeed_ring.h"
 #include "tensorflow/compiler/xla/service/zero_sized_hlo_elimination.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 namespace se = ::perftools::gputools;
@@ -146,6 +159,14 @@ CpuCompiler::CpuCompiler() {
   LLVMInitializeAArch64Disassembler();
 }
 namespace {
+// Align buffers to 16-byte boundaries.
+constexpr int64 kMemoryAlignment = 16;
+auto memory_alignment = [](LogicalBuffer::Color) { return kMemoryAlignment; };
+// Buffer assignment packs all temporaries of the sequential backend into one
+// allocation, so schedules are compared by their packed, aligned heap size.
+MemorySchedulerAlgorithm CpuMemoryScheduler() {
+  return FragmentationAwareMemoryScheduler(kMemoryAlignment);
+}
 // LLVM makes certain options configurable only through its command-line
 // options; it provide the ParseCommandLineOptions function that lets us set
 // flags at runtime. However, since these flags are global we want to avoid
@@ -242,7 +263,7 @@ class CollectProfileCandidates : public DfsHloVisitorWithDefault {
  * 3. Add pass `xla::CpuHloSupportChecker`
  * 4. Set `xla::ReducePrecisionInsertion::PassTiming` to `BEFORE_OPTIMIZATION` and add pass
  * 5. Add pass `xla::CallInliner`
- * 6. Add pass `xla::DotDecomposer`
+ * 6. Add pass `xla::DotDecomposer` for the batch dots `xla::cpu::PotentiallyImplementedAsEigenBatchDot` rejects
  * 7. Add pass `xla::cpu::ConvCanonicalization`
  * 8. Add pass `xla::HloPassFix<xla::HloPassPipeline>("simplification")`
  *   1. Add invariant checker `xla::HloVerifier`
@@ -277,17 +298,21 @@ class CollectProfileCandidates : public DfsHloVisitorWithDefault {
  * 16. Add pass `xla::HloElementTypeConverter` to convert type `BF16` to `F32`
  * 17. Set `max_parallelism` to outline ops in the entry computation into subcomputations
  * 18. If parallel backend is requested then add pass `xla::cpu::ParallelizationPreparation`
- * 19. If `is_aot_compile` is false then add pass `xla::cpu::ParallelTaskAssigner` but `is_aot_compile` is always true in this case
+ * 19. If `is_aot_compile` is false then add pass `xla::cpu::ParallelTaskAssigner` with `max_parallelism`. For AOT the pass is only added when `aot_max_parallelism` (from `xla::cpu::CpuAotCompilationOptions::max_parallelism()`) is greater than 1
  * 20. Add pass `xla::HloDCE`
  * 21. Add pass `xla::FlattenCallGraph`
  * 22. Add pass `xla::CpuCopyInsertion`
  * 23. Re-run outlining if parallel backend is requested, in case any copies were inserted into entry computation
  *   1. Add pass `xla::cpu::ParallelizationPreparation`
  *   2. Add pass `xla::CpuCopyInsertion`
+ *
+ *   Otherwise add pass `xla::cpu::CpuRematerialization`, which only acts if the `xla_cpu_memory_limit_bytes` debug option sets a memory limit.
+ *   Then, if inter-op parallelism is requested (see `xla::cpu::InterOpParallelismRequested`) and `is_aot_compile` is false, add pass `xla::cpu::InterOpParallelization`
  * 24. Add pass `xla::HloDCE`
  * 25. Start the process by calling `xla::HloPassPipeline::Run`
  */
-Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile) {
+Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile,
+                                 int64 aot_max_parallelism) {
   // Optimization pipeline.
   HloPassPipeline pipeline("CPU");
   pipeline.AddInvariantChecker<HloVerifier>();
@@ -301,7 +326,12 @@ Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile) {
   // TODO(b/65775800): Fix wrong output bug in Call and remove the CallInliner
   // pass.
   pipeline.AddPass<CallInliner>();
-  pipeline.AddPass<DotDecomposer>();
+  // Batch dots the batched GEMM runtime can take directly are kept intact;
+  // only the remaining ones are split into per-batch R2 dots.
+  pipeline.AddPass<DotDecomposer>(
+      /*decompose_batch_dot=*/true, [](const HloInstruction& dot) {
+        return !PotentiallyImplementedAsEigenBatchDot(dot);
+      });
   pipeline.AddPass<ConvCanonicalization>();
   {
     auto& pass =
@@ -361,12 +391,16 @@ Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile) {
                                                  ShapeSizeBytesFunction());
   } else if (!is_aot_compile) {
     // Run ParallelTaskAssigner to assign parallel tasks to HLOs in module.
-    // Note this is not run for AOT because it would bring in thread pool
-    // and thread synchronization dependencies which would likely increase
-    // binary size (and most AOT applications are single-threaded).
-    // TODO(b/29630486) Support multi-threaded AOT.
     pipeline.AddPass<ParallelTaskAssigner>(max_parallelism,
                                            ShapeSizeBytesFunction());
+  } else if (aot_max_parallelism > 1) {
+    // Multi-threaded AOT is opt-in: most AOT applications are single-threaded
+    // and the target machine is unknown here, so the caller chooses the
+    // parallelism.  Partitioned HLOs are lowered to calls into the small
+    // fork-join runtime in runtime_aot_fork_join.h rather than the Eigen
+    // thread pool, which keeps the generated object's dependencies minimal.
+    pipeline.AddPass<ParallelTaskAssigner>(aot_max_parallelism,
+                                           ShapeSizeBytesFunction());
   }
   // Copy insertion should be performed immediately before IR emission to avoid
   // inserting unnecessary copies (later pass adds an instruction which
@@ -383,14 +417,20 @@ Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile) {
     pipeline.AddPass<ParallelizationPreparation>(max_parallelism,
                                                  ShapeSizeBytesFunction());
     pipeline.AddPass<CpuCopyInsertion>();
+  } else {
+    // Runs after copy insertion, since the copies change the schedule the
+    // backend will pick.
+    pipeline.AddPass<CpuRematerialization>(
+        ShapeSizeBytesFunction(), CpuMemoryScheduler(), kMemoryAlignment);
+    if (!is_aot_compile && InterOpParallelismRequested(module->config())) {
+      // Outlining keeps every logical buffer, so no further copies are needed.
+      pipeline.AddPass<InterOpParallelization>();
+    }
   }
   pipeline.AddPass<HloDCE>();
   return pipeline.Run(module).status();
 }
 namespace {
-// Align buffers to 16-byte boundaries.
-constexpr int64 kMemoryAlignment = 16;
-auto memory_alignment = [](LogicalBuffer::Color) { return kMemoryAlignment; };
 llvm::TargetOptions CompilerTargetOptions(
     const HloModuleConfig& module_config) {
   llvm::TargetOptions target_options;
@@ -473,6 +513,45 @@ Status VerifyLlvmModule(const llvm::Module& llvm_module) {
          "Rerun with --xla_dump_ir_to to get the IR. ";
   return Status::OK();
 }
+/**
+ * Creates the host xfeed rings if the xla_cpu_xfeed_ring_slots debug option
+ * asks for them, before any code emitted against them can run.  If 'module'
+ * has infeeds or outfeeds, also records whether its code reads the rings or
+ * XfeedManager, which decides where the service sends host transfers.
+ */
+Status ConfigureXfeedRings(const HloModule& module) {
+  const DebugOptions& debug_options = module.config().debug_options();
+  const bool uses_rings = debug_options.xla_cpu_xfeed_ring_slots() > 0;
+  if (uses_rings) {
+    TF_RETURN_IF_ERROR(XfeedRing::ConfigureHostRings(
+        debug_options.xla_cpu_xfeed_ring_slots(),
+        debug_options.xla_cpu_xfeed_ring_slot_bytes()));
+  }
+  for (const HloComputation* computation : module.computations()) {
+    for (const HloInstruction* instruction : computation->instructions()) {
+      if (instruction->opcode() == HloOpcode::kInfeed ||
+          instruction->opcode() == HloOpcode::kOutfeed) {
+        return XfeedRing::RegisterHostXfeedUser(uses_rings);
+      }
+    }
+  }
+  return Status::OK();
+}
+/**
+ * Returns the ordering under which the sequential backend assigns buffers.
+ * With inter-op parallelism the top-level tasks run in any order their
+ * dependencies allow, so, as for the parallel backend, buffers may only be
+ * shared between instructions ordered by a dependency.  'module_sequence' is
+ * still the order in which each computation is emitted.
+ */
+std::unique_ptr<HloOrdering> MakeBufferAssignmentOrdering(
+    const HloModule* module,
+    const SequentialHloOrdering::HloModuleSequence& module_sequence) {
+  if (InterOpParallelismRequested(module->config())) {
+    return xla::MakeUnique<DependencyHloOrdering>(module);
+  }
+  return xla::MakeUnique<SequentialHloOrdering>(module, module_sequence);
+}
 }  // namespace
 StatusOr<std::unique_ptr<HloModule>> CpuCompiler::RunHloPasses(
     std::unique_ptr<HloModule> module,
@@ -480,7 +559,8 @@ StatusOr<std::unique_ptr<HloModule>> CpuCompiler::RunHloPasses(
     DeviceMemoryAllocator* /*device_allocator*/) {
   VLOG(2) << "Before optimization:";
   XLA_VLOG_LINES(2, module->ToString());
-  TF_RETURN_IF_ERROR(RunHloPasses(module.get(), /*is_aot_compile=*/false));
+  TF_RETURN_IF_ERROR(RunHloPasses(module.get(), /*is_aot_compile=*/false,
+                                  /*aot_max_parallelism=*/1));
   VLOG(2) << "After optimization:";
   XLA_VLOG_LINES(2, module->ToString());
   return std::move(module);
@@ -496,6 +576,7 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   TF_RET_CHECK(stream_exec != nullptr);
   std::call_once(llvm_command_line_options_initialized,
                  &llvm_ir::InitializeLLVMCommandLineOptions, module->config());
+  TF_RETURN_IF_ERROR(ConfigureXfeedRings(*module));
   ModuleHook pre_optimization_ir_hook;
   ModuleHook post_optimization_ir_hook;
   TF_RETURN_IF_ERROR(InitializeModuleHooks(
@@ -547,6 +628,15 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
       module->config().debug_options().xla_embed_ir_in_executable();
   const string xla_dump_optimized_hlo_proto_to =
       module->config().debug_options().xla_dump_optimized_hlo_proto_to();
+  // Executables that may be written to the persistent compilation cache keep a
+  // copy of their object code.  Profiled executables are not cached, since
+  // their profile printer data is not serialized.
+  const bool keep_object_file =
+      !module->config()
+           .debug_options()
+           .xla_persistent_compilation_cache_dir()
+           .empty() &&
+      !module->config().hlo_profiling_enabled();
   if (options::CpuParallelBackendRequested(module->config())) {
     VLOG(1) << "Using parallel cpu backend";
     // Run buffer analysis on the HLO graph. This analysis figures out which
@@ -651,15 +741,16 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
     // and reduced memory usage (as compared to using DependencyHloOrdering).
     TF_ASSIGN_OR_RETURN(
         SequentialHloOrdering::HloModuleSequence module_sequence,
-        CreateMemoryMinimizingSequence(*module, BufferSizeBytesFunction()));
+        CreateMemoryMinimizingSequence(*module, BufferSizeBytesFunction(),
+                                       CpuMemoryScheduler()));
     // Run buffer analysis on the HLO graph. This analysis figures out which
     // temporary buffers are required to run the computation.
     TF_ASSIGN_OR_RETURN(
         std::unique_ptr<BufferAssignment> assignment,
-        BufferAssigner::Run(module.get(),
-                            xla::MakeUnique<SequentialHloOrdering>(
-                                module.get(), module_sequence),
-                            BufferSizeBytesFunction(), memory_alignment));
+        BufferAssigner::Run(
+            module.get(),
+            MakeBufferAssignmentOrdering(module.get(), module_sequence),
+            BufferSizeBytesFunction(), memory_alignment));
     // BufferAssignment::ToString() includes a header, so no need for us to
     // print one ourselves.
     XLA_VLOG_LINES(2, assignment->ToString());
@@ -672,10 +763,14 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
     // before the entry computation. The order of computations returned from
     // GetEmbeddedComputations guarantees that a called computation occurs
     // before a caller computation.
-    IrEmitter ir_emitter(*module, *assignment, llvm_module.get(),
-                         std::move(instruction_to_profile_idx),
-                         std::move(computation_to_profile_idx),
-                         jit->target_machine(), jit->external_constant_pool());
+    //
+    // A kept object file must be self-contained, so its constants are emitted
+    // as globals instead of into the JIT's external constant pool.
+    IrEmitter ir_emitter(
+        *module, *assignment, llvm_module.get(),
+        std::move(instruction_to_profile_idx),
+        std::move(computation_to_profile_idx), jit->target_machine(),
+        keep_object_file ? nullptr : jit->external_constant_pool());
     for (auto embedded_computation :
          entry_computation->MakeEmbeddedComputationsList()) {
       if (embedded_computation->IsFusionComputation()) {
@@ -705,7 +800,26 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
     TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
     XLA_VLOG_LINES(2, "LLVM IR:\n" + llvm_ir::DumpModuleToString(*llvm_module));
     // JIT compile the LLVM IR module to in-memory machine code.
-    jit->AddModule(std::move(llvm_module));
+    string object_file;
+    if (keep_object_file) {
+      // Run the same compilation the JIT would, but keep the resulting object
+      // file around for SerializeExecutable before handing it to the JIT.
+      Disassembler disassembler(*jit->target_machine());
+      CompilerFunctor compiler_functor(
+          jit->target_machine(), &disassembler,
+          CodeGenOptLevel(module->config()),
+          options::OptimizeForSizeRequested(module->config()),
+          module->config().debug_options().xla_enable_fast_math(),
+          module->config().debug_options().xla_llvm_disable_expensive_passes(),
+          pre_optimization_ir_hook, post_optimization_ir_hook);
+      std::unique_ptr<llvm::MemoryBuffer> object_buffer =
+          compiler_functor(*llvm_module);
+      object_file.assign(object_buffer->getBufferStart(),
+                         object_buffer->getBufferEnd());
+      jit->AddObjectFile(std::move(object_buffer));
+    } else {
+      jit->AddModule(std::move(llvm_module));
+    }
     cpu_executable.reset(new CpuExecutable(
         std::move(jit), std::move(assignment), std::move(module), function_name,
         std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map)));
@@ -713,6 +827,10 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
       static_cast<CpuExecutable&>(*cpu_executable)
           .set_ir_module_string(ir_module_string);
     }
+    if (keep_object_file) {
+      static_cast<CpuExecutable&>(*cpu_executable)
+          .set_object_file(std::move(object_file));
+    }
   }
   VLOG(1) << "Compilation finished";
   return std::move(cpu_executable);
@@ -731,7 +849,7 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
  * 5. Set target CPU, supported instructions and set optimization level.
  * 6. Create `llvm::Module` using `llvm::LLVMContext` because it requires to be thread safe.
  * 7. Loop through HLO modules
- *   1. Use high-levle optimization (call `xla::cpu::CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile)`)
+ *   1. Use high-levle optimization (call `xla::cpu::CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile, int64 aot_max_parallelism)`)
  *   2. Create a `xla::SequentialHloOrdering::HloModuleSequence` using `xla::CreateMemoryMinimizingSequence`
  *   3. Run buffer analysis on the HLO graph. Figures out which temporary buffers are required to run the computation
  *   4. Construct IrEmmiter(that will but not yet compile HLO module to LLVM IR and saves to `llvm_module`(via `xla::cpu::IrEmitter::IrEmitter()`)
@@ -763,6 +881,17 @@ CpuCompiler::CompileAheadOfTime(std::vector<std::unique_ptr<HloModule>> modules,
           "All HLO module configs must have the same value for "
           "xla_enable_fast_math.");
     }
+    // The xfeed rings live in the service process.
+    if (module->config().debug_options().xla_cpu_xfeed_ring_slots() > 0) {
+      return InvalidArgument(
+          "xla_cpu_xfeed_ring_slots is not supported in AOT compilation.");
+    }
+    // The inter-op thread pools live in the service process as well.
+    if (InterOpParallelismRequested(module->config())) {
+      return InvalidArgument(
+          "xla_cpu_inter_op_parallelism_threads is not supported in AOT "
+          "compilation.");
+    }
   }
   if (aot_options.PlatformId() != se::host::kHostPlatformId) {
     return InvalidArgument("Incompatible AOT compilation platform");
@@ -832,12 +961,14 @@ CpuCompiler::CompileAheadOfTime(std::vector<std::unique_ptr<HloModule>> modules,
     VLOG(1) << "Compiling ahead-of-time: " << module->name();
     VLOG(2) << "Before optimization:";
     XLA_VLOG_LINES(2, module->ToString());
-    TF_RETURN_IF_ERROR(RunHloPasses(module, /*is_aot_compile=*/true));
+    TF_RETURN_IF_ERROR(RunHloPasses(module, /*is_aot_compile=*/true,
+                                    options.max_parallelism()));
     VLOG(2) << "After optimization:";
     XLA_VLOG_LINES(2, module->ToString());
     TF_ASSIGN_OR_RETURN(
         SequentialHloOrdering::HloModuleSequence module_sequence,
-        CreateMemoryMinimizingSequence(*module, BufferSizeBytesFunction()));
+        CreateMemoryMinimizingSequence(*module, BufferSizeBytesFunction(),
+                                       CpuMemoryScheduler()));
     // Run buffer analysis on the HLO graph. This analysis figures out which
     // temporary buffers are required to run the computation.
     TF_ASSIGN_OR_RETURN(
@@ -884,6 +1015,15 @@ CpuCompiler::CompileAheadOfTime(std::vector<std::unique_ptr<HloModule>> modules,
                                    /*is_top_level_computation=*/true,
                                    &module_sequence.at(computation)));
     CHECK(entry_function->getName() == llvm_ir::AsStringRef(entry_point_name));
+    // Partitioned HLOs were lowered to calls to the JIT fork-join runtime,
+    // which dispatches to the Eigen thread pool in the run options.  AOT
+    // objects instead link against the standalone fork-join runtime, which
+    // shares the same calling convention, so only the callee is retargeted.
+    if (llvm::Function* fork_join_function =
+            llvm_module.getFunction(runtime::kParallelForkJoinSymbolName)) {
+      TF_RET_CHECK(fork_join_function->isDeclaration());
+      fork_join_function->setName(runtime::kAotParallelForkJoinSymbolName);
+    }
     ModuleHook pre_optimization_ir_dump_hook;
     ModuleHook post_optimization_ir_dump_hook;
     TF_RETURN_IF_ERROR(InitializeModuleHooks(
@@ -939,6 +1079,158 @@ se::Platform::Id CpuCompiler::PlatformId() const {
 HloCostAnalysis::ShapeSizeFunction CpuCompiler::ShapeSizeBytesFunction() const {
   return CpuExecutable::ShapeSizeBytes;
 }
+StatusOr<string> CpuCompiler::TargetFingerprint(
+    const HloModuleConfig& /*module_config*/,
+    se::StreamExecutor* /*stream_exec*/) const {
+  std::vector<string> enabled_features;
+  llvm::StringMap<bool> host_features;
+  if (llvm::sys::getHostCPUFeatures(host_features)) {
+    for (const auto& feature : host_features) {
+      if (feature.second) {
+        enabled_features.push_back(feature.first().str());
+      }
+    }
+  }
+  // StringMap iteration order is unspecified.
+  std::sort(enabled_features.begin(), enabled_features.end());
+  return tensorflow::strings::StrCat(
+      llvm::sys::getProcessTriple(), ";", llvm::sys::getHostCPUName().str(),
+      ";", tensorflow::str_util::Join(enabled_features, ","), ";LLVM ",
+      LLVM_VERSION_STRING);
+}
+StatusOr<string> CpuCompiler::SerializeExecutable(
+    const Executable& executable) {
+  const auto* cpu_executable = dynamic_cast<const CpuExecutable*>(&executable);
+  if (cpu_executable == nullptr) {
+    return Unimplemented(
+        "only executables from the sequential CPU backend can be serialized");
+  }
+  if (cpu_executable->object_file().empty()) {
+    return FailedPrecondition(
+        "executable was built without keeping its object file");
+  }
+  const HloModule& module = cpu_executable->module();
+  const BufferAssignment& assignment = cpu_executable->buffer_assignment();
+  CachedCpuExecutable cached;
+  *cached.mutable_hlo() = MakeHloProto(module, assignment);
+  for (const HloComputation* computation : module.MakeNonfusionComputations()) {
+    const std::vector<const HloInstruction*>* sequence =
+        assignment.liveness().hlo_ordering().SequentialOrder(*computation);
+    TF_RET_CHECK(sequence != nullptr);
+    CachedComputationSequence* cached_sequence = cached.add_sequences();
+    cached_sequence->set_computation_name(computation->name());
+    for (const HloInstruction* instruction : *sequence) {
+      cached_sequence->add_instruction_names(instruction->name());
+    }
+  }
+  ProgramShape* entry_layout = cached.mutable_entry_computation_layout();
+  const ComputationLayout& computation_layout =
+      module.entry_computation_layout();
+  for (int64 i = 0; i < computation_layout.parameter_count(); ++i) {
+    *entry_layout->add_parameters() =
+        computation_layout.parameter_layout(i).shape();
+  }
+  *entry_layout->mutable_result() = computation_layout.result_layout().shape();
+  cached.set_object_file(cpu_executable->object_file());
+  cached.set_entry_function_name(cpu_executable->entry_function_name());
+  return cached.SerializeAsString();
+}
+StatusOr<std::unique_ptr<Executable>> CpuCompiler::DeserializeExecutable(
+    const string& serialized, const HloModuleConfig& module_config,
+    const VersionedComputationHandle& entry_computation_handle,
+    se::StreamExecutor* stream_exec) {
+  TF_RET_CHECK(stream_exec != nullptr);
+  CachedCpuExecutable cached;
+  if (!cached.ParseFromString(serialized)) {
+    return InvalidArgument("malformed serialized CPU executable");
+  }
+  std::call_once(llvm_command_line_options_initialized,
+                 &llvm_ir::InitializeLLVMCommandLineOptions, module_config);
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> module,
+      HloModule::CreateFromProto(cached.hlo().hlo_module(), module_config,
+                                 entry_computation_handle));
+  TF_RETURN_IF_ERROR(ConfigureXfeedRings(*module));
+  // Restore the layouts chosen by layout assignment when the executable was
+  // built; 'module_config' predates layout assignment.
+  const ProgramShape& entry_layout = cached.entry_computation_layout();
+  ComputationLayout* computation_layout =
+      module->mutable_entry_computation_layout();
+  if (entry_layout.parameters_size() != computation_layout->parameter_count()) {
+    return InvalidArgument(
+        "serialized CPU executable has %d parameters, computation has %d",
+        entry_layout.parameters_size(), computation_layout->parameter_count());
+  }
+  for (int i = 0; i < entry_layout.parameters_size(); ++i) {
+    TF_RETURN_IF_ERROR(
+        computation_layout->mutable_parameter_layout(i)->CopyLayoutFromShape(
+            entry_layout.parameters(i)));
+  }
+  TF_RETURN_IF_ERROR(
+      computation_layout->mutable_result_layout()->CopyLayoutFromShape(
+          entry_layout.result()));
+  // Rebuild the emission order, which determines the buffer assignment.
+  SequentialHloOrdering::HloModuleSequence module_sequence;
+  for (const CachedComputationSequence& cached_sequence : cached.sequences()) {
+    HloComputation* computation = nullptr;
+    for (HloComputation* candidate : module->computations()) {
+      if (candidate->name() == cached_sequence.computation_name()) {
+        computation = candidate;
+        break;
+      }
+    }
+    if (computation == nullptr) {
+      return InvalidArgument(
+          "serialized CPU executable sequences unknown computation %s",
+          cached_sequence.computation_name().c_str());
+    }
+    tensorflow::gtl::FlatMap<string, const HloInstruction*> instructions;
+    for (const HloInstruction* instruction : computation->instructions()) {
+      instructions[instruction->name()] = instruction;
+    }
+    std::vector<const HloInstruction*>& sequence = module_sequence[computation];
+    for (const string& instruction_name : cached_sequence.instruction_names()) {
+      auto it = instructions.find(instruction_name);
+      if (it == instructions.end()) {
+        return InvalidArgument(
+            "serialized CPU executable sequences unknown instruction %s",
+            instruction_name.c_str());
+      }
+      sequence.push_back(it->second);
+    }
+  }
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<BufferAssignment> assignment,
+      BufferAssigner::Run(
+          module.get(),
+          MakeBufferAssignmentOrdering(module.get(), module_sequence),
+          BufferSizeBytesFunction(), memory_alignment));
+  // The object code addresses buffers by allocation index and offset, so it is
+  // only usable if the assignment comes out exactly as it did at compile time.
+  if (!protobuf_util::ProtobufEquals(assignment->ToProto(),
+                                     cached.hlo().buffer_assignment())) {
+    return FailedPrecondition(
+        "buffer assignment of serialized CPU executable for %s does not "
+        "reproduce",
+        module->name().c_str());
+  }
+  auto jit = xla::MakeUnique<SimpleOrcJIT>(
+      CompilerTargetOptions(module_config), CodeGenOptLevel(module_config),
+      options::OptimizeForSizeRequested(module_config),
+      module_config.debug_options().xla_enable_fast_math(),
+      module_config.debug_options().xla_llvm_disable_expensive_passes(),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr);
+  jit->AddObjectFile(llvm::MemoryBuffer::getMemBufferCopy(
+      cached.object_file(), cached.entry_function_name()));
+  auto cpu_executable = xla::MakeUnique<CpuExecutable>(
+      std::move(jit), std::move(assignment), std::move(module),
+      cached.entry_function_name(),
+      /*hlo_profile_printer_data=*/nullptr,
+      /*hlo_profile_index_map=*/nullptr);
+  // Keep the object file so that the executable can be serialized again.
+  cpu_executable->set_object_file(cached.object_file());
+  return std::unique_ptr<Executable>(std::move(cpu_executable));
+}
 }  // namespace cpu
 }  // namespace xla
 static bool InitModule() {
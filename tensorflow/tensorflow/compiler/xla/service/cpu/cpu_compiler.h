@@ -59,12 +59,20 @@ class CpuAotCompilationOptions : public AotCompilationOptions {
   const string& entry_point_name() const { return entry_point_name_; }
   // The relocation model used for compilation.
   RelocationModel relocation_model() const { return relocation_model_; }
+  // The maximum number of parallel tasks a single HLO may be split into.  A
+  // value of 1 (the default) emits single-threaded code; larger values emit
+  // calls to the AOT fork-join runtime (see runtime_aot_fork_join.h).
+  int64 max_parallelism() const { return max_parallelism_; }
+  void set_max_parallelism(int64 max_parallelism) {
+    max_parallelism_ = max_parallelism;
+  }
  private:
   const string triple_;
   const string cpu_name_;
   const string features_;
   const string entry_point_name_;
   const RelocationModel relocation_model_;
+  int64 max_parallelism_ = 1;
 };
 class CpuAotCompilationResult : public AotCompilationResult {
  public:
@@ -117,12 +125,27 @@ class CpuCompiler : public LLVMCompiler {
                      const AotCompilationOptions& options) override;
   perftools::gputools::Platform::Id PlatformId() const override;
   HloCostAnalysis::ShapeSizeFunction ShapeSizeBytesFunction() const override;
+  // The JIT targets the host, so the fingerprint is the host's triple, CPU
+  // model and feature set, together with the LLVM version.
+  StatusOr<string> TargetFingerprint(
+      const HloModuleConfig& module_config,
+      perftools::gputools::StreamExecutor* stream_exec) const override;
+  // Only executables built by the sequential backend with the
+  // xla_persistent_compilation_cache_dir debug option set can be serialized;
+  // those keep a copy of their object code (see cached_executable.proto).
+  StatusOr<string> SerializeExecutable(const Executable& executable) override;
+  StatusOr<std::unique_ptr<Executable>> DeserializeExecutable(
+      const string& serialized, const HloModuleConfig& module_config,
+      const VersionedComputationHandle& entry_computation_handle,
+      perftools::gputools::StreamExecutor* stream_exec) override;
  private:
   // Initialize the LLVM target.
   static void InitializeLLVMTarget();
   // Runs the HLO passes which are necessary for both optimizations and
-  // correctness.
-  Status RunHloPasses(HloModule* module, bool is_aot_compile);
+  // correctness.  'aot_max_parallelism' is only consulted when
+  // 'is_aot_compile' is true; the JIT derives its parallelism from the host.
+  Status RunHloPasses(HloModule* module, bool is_aot_compile,
+                      int64 aot_max_parallelism);
   TF_DISALLOW_COPY_AND_ASSIGN(CpuCompiler);
 };
 }  // namespace cpu
@@ -16,7 +16,11 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
+
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/core/lib/math/math_util.h"
 
 namespace xla {
 namespace cpu {
@@ -60,8 +64,93 @@ bool CanBeOutputFusedIntoSomeOperand(const HloInstruction* consumer) {
          (CanBeOutputFused(consumer->operand(0), consumer) ||
           CanBeOutputFused(consumer->operand(1), consumer));
 }
+
+// Whether 'hlo' is a plain matrix-matrix (or matrix-vector) product which
+// IrEmitter can emit panel by panel, see kGemmEpilogueTileBytes.
+bool IsEpilogueFusibleGemm(const HloInstruction* hlo) {
+  if (hlo->opcode() != HloOpcode::kDot || hlo->user_count() != 1) {
+    return false;
+  }
+  const Shape& shape = hlo->shape();
+  const DotDimensionNumbers& dnums = hlo->dot_dimension_numbers();
+  return ShapeUtil::Rank(shape) == 2 &&
+         ShapeUtil::Rank(hlo->operand(0)->shape()) == 2 &&
+         ShapeUtil::Rank(hlo->operand(1)->shape()) == 2 &&
+         dnums.lhs_batch_dimensions_size() == 0 &&
+         dnums.lhs_contracting_dimensions_size() == 1 &&
+         dnums.lhs_contracting_dimensions(0) == 1 &&
+         dnums.rhs_contracting_dimensions(0) == 0 &&
+         (shape.element_type() == F16 || shape.element_type() == F32 ||
+          shape.element_type() == F64) &&
+         GemmEpiloguePanelRows(*hlo) > 0;
+}
+
+// Whether 'consumer' computes each element of its output from the element of
+// 'gemm' at the same index, and reads 'gemm' nowhere else.  Its other operands
+// may be read in any way (e.g. a broadcast bias).
+bool CanBeEpilogueFused(const HloInstruction* gemm,
+                        const HloInstruction* consumer) {
+  if (!IsEpilogueFusibleGemm(gemm) ||
+      !ShapeUtil::SameDimensions(gemm->shape(), consumer->shape())) {
+    return false;
+  }
+  if (consumer->opcode() == HloOpcode::kFusion) {
+    return consumer->fusion_kind() == HloInstruction::FusionKind::kLoop &&
+           consumer->IsElementwiseOnOperand(consumer->operand_index(gemm));
+  }
+  return consumer->IsElementwise();
+}
 }  // namespace
 
+int64 GemmEpiloguePanelRows(const HloInstruction& dot) {
+  const Shape& shape = dot.shape();
+  if (ShapeUtil::HasZeroElements(shape)) {
+    return 0;
+  }
+  const int64 element_bytes =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+  const int64 m = shape.dimensions(0);
+  const int64 n = shape.dimensions(1);
+  const int64 k = dot.operand(0)->shape().dimensions(1);
+  const int64 row_alignment =
+      kGemmEpilogueLhsAlignment /
+      tensorflow::MathUtil::GCD<int64>(k * element_bytes,
+                                       kGemmEpilogueLhsAlignment);
+  const int64 panel_rows = kGemmEpilogueTileBytes / (n * element_bytes) /
+                           row_alignment * row_alignment;
+  if (panel_rows >= m) {
+    return m;
+  }
+  return panel_rows >= kGemmEpilogueMinPanelRows ? panel_rows : 0;
+}
+
+const HloInstruction* GetGemmEpilogueDot(const HloInstruction& fusion) {
+  if (fusion.opcode() != HloOpcode::kFusion ||
+      fusion.fusion_kind() != HloInstruction::FusionKind::kOutput) {
+    return nullptr;
+  }
+  const HloInstruction* root = fusion.fused_expression_root();
+  if (root->opcode() == HloOpcode::kAdd &&
+      ((root->operand(0)->opcode() == HloOpcode::kDot &&
+        IsMatrixVectorDot(root->operand(0)) &&
+        root->operand(1)->opcode() == HloOpcode::kParameter) ||
+       (root->operand(1)->opcode() == HloOpcode::kDot &&
+        IsMatrixVectorDot(root->operand(1)) &&
+        root->operand(0)->opcode() == HloOpcode::kParameter))) {
+    return nullptr;
+  }
+  const HloInstruction* dot = nullptr;
+  for (const HloInstruction* instruction : fusion.fused_instructions()) {
+    if (instruction->opcode() == HloOpcode::kDot) {
+      if (dot != nullptr) {
+        return nullptr;
+      }
+      dot = instruction;
+    }
+  }
+  return dot;
+}
+
 bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
                                       int64 operand_index) {
   HloInstruction* producer = consumer->mutable_operand(operand_index);
@@ -78,11 +167,37 @@ bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
     return false;
   }
 
+  if (CanBeEpilogueFused(producer, consumer)) {
+    VLOG(2) << "Fusing GEMM epilogue.";
+    return true;
+  }
+
+  // The operands of a GEMM with a fused epilogue are read by the GEMM kernel
+  // and must stay in memory.  Its other operands fuse as into a loop fusion.
+  const HloInstruction* gemm = GetGemmEpilogueDot(*consumer);
+  if (gemm != nullptr) {
+    const HloInstruction* fused_parameter =
+        consumer->fused_parameter(operand_index);
+    if (std::find(gemm->operands().begin(), gemm->operands().end(),
+                  fused_parameter) != gemm->operands().end()) {
+      VLOG(2) << "Not fusing: operand of a GEMM with a fused epilogue.";
+      return false;
+    }
+  }
+
   if (!CanBeLoopFused(*producer)) {
     VLOG(2) << "Producer is not fusile.";
     return false;
   }
 
+  // A fused kRng would be emitted by the elemental IR emitter's generator
+  // instead of the Philox generator of IrEmitter::HandleRng.
+  if (producer->opcode() == HloOpcode::kRng ||
+      consumer->opcode() == HloOpcode::kRng) {
+    VLOG(2) << "Not fusing: kRng is emitted unfused.";
+    return false;
+  }
+
   // Cost condition: not fuse (simple, expensive producers) and (consumers who
   // reuse operand elements).
   if (producer->opcode() != HloOpcode::kFusion &&
@@ -134,8 +249,9 @@ bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
     }
   }
 
-  if (consumer->opcode() == HloOpcode::kFusion &&
-      consumer->fusion_kind() == HloInstruction::FusionKind::kLoop) {
+  if ((consumer->opcode() == HloOpcode::kFusion &&
+       consumer->fusion_kind() == HloInstruction::FusionKind::kLoop) ||
+      gemm != nullptr) {
     VLOG(2) << "Fusing: consumer is a fusion node.";
     return true;
   }
@@ -151,7 +267,9 @@ bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
 
 HloInstruction::FusionKind CpuInstructionFusion::ChooseKind(
     const HloInstruction* producer, const HloInstruction* consumer) {
-  return CanBeOutputFused(producer, consumer)
+  return (CanBeOutputFused(producer, consumer) ||
+          CanBeEpilogueFused(producer, consumer) ||
+          GetGemmEpilogueDot(*consumer) != nullptr)
              ? HloInstruction::FusionKind::kOutput
              : HloInstruction::FusionKind::kLoop;
 }
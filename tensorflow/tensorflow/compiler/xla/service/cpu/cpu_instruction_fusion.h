@@ -23,6 +23,35 @@ limitations under the License.
 
 namespace xla {
 namespace cpu {
+
+// The largest output panel, in bytes, of a GEMM with a fused epilogue.  The
+// GEMM is emitted one panel of output rows at a time and the epilogue applied
+// to each panel while it is still in cache, so a fusion is only formed if a
+// panel tall enough for the GEMM kernel fits (see GemmEpiloguePanelRows).
+constexpr int64 kGemmEpilogueTileBytes = 128 * 1024;
+
+// The fewest output rows a panel of a GEMM with a fused epilogue may have,
+// unless the whole output fits in one panel.  Thinner panels make the GEMM
+// kernel re-read the rhs too often to win back the cost of the epilogue.
+constexpr int64 kGemmEpilogueMinPanelRows = 64;
+
+// The lhs alignment panels are rounded for: the largest that IrEmitter
+// assumes for any buffer.
+constexpr int64 kGemmEpilogueLhsAlignment = 16;
+
+// Returns the number of output rows in each panel of 'dot', a rank-2 dot with
+// a fused epilogue: as many as fit in kGemmEpilogueTileBytes, rounded down so
+// that every lhs panel is as aligned as the lhs, and at most all of them.
+// Returns 0 if that is fewer than kGemmEpilogueMinPanelRows, in which case
+// the epilogue is not fused.
+int64 GemmEpiloguePanelRows(const HloInstruction& dot);
+
+// Returns the dot of 'fusion' if it is a GEMM epilogue fusion, i.e. an output
+// fusion of exactly one rank-2 dot with elementwise consumers.  Returns null
+// for other fusions, including the matrix-vector dot plus addend fusions that
+// DotOpEmitter emits with an addend.
+const HloInstruction* GetGemmEpilogueDot(const HloInstruction& fusion);
+
 /**
  * \todo See what this pass do
  */
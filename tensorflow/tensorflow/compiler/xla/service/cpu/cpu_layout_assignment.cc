@@ -20,6 +20,7 @@ limitations under the License.
 #include <numeric>
 
 #include "tensorflow/compiler/xla/map_util.h"
+#include "tensorflow/compiler/xla/service/cpu/batch_dot_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -123,15 +124,23 @@ Status CpuLayoutAssignment::AddBackendConstraints(
           constraints->SetOperandLayout(filter_shape, convolution, 1));
       TF_RETURN_IF_ERROR(
           constraints->SetInstructionLayout(output_shape, convolution));
+    } else if (instruction->opcode() == HloOpcode::kSort) {
+      // The sort runtime sorts rows along the minor dimension of a row-major
+      // array in place.
+      TF_RETURN_IF_ERROR(constraints->SetOperandLayout(
+          RowMajorShape(instruction->operand(0)->shape()), instruction, 0));
+      TF_RETURN_IF_ERROR(constraints->SetInstructionLayout(
+          RowMajorShape(instruction->shape()), instruction));
     } else if (optional<int64> op_idx =
                    ShouldMakeOperandColumnMajor(&cache, *instruction)) {
       const HloInstruction* op = instruction->operand(*op_idx);
       TF_RETURN_IF_ERROR(constraints->SetOperandLayout(
           ColMajorShape(op->shape()), instruction, *op_idx));
-    } else if (PotentiallyImplementedAsEigenDot(*instruction)) {
+    } else if (PotentiallyImplementedAsEigenDot(*instruction) ||
+               PotentiallyImplementedAsEigenBatchDot(*instruction)) {
       const HloInstruction* dot = instruction;
-      // In order to implement `dot` with Eigen dot, the layouts of the lhs,
-      // rhs, and output need to be row-major.
+      // In order to implement `dot` with Eigen dot or batch dot, the layouts of
+      // the lhs, rhs, and output need to be row-major.
       //
       // These constraints are not hard constraints. Ideally, we should decide
       // which layouts to choose according to some cost model.
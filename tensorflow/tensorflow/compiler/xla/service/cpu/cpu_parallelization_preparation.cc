@@ -118,6 +118,11 @@ StatusOr<bool> ParallelizationPreparation::RunParallelTaskAssignment(
   // Assign parallel tasks to HLOs in entry computation.
   HloComputation* computation = module->entry_computation();
   for (auto* instruction : computation->instructions()) {
+    // The executable launches the partitions itself, and cannot pass them the
+    // invocation number of a kRng drawn once per execution.
+    if (instruction->opcode() == HloOpcode::kRng) {
+      continue;
+    }
     // Calculate target parallel task count in [1, max_parallelism_].
     const int64 target_parallel_task_count =
         parallel_task_assignment.GetTargetParallelTaskCount(instruction);
@@ -0,0 +1,334 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/cpu_rematerialization.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/hlo_ordering.h"
+#include "tensorflow/compiler/xla/service/hlo_scheduling.h"
+#include "tensorflow/compiler/xla/service/logical_buffer.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/lib/gtl/flatset.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+
+using ::tensorflow::strings::HumanReadableNumBytes;
+
+namespace {
+
+// Live bytes of a computation executed in a given order.
+struct MemoryProfile {
+  int64 peak_bytes = 0;
+  int64 peak_position = 0;
+  // The last position at which each buffer defined in the computation is
+  // live.
+  tensorflow::gtl::FlatMap<const LogicalBuffer*, int64> last_live_positions;
+};
+
+// Simulates the buffers defined in the computation executed in the order
+// 'sequence', ignoring fragmentation.  A buffer is live from its definition to
+// its last read, except that the buffers of parameters, constants and the
+// result are live throughout.
+MemoryProfile SimulateMemory(const HloComputation& computation,
+                             const std::vector<HloInstruction*>& sequence,
+                             const TuplePointsToAnalysis& points_to_analysis,
+                             const LogicalBuffer::SizeFunction& size_function) {
+  const int64 end = sequence.size();
+  MemoryProfile profile;
+  tensorflow::gtl::FlatMap<const LogicalBuffer*, int64> definitions;
+  for (int64 i = 0; i < end; ++i) {
+    const HloInstruction* instruction = sequence[i];
+    const bool live_throughout =
+        instruction->opcode() == HloOpcode::kParameter ||
+        instruction->opcode() == HloOpcode::kConstant;
+    for (const LogicalBuffer* buffer :
+         points_to_analysis.GetBuffersDefinedByInstruction(instruction)) {
+      definitions[buffer] = live_throughout ? 0 : i;
+      profile.last_live_positions[buffer] = live_throughout ? end - 1 : i;
+    }
+  }
+  auto extend_live_range = [&](const HloInstruction* instruction,
+                               int64 position) {
+    for (const LogicalBuffer* buffer :
+         points_to_analysis.GetPointsToSet(instruction).CreateFlattenedSet()) {
+      auto it = profile.last_live_positions.find(buffer);
+      if (it != profile.last_live_positions.end()) {
+        it->second = std::max(it->second, position);
+      }
+    }
+  };
+  for (int64 i = 0; i < end; ++i) {
+    for (const HloInstruction* operand : sequence[i]->operands()) {
+      extend_live_range(operand, i);
+    }
+  }
+  extend_live_range(computation.root_instruction(), end - 1);
+
+  std::vector<int64> deltas(end + 1, 0);
+  for (const auto& definition : definitions) {
+    const int64 bytes = size_function(*definition.first);
+    deltas[definition.second] += bytes;
+    deltas[profile.last_live_positions.at(definition.first) + 1] -= bytes;
+  }
+  int64 live_bytes = 0;
+  for (int64 i = 0; i < end; ++i) {
+    live_bytes += deltas[i];
+    if (live_bytes > profile.peak_bytes) {
+      profile.peak_bytes = live_bytes;
+      profile.peak_position = i;
+    }
+  }
+  return profile;
+}
+
+}  // namespace
+
+StatusOr<bool> CpuRematerialization::Run(HloModule* module) {
+  const int64 memory_limit_bytes =
+      module->config().debug_options().xla_cpu_memory_limit_bytes();
+  if (memory_limit_bytes <= 0) {
+    return false;
+  }
+  const HloCostAnalysis::ShapeSizeFunction shape_size = shape_size_;
+  const LogicalBuffer::SizeFunction size_function =
+      [shape_size](const LogicalBuffer& buffer) {
+        return shape_size(buffer.shape());
+      };
+  TF_ASSIGN_OR_RETURN(
+      SequentialHloOrdering::HloModuleSequence module_sequence,
+      CreateMemoryMinimizingSequence(*module, size_function,
+                                     scheduler_algorithm_));
+  TF_ASSIGN_OR_RETURN(
+      const int64 before_bytes,
+      PackedMemoryForSequence(module_sequence, size_function, alignment_));
+  if (before_bytes <= memory_limit_bytes) {
+    VLOG(1) << "Peak memory of " << module->name() << " is "
+            << HumanReadableNumBytes(before_bytes) << ", within the limit of "
+            << HumanReadableNumBytes(memory_limit_bytes);
+    return false;
+  }
+
+  HloComputation* entry_computation = module->entry_computation();
+  tensorflow::gtl::FlatMap<const HloInstruction*, HloInstruction*>
+      mutable_instructions;
+  for (HloInstruction* instruction : entry_computation->instructions()) {
+    mutable_instructions[instruction] = instruction;
+  }
+  std::vector<HloInstruction*> sequence;
+  for (const HloInstruction* instruction :
+       module_sequence.at(entry_computation)) {
+    sequence.push_back(mutable_instructions.at(instruction));
+  }
+  TF_ASSIGN_OR_RETURN(
+      bool changed, RematerializeComputation(entry_computation,
+                                             memory_limit_bytes, &sequence));
+  // Report the peak of the schedule the backend will actually pick.
+  TF_ASSIGN_OR_RETURN(
+      module_sequence,
+      CreateMemoryMinimizingSequence(*module, size_function,
+                                     scheduler_algorithm_));
+  TF_ASSIGN_OR_RETURN(
+      const int64 after_bytes,
+      PackedMemoryForSequence(module_sequence, size_function, alignment_));
+  LOG(INFO) << "Rematerialization changed the peak memory of "
+            << module->name() << " from " << HumanReadableNumBytes(before_bytes)
+            << " to " << HumanReadableNumBytes(after_bytes) << " (limit "
+            << HumanReadableNumBytes(memory_limit_bytes) << ")";
+  if (after_bytes > memory_limit_bytes) {
+    LOG(WARNING) << "Peak memory of " << module->name()
+                 << " still exceeds the limit after rematerialization";
+  }
+  return changed;
+}
+
+StatusOr<bool> CpuRematerialization::RematerializeComputation(
+    HloComputation* computation, int64 memory_limit_bytes,
+    std::vector<HloInstruction*>* sequence) {
+  const HloCostAnalysis::ShapeSizeFunction shape_size = shape_size_;
+  const LogicalBuffer::SizeFunction size_function =
+      [shape_size](const LogicalBuffer& buffer) {
+        return shape_size(buffer.shape());
+      };
+  // Every round handles one peak, adding as many clones as it takes to fit
+  // it under the limit, and runs one points-to analysis.  Bound the rounds in
+  // case rematerialization merely moves the peak around.
+  const int64 max_rounds = computation->instruction_count();
+  bool changed = false;
+  for (int64 round = 0; round < max_rounds; ++round) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<TuplePointsToAnalysis> points_to,
+                        TuplePointsToAnalysis::Run(computation->parent()));
+    const MemoryProfile profile =
+        SimulateMemory(*computation, *sequence, *points_to, size_function);
+    if (profile.peak_bytes <= memory_limit_bytes) {
+      break;
+    }
+    const int64 end = sequence->size();
+    const int64 peak = profile.peak_position;
+    tensorflow::gtl::FlatMap<const HloInstruction*, int64> positions;
+    for (int64 i = 0; i < end; ++i) {
+      positions[(*sequence)[i]] = i;
+    }
+
+    // Collect the values live across the peak that could be recomputed
+    // after it.
+    struct Candidate {
+      HloInstruction* instruction;
+      int64 bytes;
+      int64 reuse;
+    };
+    std::vector<Candidate> candidates;
+    for (int64 i = 0; i < peak; ++i) {
+      HloInstruction* candidate = (*sequence)[i];
+      if (!CanRematerialize(*candidate)) {
+        continue;
+      }
+      // Values aliased by other instructions, e.g. tuples or bitcasts, stay
+      // live through those.
+      const auto& defined =
+          points_to->GetBuffersDefinedByInstruction(candidate);
+      if (defined.size() != 1 ||
+          points_to->GetBufferAliases(*defined[0]).size() != 1 ||
+          profile.last_live_positions.at(defined[0]) <= peak) {
+        continue;
+      }
+      int64 reuse = end;
+      bool used_at_peak = false;
+      for (const HloInstruction* user : candidate->users()) {
+        const int64 position = positions.at(user);
+        used_at_peak |= position == peak;
+        if (position > peak) {
+          reuse = std::min(reuse, position);
+        }
+      }
+      if (used_at_peak || reuse == end) {
+        continue;
+      }
+      // Recomputing must not keep any operand live for longer.
+      bool operands_live = true;
+      for (const HloInstruction* operand : candidate->operands()) {
+        for (const LogicalBuffer* buffer :
+             points_to->GetPointsToSet(operand).CreateFlattenedSet()) {
+          auto it = profile.last_live_positions.find(buffer);
+          if (it != profile.last_live_positions.end() && it->second < reuse) {
+            operands_live = false;
+          }
+        }
+      }
+      if (operands_live) {
+        candidates.push_back({candidate, size_function(*defined[0]), reuse});
+      }
+    }
+    if (candidates.empty()) {
+      VLOG(1) << "No rematerialization candidate for the peak of "
+              << HumanReadableNumBytes(profile.peak_bytes) << " at "
+              << (*sequence)[peak]->name();
+      break;
+    }
+
+    // Each candidate lowers the peak by its size, so rematerialize the
+    // largest ones, preferring those whose next use is furthest away, until
+    // the peak fits.  Candidates related by an operand edge are left to a
+    // later round, since the analysis does not describe their clones.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) {
+                return a.bytes != b.bytes ? a.bytes > b.bytes
+                                          : a.reuse > b.reuse;
+              });
+    HloInstruction* peak_instruction = (*sequence)[peak];
+    std::vector<std::pair<int64, HloInstruction*>> insertions;
+    tensorflow::gtl::FlatSet<const HloInstruction*> chosen;
+    int64 excess_bytes = profile.peak_bytes - memory_limit_bytes;
+    for (const Candidate& candidate : candidates) {
+      if (excess_bytes <= 0) {
+        break;
+      }
+      HloInstruction* best = candidate.instruction;
+      bool related = false;
+      for (const HloInstruction* operand : best->operands()) {
+        related |= chosen.count(operand) > 0;
+      }
+      for (const HloInstruction* user : best->users()) {
+        related |= chosen.count(user) > 0;
+      }
+      if (related) {
+        continue;
+      }
+      chosen.insert(best);
+
+      VLOG(2) << "Rematerializing " << best->name() << " ("
+              << HumanReadableNumBytes(candidate.bytes) << ") before "
+              << (*sequence)[candidate.reuse]->name();
+      HloInstruction* remat =
+          computation->AddInstruction(best->Clone(/*suffix=*/"remat"));
+      const std::vector<HloInstruction*> users = best->users();
+      for (HloInstruction* user : users) {
+        if (positions.at(user) > peak) {
+          TF_RETURN_IF_ERROR(best->ReplaceUseWith(user, remat));
+        }
+      }
+      // Schedulers are free to move the clone back before the peak otherwise.
+      TF_RETURN_IF_ERROR(peak_instruction->AddControlDependencyTo(remat));
+      insertions.emplace_back(candidate.reuse, remat);
+      excess_bytes -= candidate.bytes;
+    }
+    // Insert from the back so that earlier positions stay valid.
+    std::stable_sort(insertions.begin(), insertions.end(),
+                     [](const std::pair<int64, HloInstruction*>& a,
+                        const std::pair<int64, HloInstruction*>& b) {
+                       return a.first > b.first;
+                     });
+    for (const auto& insertion : insertions) {
+      sequence->insert(sequence->begin() + insertion.first, insertion.second);
+    }
+    changed = true;
+  }
+  return changed;
+}
+
+/* static */ bool CpuRematerialization::CanRematerialize(
+    const HloInstruction& instruction) {
+  if (ShapeUtil::IsTuple(instruction.shape()) || instruction.HasSideEffect() ||
+      !instruction.control_predecessors().empty() ||
+      !instruction.control_successors().empty()) {
+    return false;
+  }
+  switch (instruction.opcode()) {
+    case HloOpcode::kParameter:
+    case HloOpcode::kConstant:
+    // Copies inserted by copy insertion separate buffers that must not alias.
+    case HloOpcode::kCopy:
+      return false;
+    case HloOpcode::kBroadcast:
+      return true;
+    case HloOpcode::kFusion:
+      return instruction.fusion_kind() == HloInstruction::FusionKind::kLoop;
+    default:
+      return instruction.IsElementwise();
+  }
+}
+
+}  // namespace cpu
+}  // namespace xla
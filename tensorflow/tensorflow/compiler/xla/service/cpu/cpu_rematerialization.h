@@ -0,0 +1,94 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_REMATERIALIZATION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_REMATERIALIZATION_H_
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/service/hlo_scheduling.h"
+
+namespace xla {
+namespace cpu {
+
+/**
+ * Trades compute for memory when the entry computation would not fit in the
+ * module's memory budget, the `xla_cpu_memory_limit_bytes` debug option (no
+ * budget if 0).
+ *
+ * The pass schedules the module with `CreateMemoryMinimizingSequence` and
+ * the backend's scheduler algorithm, and measures its peak as packed by
+ * `PackedMemoryForSequence`.  If that exceeds the budget, it simulates the
+ * live bytes of the entry computation and, while the peak exceeds the budget,
+ * picks values that are live across the peak but unused there, and that are
+ * cheap to recompute: elementwise instructions, broadcasts or loop fusions
+ * whose operands stay live anyway.  Their uses after the peak are redirected
+ * to clones, which control dependencies keep from being scheduled before the
+ * peak, so the originals die earlier.  Each peak takes one points-to
+ * analysis, however many values it rematerializes.
+ *
+ * Called computations are not rematerialized.  The module's packed peak
+ * memory before the pass and after rescheduling its result is logged.
+ */
+class CpuRematerialization : public HloPassInterface {
+ public:
+  // 'shape_size': size in bytes of the buffer holding a value of a shape.
+  // 'scheduler_algorithm': the scheduler the backend will use, or empty for
+  // the default one.
+  // 'alignment': the alignment buffer assignment gives each buffer.
+  explicit CpuRematerialization(
+      const HloCostAnalysis::ShapeSizeFunction& shape_size,
+      const MemorySchedulerAlgorithm& scheduler_algorithm = {},
+      int64 alignment = 1)
+      : shape_size_(shape_size),
+        scheduler_algorithm_(scheduler_algorithm),
+        alignment_(alignment) {}
+  ~CpuRematerialization() override = default;
+
+  tensorflow::StringPiece name() const override {
+    return "cpu-rematerialization";
+  }
+
+  StatusOr<bool> Run(HloModule* module) override;
+
+ private:
+  // Rematerializes values of 'computation', executed in the order 'sequence',
+  // until its simulated peak is at most 'memory_limit_bytes' or no candidate
+  // is left.  Keeps 'sequence' up to date.  Returns whether anything was
+  // rematerialized.
+  StatusOr<bool> RematerializeComputation(
+      HloComputation* computation, int64 memory_limit_bytes,
+      std::vector<HloInstruction*>* sequence);
+
+  // Returns whether 'instruction' is cheap to recompute and has no effects
+  // besides its result.
+  static bool CanRematerialize(const HloInstruction& instruction);
+
+  const HloCostAnalysis::ShapeSizeFunction shape_size_;
+  const MemorySchedulerAlgorithm scheduler_algorithm_;
+  const int64 alignment_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_REMATERIALIZATION_H_
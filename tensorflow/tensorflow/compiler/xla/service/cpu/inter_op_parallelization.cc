@@ -0,0 +1,195 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelization.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace xla {
+namespace cpu {
+
+bool InterOpParallelismRequested(const HloModuleConfig& config) {
+  return config.debug_options().xla_cpu_inter_op_parallelism_threads() > 1 &&
+         !options::CpuParallelBackendRequested(config) &&
+         !config.hlo_profiling_enabled();
+}
+
+StatusOr<bool> InterOpParallelization::Run(HloModule* module) {
+  XLA_VLOG_LINES(2, "InterOpParallelization ENTRY");
+  XLA_VLOG_LINES(2, module->ToString());
+  bool changed = false;
+  HloComputation* entry_computation = module->entry_computation();
+  std::unordered_set<HloInstruction*> outlined;
+  std::vector<HloInstruction*> instructions_to_outline;
+  for (HloInstruction* instruction :
+       entry_computation->MakeInstructionPostOrder()) {
+    // Outlined instructions no longer exist and must not be dereferenced.
+    if (outlined.count(instruction) > 0) {
+      continue;
+    }
+    if (instruction->opcode() == HloOpcode::kParameter ||
+        instruction->opcode() == HloOpcode::kConstant) {
+      continue;
+    }
+    instructions_to_outline.clear();
+    instructions_to_outline.push_back(instruction);
+    while (!IsPartitioned(instructions_to_outline.back()) &&
+           instructions_to_outline.back()->user_count() == 1 &&
+           CanOutlineWithUser(instructions_to_outline.back(),
+                              instructions_to_outline.back()->users()[0])) {
+      instructions_to_outline.push_back(
+          instructions_to_outline.back()->users()[0]);
+    }
+    outlined.insert(instructions_to_outline.begin(),
+                    instructions_to_outline.end());
+    // An unpartitioned kCall already is a task.  A partitioned one is wrapped
+    // nonetheless, so that every task has the signature of a plain compute
+    // function and forks on its own.
+    if (instructions_to_outline.size() == 1 &&
+        instruction->opcode() == HloOpcode::kCall &&
+        !IsPartitioned(instruction)) {
+      continue;
+    }
+    // Control dependencies, e.g. those added by copy insertion, order whole
+    // tasks once outlined.
+    std::vector<HloInstruction*> control_predecessors;
+    std::vector<HloInstruction*> control_successors;
+    for (HloInstruction* outlined_instruction : instructions_to_outline) {
+      const std::vector<HloInstruction*> predecessors =
+          outlined_instruction->control_predecessors();
+      for (HloInstruction* predecessor : predecessors) {
+        TF_RETURN_IF_ERROR(
+            predecessor->RemoveControlDependencyTo(outlined_instruction));
+        control_predecessors.push_back(predecessor);
+      }
+      const std::vector<HloInstruction*> successors =
+          outlined_instruction->control_successors();
+      for (HloInstruction* successor : successors) {
+        TF_RETURN_IF_ERROR(
+            outlined_instruction->RemoveControlDependencyTo(successor));
+        control_successors.push_back(successor);
+      }
+    }
+    HloInstruction* call = module->OutlineExpressionFromComputation(
+        instructions_to_outline,
+        tensorflow::strings::StrCat("task_", instruction->name()),
+        entry_computation);
+    auto in_task = [&](const HloInstruction* other) {
+      return std::find(instructions_to_outline.begin(),
+                       instructions_to_outline.end(),
+                       other) != instructions_to_outline.end();
+    };
+    for (HloInstruction* predecessor : control_predecessors) {
+      if (!in_task(predecessor)) {
+        TF_RETURN_IF_ERROR(predecessor->AddControlDependencyTo(call));
+      }
+    }
+    for (HloInstruction* successor : control_successors) {
+      if (!in_task(successor)) {
+        TF_RETURN_IF_ERROR(call->AddControlDependencyTo(successor));
+      }
+    }
+    changed = true;
+  }
+  // Tasks only wait for their operands, so side effects such as infeeds,
+  // outfeeds and sends are chained in program order; otherwise two infeeds
+  // could dequeue each other's data.
+  HloInstruction* previous_side_effect = nullptr;
+  for (HloInstruction* instruction :
+       entry_computation->MakeInstructionPostOrder()) {
+    if (!instruction->HasSideEffect()) {
+      continue;
+    }
+    if (previous_side_effect != nullptr) {
+      TF_RETURN_IF_ERROR(
+          previous_side_effect->AddControlDependencyTo(instruction));
+      changed = true;
+    }
+    previous_side_effect = instruction;
+  }
+  XLA_VLOG_LINES(2, "InterOpParallelization EXIT");
+  XLA_VLOG_LINES(2, module->ToString());
+  return changed;
+}
+
+bool PerformsHostTransfers(const HloInstruction& instruction) {
+  auto transfers = [](const HloComputation& computation) {
+    for (const HloInstruction* hlo : computation.instructions()) {
+      switch (hlo->opcode()) {
+        case HloOpcode::kInfeed:
+        case HloOpcode::kOutfeed:
+        case HloOpcode::kSend:
+        case HloOpcode::kSendDone:
+        case HloOpcode::kRecv:
+        case HloOpcode::kRecvDone:
+          return true;
+        default:
+          break;
+      }
+    }
+    return false;
+  };
+  for (const HloComputation* called : instruction.called_computations()) {
+    if (transfers(*called)) {
+      return true;
+    }
+    for (const HloComputation* embedded :
+         called->MakeEmbeddedComputationsList()) {
+      if (transfers(*embedded)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/* static */ bool InterOpParallelization::IsPartitioned(
+    const HloInstruction* instruction) {
+  return !instruction->outer_dimension_partitions().empty() ||
+         (instruction->opcode() == HloOpcode::kCall &&
+          !instruction->to_apply()
+               ->root_instruction()
+               ->outer_dimension_partitions()
+               .empty());
+}
+
+/* static */ bool InterOpParallelization::CanOutlineWithUser(
+    const HloInstruction* instruction, const HloInstruction* user) {
+  if (IsPartitioned(user)) {
+    return false;
+  }
+  // Any other operand the user had would become a second dependency of the
+  // task, delaying 'instruction' until that operand is ready.
+  return std::all_of(user->operands().begin(), user->operands().end(),
+                     [instruction](const HloInstruction* operand) {
+                       return operand == instruction ||
+                              operand->opcode() == HloOpcode::kParameter ||
+                              operand->opcode() == HloOpcode::kConstant;
+                     }) &&
+         user->control_predecessors().empty();
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,85 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_INTER_OP_PARALLELIZATION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_INTER_OP_PARALLELIZATION_H_
+
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace cpu {
+
+// Returns whether the sequential CPU backend should run independent top-level
+// instructions of modules compiled with 'config' concurrently, which is the
+// case when the xla_cpu_inter_op_parallelism_threads debug option is greater
+// than 1.  The parallel backend schedules instructions on its own, and
+// profiled modules stay sequential so that per-instruction cycle counts keep
+// their meaning.
+bool InterOpParallelismRequested(const HloModuleConfig& config);
+
+// Returns whether the computations called by 'instruction', a task of the
+// inter-op task graph, contain infeeds, outfeeds, sends or receives, which may
+// block until the host or another program makes progress.
+bool PerformsHostTransfers(const HloInstruction& instruction);
+
+/**
+ * Prepares the entry computation for the inter-op task graph of the
+ * sequential CPU backend (see runtime_task_graph.h) by outlining every
+ * top-level instruction other than parameters and constants into a kCall.
+ * Each such kCall becomes one task.
+ *
+ * Chains of instructions in which each instruction is the sole user of the
+ * previous one, and has no other operands besides parameters and constants,
+ * are outlined together: splitting them would add scheduling overhead without
+ * exposing any parallelism.  Instructions partitioned by ParallelTaskAssigner
+ * keep their own task, which forks and joins on the intra-op thread pool.
+ *
+ * Instructions with side effects are chained by control dependencies in
+ * post order, so that their tasks run in program order.
+ *
+ * Must run after copy insertion, and requires a buffer assignment that only
+ * orders instructions by their dependencies (DependencyHloOrdering).
+ */
+class InterOpParallelization : public HloPassInterface {
+ public:
+  InterOpParallelization() = default;
+  ~InterOpParallelization() override = default;
+
+  tensorflow::StringPiece name() const override {
+    return "cpu-inter-op-parallelization";
+  }
+
+  StatusOr<bool> Run(HloModule* module) override;
+
+ private:
+  // Returns whether 'instruction' is partitioned or calls a computation whose
+  // root is.
+  static bool IsPartitioned(const HloInstruction* instruction);
+
+  // Returns whether 'user', the sole user of 'instruction', can be outlined
+  // into the same task as 'instruction'.
+  static bool CanOutlineWithUser(const HloInstruction* instruction,
+                                 const HloInstruction* user);
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_INTER_OP_PARALLELIZATION_H_
@@ -23,6 +23,9 @@ limitations under the License.
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <numeric>
+#include <set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -40,13 +43,21 @@ limitations under the License.
 #include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/map_util.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/batch_dot_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/elemental_ir_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelization.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_function.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_loop_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_channel.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_fft_plan.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_sort.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_task_graph.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_xfeed_ring.h"
 #include "tensorflow/compiler/xla/service/cpu/shape_partition.h"
 #include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
 #include "tensorflow/compiler/xla/service/elemental_ir_emitter.h"
@@ -55,6 +66,8 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/llvm_ir/llvm_loop.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/llvm_util.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/ops.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/philox_rng.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/tiled_loop_emitter.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/tuple_ops.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
@@ -97,6 +110,7 @@ IrEmitter::IrEmitter(
       hlo_module_config_(hlo_module.config()),
       parallel_cpu_backend_(
           options::CpuParallelBackendRequested(hlo_module_config_)),
+      inter_op_parallelism_(InterOpParallelismRequested(hlo_module_config_)),
       is_top_level_computation_(false),
       target_machine_features_(target_machine),
       external_constant_pool_(external_constant_pool) {
@@ -212,10 +226,67 @@ Status IrEmitter::HandleCopy(HloInstruction* copy) {
     // kCopy shallow copies a tuple so just memcpy the top-level buffer.
     TF_RETURN_IF_ERROR(EmitTargetAddressForOp(copy));
     return EmitMemcpy(*(copy->operand(0)), *copy);
-  } else {
-    // Use the elemental emitter for non-tuple shapes.
-    return DefaultAction(copy);
   }
+  // A copy which changes the layout is a transpose in memory.
+  std::vector<int64> identity(ShapeUtil::Rank(copy->shape()));
+  std::iota(identity.begin(), identity.end(), 0);
+  TF_ASSIGN_OR_RETURN(bool emitted, EmitTiledTranspose(copy, identity));
+  if (emitted) {
+    return Status::OK();
+  }
+  // Use the elemental emitter for other non-tuple shapes.
+  return DefaultAction(copy);
+}
+
+Status IrEmitter::HandleTranspose(HloInstruction* transpose) {
+  TF_ASSIGN_OR_RETURN(bool emitted,
+                      EmitTiledTranspose(transpose, transpose->dimensions()));
+  if (emitted) {
+    return Status::OK();
+  }
+  return DefaultAction(transpose);
+}
+
+StatusOr<bool> IrEmitter::EmitTiledTranspose(
+    HloInstruction* hlo, tensorflow::gtl::ArraySlice<int64> permutation) {
+  const HloInstruction* operand = hlo->operand(0);
+  const Shape& shape = hlo->shape();
+  if (ShapeUtil::Rank(shape) < 2 || !LayoutUtil::IsDenseArray(shape) ||
+      !LayoutUtil::IsDenseArray(operand->shape())) {
+    return false;
+  }
+  const int64 source_minor_dimension =
+      llvm_ir::TiledLoopEmitter::SourceMinorDimension(operand->shape(),
+                                                      permutation);
+  if (source_minor_dimension == LayoutUtil::Minor(shape.layout(), 0)) {
+    return false;
+  }
+
+  // Pick the largest power-of-two tile size for which a source tile and a
+  // target tile together fit in half of a typical 32KB L1 data cache.
+  const int64 kTileBytes = 16 * 1024;
+  const int64 element_bytes =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+  int64 tile_size = 1;
+  while (2 * (2 * tile_size) * (2 * tile_size) * element_bytes <= kTileBytes) {
+    tile_size *= 2;
+  }
+  // Transpose full tiles in blocks of one vector register per row.
+  const int64 vector_size = target_machine_features_.vector_register_byte_size(
+                                *compute_function_->function()) /
+                            element_bytes;
+
+  // A partitioned transpose is tiled within each partition.
+  std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds;
+  if (ShouldEmitParallelLoopFor(*hlo)) {
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(hlo));
+  llvm_ir::TiledLoopEmitter emitter(GetIrArrayFor(operand), permutation,
+                                    GetIrArrayFor(hlo), tile_size, vector_size,
+                                    &ir_builder_, dynamic_loop_bounds);
+  TF_RETURN_IF_ERROR(emitter.EmitLoop(IrName(hlo)));
+  return true;
 }
 
 // Calculate the alignment of a buffer with a particular size.
@@ -334,6 +405,26 @@ Status IrEmitter::HandleInfeed(HloInstruction* infeed) {
 
   const Shape& shape = infeed->shape();
 
+  // With xfeed rings the users can read the infeed's value straight out of its
+  // slot, which is released after the last of them (see Postprocess).  This
+  // saves the copy into the infeed's own buffer.
+  if (UseXfeedRing() && CanReadInfeedInPlace(*infeed)) {
+    TF_ASSIGN_OR_RETURN(int32 length, GetXfeedBufferLength(shape));
+    int32 shape_length;
+    TF_ASSIGN_OR_RETURN(llvm::Value * shape_ptr,
+                        llvm_ir::EncodeSelfDescribingShapeConstant(
+                            shape, &shape_length, &ir_builder_));
+    llvm::Value* slot = ir_builder_.CreateCall(
+        GetXfeedFunctions(XfeedKind::kInfeed).first,
+        {ir_builder_.getInt32(length), shape_ptr,
+         ir_builder_.getInt32(shape_length)});
+    emitted_value_[infeed] = ir_builder_.CreateBitCast(
+        slot, IrShapeType(shape)->getPointerTo(), AsStringRef(IrName(infeed)));
+    in_place_infeeds_[infeed] = {slot, shape_ptr, shape_length, length,
+                                 infeed->user_count()};
+    return Status::OK();
+  }
+
   // The infeed operation produces data (dequeued from the infeed queue) at this
   // address, which has been provided by buffer assignment.
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(infeed));
@@ -377,8 +468,7 @@ Status IrEmitter::HandleInfeed(HloInstruction* infeed) {
   return Status::OK();
 }
 
-Status IrEmitter::EmitXfeedTransfer(XfeedKind kind, const Shape& shape,
-                                    llvm::Value* program_buffer_address) {
+StatusOr<int32> IrEmitter::GetXfeedBufferLength(const Shape& shape) {
   int64 length = ByteSizeOf(shape);
   if (length <= 0 || length > std::numeric_limits<int32>::max()) {
     return InvalidArgument(
@@ -386,12 +476,39 @@ Status IrEmitter::EmitXfeedTransfer(XfeedKind kind, const Shape& shape,
         "size range",
         length);
   }
-  int32 length_32 = static_cast<int32>(length);
+  if (UseXfeedRing() &&
+      length > hlo_module_config_.debug_options()
+                   .xla_cpu_xfeed_ring_slot_bytes()) {
+    return InvalidArgument(
+        "xfeed (infeed or outfeed) buffer length %lld does not fit in an "
+        "xfeed ring slot of %lld bytes",
+        length,
+        hlo_module_config_.debug_options().xla_cpu_xfeed_ring_slot_bytes());
+  }
+  return static_cast<int32>(length);
+}
 
-  int32 shape_length;
-  TF_ASSIGN_OR_RETURN(llvm::Value * shape_ptr,
-                      llvm_ir::EncodeSelfDescribingShapeConstant(
-                          shape, &shape_length, &ir_builder_));
+bool IrEmitter::UseXfeedRing() const {
+  return hlo_module_config_.debug_options().xla_cpu_xfeed_ring_slots() > 0;
+}
+
+std::pair<llvm::Function*, llvm::Function*> IrEmitter::GetXfeedFunctions(
+    XfeedKind kind) {
+  const char* acquire_name;
+  const char* release_name;
+  if (kind == XfeedKind::kInfeed && UseXfeedRing()) {
+    acquire_name = runtime::kAcquireInfeedRingSlotSymbolName;
+    release_name = runtime::kReleaseInfeedRingSlotSymbolName;
+  } else if (kind == XfeedKind::kInfeed) {
+    acquire_name = runtime::kAcquireInfeedBufferForDequeueSymbolName;
+    release_name = runtime::kReleaseInfeedBufferAfterDequeueSymbolName;
+  } else if (UseXfeedRing()) {
+    acquire_name = runtime::kAcquireOutfeedRingSlotSymbolName;
+    release_name = runtime::kReleaseOutfeedRingSlotSymbolName;
+  } else {
+    acquire_name = runtime::kAcquireOutfeedBufferForPopulationSymbolName;
+    release_name = runtime::kReleaseOutfeedBufferAfterPopulationSymbolName;
+  }
 
   // The signature of the acquire infeed buffer function is:
   //
@@ -401,15 +518,8 @@ Status IrEmitter::EmitXfeedTransfer(XfeedKind kind, const Shape& shape,
   llvm::FunctionType* acquire_type = llvm::FunctionType::get(
       i8_ptr_type, {int32_type, i8_ptr_type, int32_type},
       /*isVarArg=*/false);
-
-  llvm::Function* acquire_func;
-  if (kind == XfeedKind::kInfeed) {
-    acquire_func = llvm::cast<llvm::Function>(module_->getOrInsertFunction(
-        runtime::kAcquireInfeedBufferForDequeueSymbolName, acquire_type));
-  } else {
-    acquire_func = llvm::cast<llvm::Function>(module_->getOrInsertFunction(
-        runtime::kAcquireOutfeedBufferForPopulationSymbolName, acquire_type));
-  }
+  llvm::Function* acquire_func = llvm::cast<llvm::Function>(
+      module_->getOrInsertFunction(acquire_name, acquire_type));
   acquire_func->setCallingConv(llvm::CallingConv::C);
 
   // The signature of the release infeed buffer function is:
@@ -419,16 +529,51 @@ Status IrEmitter::EmitXfeedTransfer(XfeedKind kind, const Shape& shape,
       ir_builder_.getVoidTy(),
       {int32_type, i8_ptr_type, i8_ptr_type, int32_type},
       /*isVarArg=*/false);
+  llvm::Function* release_func = llvm::cast<llvm::Function>(
+      module_->getOrInsertFunction(release_name, release_type));
+  release_func->setCallingConv(llvm::CallingConv::C);
 
-  llvm::Function* release_func;
-  if (kind == XfeedKind::kInfeed) {
-    release_func = llvm::cast<llvm::Function>(module_->getOrInsertFunction(
-        runtime::kReleaseInfeedBufferAfterDequeueSymbolName, release_type));
-  } else {
-    release_func = llvm::cast<llvm::Function>(module_->getOrInsertFunction(
-        runtime::kReleaseOutfeedBufferAfterPopulationSymbolName, release_type));
+  return {acquire_func, release_func};
+}
+
+bool IrEmitter::CanReadInfeedInPlace(const HloInstruction& infeed) const {
+  if (ShapeUtil::IsTuple(infeed.shape()) || infeed.user_count() == 0 ||
+      &infeed == infeed.parent()->root_instruction()) {
+    return false;
   }
-  release_func->setCallingConv(llvm::CallingConv::C);
+  for (const HloInstruction* user : infeed.users()) {
+    switch (user->opcode()) {
+      case HloOpcode::kBitcast:
+      case HloOpcode::kCall:
+      case HloOpcode::kConditional:
+      case HloOpcode::kCustomCall:
+      case HloOpcode::kTuple:
+      case HloOpcode::kWhile:
+        return false;
+      default:
+        break;
+    }
+    // A user updating the infeed's buffer in place (e.g. a dynamic update
+    // slice) expects it to hold the infeed's value.
+    if (assignment_.SharesTopLevelSlice(user, &infeed)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status IrEmitter::EmitXfeedTransfer(XfeedKind kind, const Shape& shape,
+                                    llvm::Value* program_buffer_address) {
+  TF_ASSIGN_OR_RETURN(int32 length_32, GetXfeedBufferLength(shape));
+
+  int32 shape_length;
+  TF_ASSIGN_OR_RETURN(llvm::Value * shape_ptr,
+                      llvm_ir::EncodeSelfDescribingShapeConstant(
+                          shape, &shape_length, &ir_builder_));
+
+  llvm::Function* acquire_func;
+  llvm::Function* release_func;
+  std::tie(acquire_func, release_func) = GetXfeedFunctions(kind);
 
   // Implementation note: this call informs the runtime that it wants a buffer
   // of size exactly 'length_32', and the runtime is responsible for
@@ -482,8 +627,73 @@ Status IrEmitter::HandleOutfeed(HloInstruction* outfeed) {
 }
 
 Status IrEmitter::HandleSort(HloInstruction* sort) {
-  // TODO(b/26783907): Implement sort on CPU.
-  return Unimplemented("Sort is not implemented on CPU.");
+  const HloInstruction* operand = sort->operand(0);
+  TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
+      /*instruction=*/*sort, /*operands=*/{operand},
+      /*supported_types=*/{F32, F64, S32, S64}));
+  const Shape& shape = sort->shape();
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(operand->shape().layout()));
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(shape.layout()));
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(sort));
+
+  // The runtime sorts in place, so start from a copy of the operand unless
+  // buffer assignment made the sort reuse the operand's buffer.
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice operand_slice,
+                      assignment_.GetUniqueTopLevelSlice(operand));
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice sort_slice,
+                      assignment_.GetUniqueTopLevelSlice(sort));
+  if (operand_slice != sort_slice) {
+    TF_RETURN_IF_ERROR(EmitMemcpy(*operand, *sort));
+  }
+  if (ShapeUtil::Rank(shape) == 0 || ShapeUtil::HasZeroElements(shape)) {
+    return Status::OK();
+  }
+
+  // Sort along the minor dimension; with a row-major layout every other
+  // dimension just contributes independent rows.
+  const int64 row_length = shape.dimensions(ShapeUtil::Rank(shape) - 1);
+  const int64 num_rows = ShapeUtil::ElementsIn(shape) / row_length;
+  const char* fn_name = nullptr;
+  switch (shape.element_type()) {
+    case F32:
+      fn_name = runtime::kSortF32SymbolName;
+      break;
+    case F64:
+      fn_name = runtime::kSortF64SymbolName;
+      break;
+    case S32:
+      fn_name = runtime::kSortS32SymbolName;
+      break;
+    case S64:
+      fn_name = runtime::kSortS64SymbolName;
+      break;
+    default:
+      return Unimplemented("Element type %s not supported in the Sort op.",
+                           PrimitiveType_Name(shape.element_type()).c_str());
+  }
+
+  llvm::Type* int8_ptr_type = ir_builder_.getInt8Ty()->getPointerTo();
+  llvm::Type* int64_type = ir_builder_.getInt64Ty();
+  llvm::FunctionType* sort_type = llvm::FunctionType::get(
+      ir_builder_.getVoidTy(),
+      {int8_ptr_type, int8_ptr_type, int8_ptr_type, int64_type, int64_type,
+       int64_type},
+      /*isVarArg=*/false);
+  llvm::Function* sort_func = llvm::cast<llvm::Function>(
+      module_->getOrInsertFunction(fn_name, sort_type));
+  sort_func->setCallingConv(llvm::CallingConv::C);
+  sort_func->setDoesNotThrow();
+  sort_func->setOnlyAccessesInaccessibleMemOrArgMem();
+  // kSort only has keys in this HLO, so no values are passed along.
+  ir_builder_.CreateCall(
+      sort_func,
+      {GetExecutableRunOptionsArgument(),
+       ir_builder_.CreateBitCast(GetEmittedValueFor(sort), int8_ptr_type),
+       llvm::ConstantPointerNull::get(
+           llvm::cast<llvm::PointerType>(int8_ptr_type)),
+       ir_builder_.getInt64(0), ir_builder_.getInt64(num_rows),
+       ir_builder_.getInt64(row_length)});
+  return Status::OK();
 }
 
 Status IrEmitter::HandleTuple(HloInstruction* tuple) {
@@ -499,10 +709,8 @@ Status IrEmitter::HandleTuple(HloInstruction* tuple) {
 Status IrEmitter::HandleMap(HloInstruction* map) {
   gtl::ArraySlice<HloInstruction*> operands(map->operands());
   HloComputation* function = map->to_apply();
-  // The called computation should have been emitted previously.
-  llvm::Function* mapped_ir_function = FindOrDie(emitted_functions_, function);
 
-  return EmitTargetElementLoop(map, [this, map, operands, mapped_ir_function](
+  return EmitTargetElementLoop(map, [this, map, operands, function](
                                         const llvm_ir::IrArray::Index& index) {
     std::vector<llvm::Value*> parameter_addresses;
     for (const HloInstruction* operand : operands) {
@@ -510,11 +718,258 @@ Status IrEmitter::HandleMap(HloInstruction* map) {
       parameter_addresses.push_back(
           array.EmitArrayElementAddress(index, &ir_builder_));
     }
-    return EmitElementFunctionCall(mapped_ir_function, map->shape(),
-                                   parameter_addresses, "map_function");
+    return EmitScalarComputation(function, map->shape(), parameter_addresses,
+                                 "map_function");
   });
 }
 
+StatusOr<bool> IrEmitter::EmitSlidingWindowReduce(
+    HloInstruction* reduce_window, string* failure_reason) {
+  // Shorter windows are cheaper to re-walk than to scan three times.
+  const int64 kMinSlidingWindowSize = 8;
+  // Both scan buffers of a minor tile of lines live on the stack.
+  const int64 kMaxSlidingWindowLineBytes = 64 * 1024;
+
+  const HloInstruction* operand = reduce_window->operand(0);
+  const Window& window = reduce_window->window();
+  const Shape& shape = reduce_window->shape();
+  if (shape.element_type() != F32) {
+    *failure_reason = "only F32 is supported";
+    return false;
+  }
+  if (ShouldEmitParallelLoopFor(*reduce_window)) {
+    *failure_reason = "emitted as a parallel loop";
+    return false;
+  }
+
+  // Find the single dimension along which the window slides.
+  int64 sliding_dimension = -1;
+  for (int64 i = 0; i < window.dimensions_size(); ++i) {
+    const WindowDimension& dimension = window.dimensions(i);
+    if (dimension.size() == 1 && dimension.stride() == 1 &&
+        dimension.padding_low() == 0 && dimension.padding_high() == 0) {
+      continue;
+    }
+    if (sliding_dimension != -1) {
+      *failure_reason = "window extends along more than one dimension";
+      return false;
+    }
+    sliding_dimension = i;
+  }
+  if (sliding_dimension == -1 || ShapeUtil::HasZeroElements(shape)) {
+    *failure_reason = "window is trivial";
+    return false;
+  }
+  const WindowDimension& sliding = window.dimensions(sliding_dimension);
+  const int64 window_size = sliding.size();
+  const int64 stride = sliding.stride();
+  if (window_size < kMinSlidingWindowSize || stride >= window_size) {
+    *failure_reason = "windows are too small or do not overlap";
+    return false;
+  }
+  // The padded positions covered by some window, rounded up to whole blocks
+  // of window_size positions.
+  const int64 output_size = shape.dimensions(sliding_dimension);
+  const int64 block_count = CeilOfRatio(
+      (output_size - 1) * stride + window_size, window_size);
+  const int64 line_size = block_count * window_size;
+  // Each scan step covers a tile of the minor dimension, which is then the
+  // innermost loop, so that consecutive iterations touch consecutive
+  // addresses.  The tile is the widest divisor of the minor dimension whose
+  // scan buffers fit.
+  const int64 minor_dimension = LayoutUtil::Minor(shape.layout(), 0);
+  const bool has_minor_tile = minor_dimension != sliding_dimension;
+  const int64 minor_size =
+      has_minor_tile ? shape.dimensions(minor_dimension) : 1;
+  const int64 max_minor_tile =
+      kMaxSlidingWindowLineBytes /
+      (2 * line_size * static_cast<int64>(sizeof(float)));
+  if (max_minor_tile < 1) {
+    *failure_reason = "window line does not fit the scan buffers";
+    return false;
+  }
+  int64 minor_tile = std::min(minor_size, max_minor_tile);
+  while (minor_size % minor_tile != 0) {
+    --minor_tile;
+  }
+
+  HloComputation* function = reduce_window->to_apply();
+  ReductionGenerator reduction_generator =
+      MatchReductionGenerator(function, failure_reason);
+  if (!reduction_generator) {
+    return false;
+  }
+  const HloOpcode reducer_opcode = function->root_instruction()->opcode();
+  if ((reducer_opcode == HloOpcode::kAdd ||
+       reducer_opcode == HloOpcode::kMultiply) &&
+      !hlo_module_config_.debug_options().xla_enable_fast_math()) {
+    *failure_reason =
+        "reassociating a floating-point reduction requires fast math";
+    return false;
+  }
+
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(reduce_window));
+
+  // The van Herk/Gil-Werman algorithm, on each line of the operand along the
+  // sliding dimension.  The padded line is cut into blocks of window_size
+  // positions, and two scans compute the running reduction of each block
+  // from its start (prefix) and from its end (suffix).  A window starting at
+  // a block boundary is exactly one block; any other window spans the tail
+  // of one block and the head of the next, so that
+  //
+  //   output[o] = suffix[o * stride] (aligned), or
+  //               reduce(suffix[o * stride], prefix[o * stride + size - 1])
+  //
+  // Every output then costs a constant number of reductions, whatever the
+  // window size.  Positions in the padding read as the init value.  The
+  // lines of one minor tile are processed together: the scan buffers hold
+  // line_size x minor_tile elements, position-major.
+  llvm::Type* element_ir_type = llvm_ir::PrimitiveTypeToIrType(F32, module_);
+  const int alignment = MinimumAlignmentForPrimitiveType(F32);
+  llvm::Value* prefix = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      element_ir_type, ir_builder_.getInt64(line_size * minor_tile), "prefix",
+      &ir_builder_, alignment);
+  llvm::Value* suffix = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      element_ir_type, ir_builder_.getInt64(line_size * minor_tile), "suffix",
+      &ir_builder_, alignment);
+  llvm::Value* init_value =
+      ir_builder_.CreateLoad(GetEmittedValueFor(reduce_window->operand(1)));
+
+  std::vector<int64> line_dimensions;
+  for (int64 i = 0; i < ShapeUtil::Rank(shape); ++i) {
+    if (i != sliding_dimension && !(has_minor_tile && i == minor_dimension)) {
+      line_dimensions.push_back(i);
+    }
+  }
+  llvm_ir::ForLoopNest line_loops(IrName(reduce_window, "line"),
+                                  &ir_builder_);
+  llvm_ir::IrArray::Index line_index =
+      line_loops.AddLoopsForShapeOnDimensions(shape, line_dimensions, "dim");
+  std::unique_ptr<llvm_ir::ForLoop> tile_loop =
+      line_loops.AddLoop(0, minor_size / minor_tile, "tile");
+  SetToFirstInsertPoint(line_loops.GetInnerLoopBodyBasicBlock(), &ir_builder_);
+  llvm::BasicBlock* line_loops_exit_bb =
+      line_loops.GetOuterLoopExitBasicBlock();
+  llvm::Value* tile_start = ir_builder_.CreateNSWMul(
+      tile_loop->GetIndVarValue(), ir_builder_.getInt64(minor_tile));
+
+  // Returns the index of 'reduce_window' or its operand at 'position' along
+  // the sliding dimension, and at 'minor' within the tile.
+  auto line_element_index = [&](llvm::Value* position, llvm::Value* minor) {
+    llvm_ir::IrArray::Index index = line_index;
+    index[sliding_dimension] = position;
+    if (has_minor_tile) {
+      index[minor_dimension] = ir_builder_.CreateNSWAdd(tile_start, minor);
+    }
+    return index;
+  };
+  // Returns the address of the scan buffer element at 'position' and
+  // 'minor'.
+  auto buffer_element = [&](llvm::Value* buffer, llvm::Value* position,
+                            llvm::Value* minor) {
+    return ir_builder_.CreateInBoundsGEP(
+        buffer, {ir_builder_.CreateNSWAdd(
+                    ir_builder_.CreateNSWMul(position,
+                                             ir_builder_.getInt64(minor_tile)),
+                    minor)});
+  };
+
+  llvm_ir::IrArray input_array(GetIrArrayFor(operand));
+  const int64 input_size = operand->shape().dimensions(sliding_dimension);
+  // Reads the operand at padded position 'position' of the line.  The load
+  // address is clamped into the line, so that it is valid in the padding too;
+  // a line without operand elements is all padding and is not read.
+  auto read_padded = [&](llvm::Value* position, llvm::Value* minor) {
+    if (input_size == 0) {
+      return init_value;
+    }
+    llvm::Value* input_position = ir_builder_.CreateNSWSub(
+        position, ir_builder_.getInt64(sliding.padding_low()));
+    llvm::Value* in_bounds = ir_builder_.CreateICmpULT(
+        input_position, ir_builder_.getInt64(input_size));
+    const llvm_ir::IrArray::Index input_index = line_element_index(
+        ir_builder_.CreateSelect(in_bounds, input_position,
+                                 ir_builder_.getInt64(0)),
+        minor);
+    return ir_builder_.CreateSelect(
+        in_bounds, input_array.EmitReadArrayElement(input_index, &ir_builder_),
+        init_value);
+  };
+  // Fills 'buffer' with the running reduction of each block, from the start
+  // of the block or, if 'from_end', from its end.
+  auto emit_block_scan = [&](llvm::Value* buffer, bool from_end,
+                             tensorflow::StringPiece name) {
+    llvm_ir::ForLoopNest loops(IrName(reduce_window, name), &ir_builder_);
+    std::unique_ptr<llvm_ir::ForLoop> block_loop =
+        loops.AddLoop(0, block_count, "block");
+    std::unique_ptr<llvm_ir::ForLoop> step_loop =
+        loops.AddLoop(0, window_size, "step");
+    std::unique_ptr<llvm_ir::ForLoop> minor_loop =
+        loops.AddLoop(0, minor_tile, "minor");
+    llvm::Value* step = step_loop->GetIndVarValue();
+    llvm::Value* minor = minor_loop->GetIndVarValue();
+    SetToFirstInsertPoint(loops.GetInnerLoopBodyBasicBlock(), &ir_builder_);
+    llvm::Value* block_start =
+        ir_builder_.CreateNSWMul(block_loop->GetIndVarValue(),
+                                 ir_builder_.getInt64(window_size));
+    llvm::Value* position =
+        from_end ? ir_builder_.CreateNSWAdd(
+                       block_start,
+                       ir_builder_.CreateNSWSub(
+                           ir_builder_.getInt64(window_size - 1), step))
+                 : ir_builder_.CreateNSWAdd(block_start, step);
+    llvm::Value* is_first =
+        ir_builder_.CreateICmpEQ(step, ir_builder_.getInt64(0));
+    llvm::Value* previous_position = ir_builder_.CreateSelect(
+        is_first, position,
+        from_end ? ir_builder_.CreateNSWAdd(position, ir_builder_.getInt64(1))
+                 : ir_builder_.CreateNSWSub(position, ir_builder_.getInt64(1)));
+    llvm::Value* previous = ir_builder_.CreateAlignedLoad(
+        buffer_element(buffer, previous_position, minor), alignment);
+    llvm::Value* value = read_padded(position, minor);
+    llvm::Value* reduced = reduction_generator(&ir_builder_, previous, value);
+    ir_builder_.CreateAlignedStore(
+        ir_builder_.CreateSelect(is_first, value, reduced),
+        buffer_element(buffer, position, minor), alignment);
+    SetToFirstInsertPoint(loops.GetOuterLoopExitBasicBlock(), &ir_builder_);
+  };
+  emit_block_scan(prefix, /*from_end=*/false, "prefix_scan");
+  emit_block_scan(suffix, /*from_end=*/true, "suffix_scan");
+
+  llvm_ir::ForLoopNest output_loops(IrName(reduce_window, "output"),
+                                    &ir_builder_);
+  std::unique_ptr<llvm_ir::ForLoop> output_loop =
+      output_loops.AddLoop(0, output_size, "window");
+  std::unique_ptr<llvm_ir::ForLoop> output_minor_loop =
+      output_loops.AddLoop(0, minor_tile, "minor");
+  llvm::Value* output_position = output_loop->GetIndVarValue();
+  llvm::Value* output_minor = output_minor_loop->GetIndVarValue();
+  SetToFirstInsertPoint(output_loops.GetInnerLoopBodyBasicBlock(),
+                        &ir_builder_);
+  llvm::Value* window_start =
+      ir_builder_.CreateNSWMul(output_position, ir_builder_.getInt64(stride));
+  llvm::Value* window_end = ir_builder_.CreateNSWAdd(
+      window_start, ir_builder_.getInt64(window_size - 1));
+  llvm::Value* head = ir_builder_.CreateAlignedLoad(
+      buffer_element(suffix, window_start, output_minor), alignment);
+  llvm::Value* tail = ir_builder_.CreateAlignedLoad(
+      buffer_element(prefix, window_end, output_minor), alignment);
+  llvm::Value* is_aligned = ir_builder_.CreateICmpEQ(
+      ir_builder_.CreateURem(window_start, ir_builder_.getInt64(window_size)),
+      ir_builder_.getInt64(0));
+  GetIrArrayFor(reduce_window)
+      .EmitWriteArrayElement(
+          line_element_index(output_position, output_minor),
+          ir_builder_.CreateSelect(
+              is_aligned, head, reduction_generator(&ir_builder_, head, tail)),
+          &ir_builder_);
+  SetToFirstInsertPoint(output_loops.GetOuterLoopExitBasicBlock(),
+                        &ir_builder_);
+
+  ir_builder_.SetInsertPoint(line_loops_exit_bb);
+  return true;
+}
+
 Status IrEmitter::HandleReduceWindow(HloInstruction* reduce_window) {
   auto operand = reduce_window->operand(0);
   const Window& window = reduce_window->window();
@@ -529,8 +984,16 @@ Status IrEmitter::HandleReduceWindow(HloInstruction* reduce_window) {
         "Dilation for ReduceWindow is not implemented on CPU.");
   }
 
-  // The called computation should have been emitted previously.
-  llvm::Function* reducer_function = FindOrDie(emitted_functions_, function);
+  string sliding_window_failure_reason;
+  TF_ASSIGN_OR_RETURN(
+      bool emitted_sliding_window,
+      EmitSlidingWindowReduce(reduce_window, &sliding_window_failure_reason));
+  if (emitted_sliding_window) {
+    VLOG(1) << "Emitted sliding-window reduction " << reduce_window->ToString();
+    return Status::OK();
+  }
+  VLOG(1) << "Could not emit sliding-window reduction "
+          << reduce_window->ToString() << ": " << sliding_window_failure_reason;
 
   // Pseudo code for reduce window:
   //
@@ -544,10 +1007,11 @@ Status IrEmitter::HandleReduceWindow(HloInstruction* reduce_window) {
   //     output(O) = value;
   //
   // This is completely un-optimized and just here to have something
-  // that works.
+  // that works; large overlapping windows along one dimension are handled by
+  // EmitSlidingWindowReduce above.
   return EmitTargetElementLoop(
       reduce_window, [this, reduce_window, operand, window,
-                      reducer_function](const llvm_ir::IrArray::Index& index) {
+                      function](const llvm_ir::IrArray::Index& index) {
         // We fold inputs into the accumulator and initialize it to
         // the initial value on the reduce_window.
         PrimitiveType operand_element_type = operand->shape().element_type();
@@ -605,9 +1069,11 @@ Status IrEmitter::HandleReduceWindow(HloInstruction* reduce_window) {
         llvm_ir::IrArray input_array(GetIrArrayFor(operand));
         llvm::Value* input_value_address =
             input_array.EmitArrayElementAddress(input_index, &ir_builder_);
-        llvm::Value* result = EmitElementFunctionCall(
-            reducer_function, reduce_window->shape(),
-            {accumulator_address, input_value_address}, "reducer_function");
+        TF_ASSIGN_OR_RETURN(
+            llvm::Value * result,
+            EmitScalarComputation(function, reduce_window->shape(),
+                                  {accumulator_address, input_value_address},
+                                  "reducer_function"));
         ir_builder_.CreateStore(result, accumulator_address);
 
         SetToFirstInsertPoint(loops.GetOuterLoopExitBasicBlock(), &ir_builder_);
@@ -626,17 +1092,8 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
   CHECK_EQ(rank, ShapeUtil::Rank(source->shape()));
   CHECK_EQ(rank, window.dimensions_size());
 
-  // TODO(b/31410564): Implement dilation for select-and-scatter.
-  if (window_util::HasDilation(window)) {
-    return Unimplemented(
-        "Dilation for SelectAndScatter is not implemented on CPU. ");
-  }
-
-  // The select and scatter computations should have been emitted previously.
-  llvm::Function* select_function =
-      FindOrDie(emitted_functions_, select_and_scatter->select());
-  llvm::Function* scatter_function =
-      FindOrDie(emitted_functions_, select_and_scatter->scatter());
+  HloComputation* select_function = select_and_scatter->select();
+  HloComputation* scatter_function = select_and_scatter->scatter();
 
   // Pseudo code for select-and-scatter:
   //
@@ -647,8 +1104,9 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
   // for (coordinates S in the source) {
   //   initialized_flag = false
   //   for (coordinates W in the window) {
-  //     I = S * stride + W - pad_low
-  //     if I within bounds of operand:
+  //     D = S * stride + W * window_dilation - pad_low
+  //     I = D / base_dilation
+  //     if D is a multiple of base_dilation and I within bounds of operand:
   //       if !initialized_flag or select(selected_value, operand(I)) == false:
   //         selected_value = operand(I)
   //         selected_index = I
@@ -657,6 +1115,10 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
   //   output(selected_index) = scatter(output(selected_index), source(S))
   // }
   //
+  // When emitted as a parallel loop, each task visits the part of the source
+  // in its partition of the outer dimensions.  ParallelTaskAssigner only
+  // partitions dimensions along which the window neither extends nor moves,
+  // so that part only ever scatters into the task's own part of the output.
 
   // Initialize the output array with the given init_value.
   TF_RETURN_IF_ERROR(EmitTargetElementLoop(
@@ -668,8 +1130,39 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
 
   // Create a loop to iterate over the source array to scatter to the output.
   llvm_ir::ForLoopNest source_loops(IrName(select_and_scatter), &ir_builder_);
-  const llvm_ir::IrArray::Index source_index =
-      source_loops.AddLoopsForShape(source->shape(), "source");
+  llvm_ir::IrArray::Index source_index(rank);
+  std::vector<bool> is_partitioned_dimension(rank, false);
+  if (ShouldEmitParallelLoopFor(*select_and_scatter)) {
+    std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds =
+        compute_function_->GetDynamicLoopBounds();
+    for (size_t i = 0; i < dynamic_loop_bounds.size(); ++i) {
+      const int64 dimension =
+          LayoutUtil::Major(select_and_scatter->shape().layout(), i);
+      const WindowDimension& window_dimension = window.dimensions(dimension);
+      TF_RET_CHECK(window_dimension.size() == 1 &&
+                   window_dimension.stride() == 1 &&
+                   window_dimension.padding_low() == 0 &&
+                   window_dimension.base_dilation() == 1)
+          << "select-and-scatter partitioned on a dimension its window spans";
+      std::unique_ptr<llvm_ir::ForLoop> loop = source_loops.AddLoop(
+          tensorflow::strings::Printf("source_partition.%lld", dimension),
+          dynamic_loop_bounds[i].first, dynamic_loop_bounds[i].second);
+      source_index[dimension] = loop->GetIndVarValue();
+      is_partitioned_dimension[dimension] = true;
+    }
+  }
+  std::vector<int64> unpartitioned_dimensions;
+  for (int64 i = 0; i < rank; ++i) {
+    if (!is_partitioned_dimension[i]) {
+      unpartitioned_dimensions.push_back(i);
+    }
+  }
+  const llvm_ir::IrArray::Index unpartitioned_index =
+      source_loops.AddLoopsForShapeOnDimensions(
+          source->shape(), unpartitioned_dimensions, "source");
+  for (int64 i : unpartitioned_dimensions) {
+    source_index[i] = unpartitioned_index[i];
+  }
   SetToFirstInsertPoint(source_loops.GetInnerLoopBodyBasicBlock(),
                         &ir_builder_);
 
@@ -705,14 +1198,38 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
   llvm_ir::IrArray::Index operand_index(source_index.size());
   llvm::Value* in_bounds_condition = ir_builder_.getTrue();
   for (int64 i = 0; i < rank; ++i) {
+    const WindowDimension& window_dimension = window.dimensions(i);
+    const int64 operand_dimension_size =
+        ShapeUtil::GetDimension(operand->shape(), i);
     llvm::Value* strided_index = ir_builder_.CreateNSWMul(
-        source_index[i], ir_builder_.getInt64(window.dimensions(i).stride()));
-    operand_index[i] = ir_builder_.CreateNSWSub(
-        ir_builder_.CreateNSWAdd(strided_index, window_index[i]),
-        ir_builder_.getInt64(window.dimensions(i).padding_low()));
-    llvm::Value* index_condition = ir_builder_.CreateICmpULT(
-        operand_index[i],
-        ir_builder_.getInt64(ShapeUtil::GetDimension(operand->shape(), i)));
+        source_index[i], ir_builder_.getInt64(window_dimension.stride()));
+    llvm::Value* dilated_window_index = ir_builder_.CreateNSWMul(
+        window_index[i],
+        ir_builder_.getInt64(window_dimension.window_dilation()));
+    llvm::Value* dilated_index = ir_builder_.CreateNSWSub(
+        ir_builder_.CreateNSWAdd(strided_index, dilated_window_index),
+        ir_builder_.getInt64(window_dimension.padding_low()));
+    llvm::Value* index_condition;
+    if (window_dimension.base_dilation() == 1) {
+      operand_index[i] = dilated_index;
+      index_condition = ir_builder_.CreateICmpULT(
+          dilated_index, ir_builder_.getInt64(operand_dimension_size));
+    } else {
+      // Positions between the elements of the base-dilated operand are holes,
+      // which are never selected.
+      llvm::Value* base_dilation =
+          ir_builder_.getInt64(window_dimension.base_dilation());
+      operand_index[i] = ir_builder_.CreateUDiv(dilated_index, base_dilation);
+      index_condition = ir_builder_.CreateAnd(
+          ir_builder_.CreateICmpULT(
+              dilated_index,
+              ir_builder_.getInt64((operand_dimension_size - 1) *
+                                       window_dimension.base_dilation() +
+                                   1)),
+          ir_builder_.CreateICmpEQ(
+              ir_builder_.CreateURem(dilated_index, base_dilation),
+              ir_builder_.getInt64(0)));
+    }
     in_bounds_condition =
         ir_builder_.CreateAnd(in_bounds_condition, index_condition);
   }
@@ -753,9 +1270,11 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
   const Shape output_shape = ShapeUtil::MakeShape(PRED, {});
   llvm::Value* operand_address =
       operand_array.EmitArrayElementAddress(operand_index, &ir_builder_);
-  llvm::Value* result = EmitElementFunctionCall(
-      select_function, output_shape, {selected_value_address, operand_address},
-      "select_function");
+  TF_ASSIGN_OR_RETURN(
+      llvm::Value * result,
+      EmitScalarComputation(select_function, output_shape,
+                            {selected_value_address, operand_address},
+                            "select_function"));
 
   // If the 'select' function returns false, update the selected value and the
   // index to the currently visiting operand.
@@ -789,9 +1308,11 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
   llvm_ir::IrArray output_array(GetIrArrayFor(select_and_scatter));
   llvm::Value* output_value_address =
       output_array.EmitArrayElementAddress(selected_index, &ir_builder_);
-  llvm::Value* scatter_value = EmitElementFunctionCall(
-      scatter_function, source->shape(),
-      {output_value_address, source_value_address}, "scatter_function");
+  TF_ASSIGN_OR_RETURN(
+      llvm::Value * scatter_value,
+      EmitScalarComputation(scatter_function, source->shape(),
+                            {output_value_address, source_value_address},
+                            "scatter_function"));
   output_array.EmitWriteArrayElement(selected_index, scatter_value,
                                      &ir_builder_);
 
@@ -809,7 +1330,14 @@ Status IrEmitter::HandleDot(HloInstruction* dot) {
   const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
   if (dnums.lhs_batch_dimensions_size() > 0 ||
       dnums.rhs_batch_dimensions_size() > 0) {
-    return Unimplemented("Dot with batch dimensions not implemented.");
+    // Batch dots the runtime cannot handle were decomposed by DotDecomposer.
+    if (!PotentiallyImplementedAsEigenBatchDot(*dot)) {
+      return Unimplemented("Dot with batch dimensions not implemented.");
+    }
+    TF_RETURN_IF_ERROR(EmitTargetAddressForOp(dot));
+    return EmitBatchDotOperation(
+        *dot, GetIrArrayFor(dot), GetIrArrayFor(lhs), GetIrArrayFor(rhs),
+        GetExecutableRunOptionsArgument(), &ir_builder_, hlo_module_config_);
   }
 
   if (dnums.lhs_contracting_dimensions_size() != 1) {
@@ -847,6 +1375,211 @@ Status IrEmitter::HandleDot(HloInstruction* dot) {
       target_machine_features_);
 }
 
+void IrEmitter::EmitDirectConvolutionBlock(
+    const HloInstruction* convolution,
+    const llvm_ir::IrArray::Index& output_index,
+    llvm::Value* first_output_feature, int64 block_size) {
+  const HloInstruction* lhs = convolution->operand(0);
+  const HloInstruction* rhs = convolution->operand(1);
+  const Window& window = convolution->window();
+  const ConvolutionDimensionNumbers& dnums =
+      convolution->convolution_dimension_numbers();
+  const int num_spatial_dims = dnums.output_spatial_dimensions_size();
+  const int alignment = MinimumAlignmentForPrimitiveType(F32);
+
+  std::vector<llvm::Value*> accumulators(block_size);
+  for (int64 j = 0; j < block_size; ++j) {
+    accumulators[j] = llvm_ir::EmitAllocaAtFunctionEntry(
+        llvm_ir::PrimitiveTypeToIrType(F32, module_), "convolution_accumulator",
+        &ir_builder_, alignment);
+    ir_builder_.CreateAlignedStore(
+        llvm::ConstantFP::get(ir_builder_.getFloatTy(), 0.0), accumulators[j],
+        alignment);
+  }
+
+  llvm_ir::ForLoopNest kernel_loops(IrName(convolution, "kernel"),
+                                    &ir_builder_);
+  std::vector<llvm::Value*> kernel_spatial(num_spatial_dims);
+  for (int i = 0; i < num_spatial_dims; ++i) {
+    std::unique_ptr<llvm_ir::ForLoop> loop = kernel_loops.AddLoop(
+        0, rhs->shape().dimensions(dnums.kernel_spatial_dimensions(i)),
+        tensorflow::strings::StrCat("k", i));
+    kernel_spatial[i] = loop->GetIndVarValue();
+  }
+  if (llvm::BasicBlock* kernel_body_bb =
+          kernel_loops.GetInnerLoopBodyBasicBlock()) {
+    SetToFirstInsertPoint(kernel_body_bb, &ir_builder_);
+  }
+
+  // The input position only depends on the kernel position, so it is bounds
+  // checked once for all input features and all features of the block.
+  llvm_ir::IrArray::Index lhs_index(ShapeUtil::Rank(lhs->shape()));
+  lhs_index[dnums.input_batch_dimension()] =
+      output_index[dnums.output_batch_dimension()];
+  llvm::Value* in_bounds_condition = ir_builder_.getInt1(true);
+  for (int i = 0; i < num_spatial_dims; ++i) {
+    const WindowDimension& window_dim = window.dimensions(i);
+    const int64 input_size =
+        lhs->shape().dimensions(dnums.input_spatial_dimensions(i));
+    llvm::Value* dilated_index = ir_builder_.CreateNSWSub(
+        ir_builder_.CreateNSWAdd(
+            ir_builder_.CreateNSWMul(
+                output_index[dnums.output_spatial_dimensions(i)],
+                ir_builder_.getInt64(window_dim.stride())),
+            ir_builder_.CreateNSWMul(
+                kernel_spatial[i],
+                ir_builder_.getInt64(window_dim.window_dilation()))),
+        ir_builder_.getInt64(window_dim.padding_low()));
+    llvm::Value* dim_ok = ir_builder_.CreateICmpULT(
+        dilated_index, ir_builder_.getInt64(window_util::DilatedBound(
+                           input_size, window_dim.base_dilation())));
+    if (window_dim.base_dilation() == 1) {
+      lhs_index[dnums.input_spatial_dimensions(i)] = dilated_index;
+    } else {
+      llvm::Value* base_dilation =
+          ir_builder_.getInt64(window_dim.base_dilation());
+      lhs_index[dnums.input_spatial_dimensions(i)] =
+          ir_builder_.CreateUDiv(dilated_index, base_dilation);
+      dim_ok = ir_builder_.CreateAnd(
+          dim_ok, ir_builder_.CreateICmpEQ(
+                      ir_builder_.CreateURem(dilated_index, base_dilation),
+                      ir_builder_.getInt64(0)));
+    }
+    in_bounds_condition = ir_builder_.CreateAnd(in_bounds_condition, dim_ok);
+  }
+  llvm_ir::LlvmIfData if_in_bounds = llvm_ir::EmitIfThenElse(
+      in_bounds_condition, "in-bounds", &ir_builder_, /*emit_else=*/false);
+  SetToFirstInsertPoint(if_in_bounds.true_block, &ir_builder_);
+
+  llvm_ir::ForLoopNest input_feature_loops(IrName(convolution, "input_feature"),
+                                           &ir_builder_);
+  std::unique_ptr<llvm_ir::ForLoop> input_feature_loop =
+      input_feature_loops.AddLoop(
+          0, lhs->shape().dimensions(dnums.input_feature_dimension()), "iz");
+  SetToFirstInsertPoint(input_feature_loop->GetBodyBasicBlock(), &ir_builder_);
+  llvm::Value* input_feature = input_feature_loop->GetIndVarValue();
+  lhs_index[dnums.input_feature_dimension()] = input_feature;
+  llvm::Value* lhs_value =
+      GetIrArrayFor(lhs).EmitReadArrayElement(lhs_index, &ir_builder_);
+  llvm_ir::IrArray rhs_array(GetIrArrayFor(rhs));
+  llvm_ir::IrArray::Index rhs_index(ShapeUtil::Rank(rhs->shape()));
+  for (int i = 0; i < num_spatial_dims; ++i) {
+    rhs_index[dnums.kernel_spatial_dimensions(i)] = kernel_spatial[i];
+  }
+  rhs_index[dnums.kernel_input_feature_dimension()] = input_feature;
+  for (int64 j = 0; j < block_size; ++j) {
+    rhs_index[dnums.kernel_output_feature_dimension()] =
+        ir_builder_.CreateNSWAdd(first_output_feature, ir_builder_.getInt64(j));
+    llvm::Value* rhs_value =
+        rhs_array.EmitReadArrayElement(rhs_index, &ir_builder_);
+    ir_builder_.CreateAlignedStore(
+        ir_builder_.CreateFAdd(
+            ir_builder_.CreateAlignedLoad(accumulators[j], alignment),
+            ir_builder_.CreateFMul(lhs_value, rhs_value)),
+        accumulators[j], alignment);
+  }
+  SetToFirstInsertPoint(input_feature_loops.GetOuterLoopExitBasicBlock(),
+                        &ir_builder_);
+  SetToFirstInsertPoint(if_in_bounds.after_block, &ir_builder_);
+  if (llvm::BasicBlock* kernel_exit_bb =
+          kernel_loops.GetOuterLoopExitBasicBlock()) {
+    SetToFirstInsertPoint(kernel_exit_bb, &ir_builder_);
+  }
+
+  llvm_ir::IrArray output_array(GetIrArrayFor(convolution));
+  llvm_ir::IrArray::Index element_index = output_index;
+  for (int64 j = 0; j < block_size; ++j) {
+    element_index[dnums.output_feature_dimension()] =
+        ir_builder_.CreateNSWAdd(first_output_feature, ir_builder_.getInt64(j));
+    output_array.EmitWriteArrayElement(
+        element_index,
+        ir_builder_.CreateAlignedLoad(accumulators[j], alignment),
+        &ir_builder_);
+  }
+}
+
+StatusOr<bool> IrEmitter::EmitDirectConvolution(HloInstruction* convolution) {
+  const Shape& output_shape = convolution->shape();
+  if (output_shape.element_type() != F32) {
+    return false;
+  }
+  const int64 output_feature_dimension =
+      convolution->convolution_dimension_numbers().output_feature_dimension();
+  std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds;
+  if (ShouldEmitParallelLoopFor(*convolution)) {
+    // Partition bounds on the output features would split feature blocks.
+    for (int64 i = 0; i < num_dynamic_loop_bounds_; ++i) {
+      if (LayoutUtil::Major(output_shape.layout(), i) ==
+          output_feature_dimension) {
+        return false;
+      }
+    }
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(convolution));
+
+  // Output features are computed in blocks of one vector register's worth,
+  // which reuses each input element across the block and, when output
+  // features are minor-most in the kernel and the output, lets LLVM combine
+  // the block's kernel loads, multiply-adds and stores into vector operations.
+  const int64 output_features =
+      output_shape.dimensions(output_feature_dimension);
+  const int64 vector_register_elements =
+      target_machine_features_.vector_register_byte_size(
+          *compute_function_->function()) /
+      ShapeUtil::ByteSizeOfPrimitiveType(F32);
+  const int64 block_size = std::max<int64>(
+      1, std::min<int64>(output_features, vector_register_elements));
+
+  // Loop over the output positions with the feature blocks innermost, so that
+  // the last partial block can be emitted right after the full ones.
+  llvm_ir::ForLoopNest output_loops(IrName(convolution), &ir_builder_);
+  llvm_ir::IrArray::Index output_index(ShapeUtil::Rank(output_shape));
+  for (int64 i = 0; i < ShapeUtil::Rank(output_shape); ++i) {
+    const int64 dimension = LayoutUtil::Major(output_shape.layout(), i);
+    if (dimension == output_feature_dimension) {
+      continue;
+    }
+    const string suffix = tensorflow::strings::Printf("dim.%lld", dimension);
+    std::unique_ptr<llvm_ir::ForLoop> loop =
+        i < static_cast<int64>(dynamic_loop_bounds.size())
+            ? output_loops.AddLoop(suffix, dynamic_loop_bounds[i].first,
+                                   dynamic_loop_bounds[i].second)
+            : output_loops.AddLoop(0, output_shape.dimensions(dimension),
+                                   suffix);
+    output_index[dimension] = loop->GetIndVarValue();
+  }
+  if (llvm::BasicBlock* output_body_bb =
+          output_loops.GetInnerLoopBodyBasicBlock()) {
+    SetToFirstInsertPoint(output_body_bb, &ir_builder_);
+  }
+  llvm::BasicBlock* output_loops_exit_bb =
+      output_loops.GetOuterLoopExitBasicBlock();
+
+  const int64 full_blocks_end = (output_features / block_size) * block_size;
+  if (full_blocks_end > 0) {
+    llvm_ir::ForLoopNest block_loops(IrName(convolution, "feature_block"),
+                                     &ir_builder_);
+    std::unique_ptr<llvm_ir::ForLoop> loop =
+        block_loops.AddLoop(0, full_blocks_end, block_size, "feature_block");
+    SetToFirstInsertPoint(loop->GetBodyBasicBlock(), &ir_builder_);
+    EmitDirectConvolutionBlock(convolution, output_index,
+                               loop->GetIndVarValue(), block_size);
+    SetToFirstInsertPoint(block_loops.GetOuterLoopExitBasicBlock(),
+                          &ir_builder_);
+  }
+  if (full_blocks_end < output_features) {
+    EmitDirectConvolutionBlock(convolution, output_index,
+                               ir_builder_.getInt64(full_blocks_end),
+                               output_features - full_blocks_end);
+  }
+
+  if (output_loops_exit_bb != nullptr) {
+    ir_builder_.SetInsertPoint(output_loops_exit_bb);
+  }
+  return true;
+}
+
 Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
   auto lhs = convolution->operand(0);
   auto rhs = convolution->operand(1);
@@ -994,6 +1727,12 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
     }
   }
 
+  TF_ASSIGN_OR_RETURN(bool emitted_direct_convolution,
+                      EmitDirectConvolution(convolution));
+  if (emitted_direct_convolution) {
+    return Status::OK();
+  }
+
   // This is a completely un-optimized version of convolution just to
   // have an early version that works. E.g. the input index and
   // padding calculation is not hoisted out of the inner loop.
@@ -1164,8 +1903,51 @@ Status IrEmitter::HandleFft(HloInstruction* fft) {
     input_batch *= fft->shape().dimensions(i);
   }
 
-  // Args have been computed, make the call.
+  // The FFT lengths are static, so the radix decomposition and the roots of
+  // unity can be computed here once rather than on every call.  The plan is
+  // embedded as a constant, which bounds its size: it holds one complex value
+  // per element of each transformed dimension.
+  const int kMaxFftPlanSizeInBytes = 64 * 1024;
   llvm::Type* int8_ptr_type = ir_builder_.getInt8Ty()->getPointerTo();
+  if (runtime::CanBuildFftPlan(fft_length.data(), fft_length.size()) &&
+      runtime::FftPlanSize(fft_length.data(), fft_length.size()) <=
+          kMaxFftPlanSizeInBytes) {
+    const std::vector<tensorflow::uint8> plan = runtime::BuildFftPlan(
+        fft->fft_type(), fft_length.data(), fft_length.size());
+    llvm::Constant* initializer = llvm::ConstantDataArray::get(
+        module_->getContext(),
+        llvm::ArrayRef<uint8_t>(plan.data(), plan.size()));
+    llvm::GlobalVariable* plan_global = new llvm::GlobalVariable(
+        /*Module=*/*module_,
+        /*Type=*/initializer->getType(),
+        /*isConstant=*/true,
+        /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+        /*Initializer=*/initializer,
+        /*Name=*/AsStringRef(IrName(fft, "plan")));
+    plan_global->setAlignment(16);
+
+    llvm::FunctionType* planned_fft_type = llvm::FunctionType::get(
+        ir_builder_.getVoidTy(),
+        {int8_ptr_type, int8_ptr_type, int8_ptr_type, int8_ptr_type,
+         ir_builder_.getInt64Ty()},
+        /*isVarArg=*/false);
+    llvm::Function* planned_fft_func =
+        llvm::cast<llvm::Function>(module_->getOrInsertFunction(
+            runtime::kPlannedFftSymbolName, planned_fft_type));
+    planned_fft_func->setCallingConv(llvm::CallingConv::C);
+    planned_fft_func->setDoesNotThrow();
+    planned_fft_func->setOnlyAccessesInaccessibleMemOrArgMem();
+    ir_builder_.CreateCall(
+        planned_fft_func,
+        {GetExecutableRunOptionsArgument(),
+         ir_builder_.CreateBitCast(plan_global, int8_ptr_type),
+         ir_builder_.CreateBitCast(GetEmittedValueFor(fft), int8_ptr_type),
+         ir_builder_.CreateBitCast(operand_address, int8_ptr_type),
+         ir_builder_.getInt64(input_batch)});
+    return Status::OK();
+  }
+
+  // Args have been computed, make the call.
   llvm::Type* int32_type = ir_builder_.getInt32Ty();
   llvm::Type* int64_type = ir_builder_.getInt64Ty();
   llvm::FunctionType* fft_type = llvm::FunctionType::get(
@@ -1622,9 +2404,9 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
       MinimumAlignmentForPrimitiveType(reduce->shape().element_type()));
 
   if (is_reduction_over_minor_dimension) {
-    // TODO(sanjoy): Implement vectorized reduction over the minor dimension.
-    *failure_reason = "reduction over minor dimension not implemented";
-    return false;
+    return EmitVectorizedReduceOverMinorDimension(
+        reduce, arg, init_value, dimensions, function, reduction_generator,
+        vectorization_factor, element_alignment, failure_reason);
   }
 
   CHECK(!ShapeUtil::IsTuple(reduce->shape()));
@@ -1738,6 +2520,210 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
   return true;
 }
 
+llvm::Value* IrEmitter::EmitHorizontalReduction(
+    const ReductionGenerator& reduction_generator,
+    const ShardedVector& accumulator) {
+  // Fold the shards, which all have the same vector type, into one vector and
+  // then fold its upper half into its lower half until one element is left.
+  llvm::Value* vector = accumulator[0];
+  for (size_t i = 1; i < accumulator.size(); ++i) {
+    vector = reduction_generator(&ir_builder_, vector, accumulator[i]);
+  }
+  for (unsigned width = vector->getType()->getVectorNumElements(); width > 1;
+       width /= 2) {
+    std::vector<uint32_t> lower_half(width / 2);
+    std::vector<uint32_t> upper_half(width / 2);
+    for (unsigned i = 0; i < width / 2; ++i) {
+      lower_half[i] = i;
+      upper_half[i] = width / 2 + i;
+    }
+    llvm::Value* undef = llvm::UndefValue::get(vector->getType());
+    vector = reduction_generator(
+        &ir_builder_,
+        ir_builder_.CreateShuffleVector(vector, undef, lower_half),
+        ir_builder_.CreateShuffleVector(vector, undef, upper_half));
+  }
+  return ir_builder_.CreateExtractElement(vector, ir_builder_.getInt32(0));
+}
+
+StatusOr<bool> IrEmitter::EmitVectorizedReduceOverMinorDimension(
+    HloInstruction* reduce, HloInstruction* arg, HloInstruction* init_value,
+    gtl::ArraySlice<int64> dimensions, HloComputation* function,
+    const ReductionGenerator& reduction_generator, int vectorization_factor,
+    unsigned element_alignment, string* failure_reason) {
+  const PrimitiveType element_type = reduce->shape().element_type();
+  const int64 minor_dimension = LayoutUtil::Minor(arg->shape().layout(), 0);
+  const int64 minor_dimension_size = arg->shape().dimensions(minor_dimension);
+
+  // Unlike a reduction over major dimensions, this one reassociates: every
+  // lane accumulates a strided subset of the elements, and the lanes are
+  // combined at the end.  That is exact for the bitwise, minimum and maximum
+  // reducers, but not for floating-point sums and products.
+  const HloOpcode reducer_opcode = function->root_instruction()->opcode();
+  if (ShapeUtil::ElementIsFloating(reduce->shape()) &&
+      (reducer_opcode == HloOpcode::kAdd ||
+       reducer_opcode == HloOpcode::kMultiply) &&
+      !hlo_module_config_.debug_options().xla_enable_fast_math()) {
+    *failure_reason =
+        "reassociating a floating-point reduction requires fast math";
+    return false;
+  }
+  if (vectorization_factor < 2 ||
+      (vectorization_factor & (vectorization_factor - 1)) != 0 ||
+      minor_dimension_size < vectorization_factor) {
+    *failure_reason = "reduced minor dimension is narrower than a vector";
+    return false;
+  }
+  const ShardedVectorType vector_type =
+      CreateShardedVectorType(element_type, vectorization_factor);
+  for (llvm::Type* shard_type : vector_type) {
+    if (shard_type != vector_type[0] || !shard_type->isVectorTy()) {
+      *failure_reason = "vectorization factor does not fill vector registers";
+      return false;
+    }
+  }
+
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(reduce));
+
+  // With D the kept dimensions, R the reduced dimensions other than the minor
+  // one, M the minor dimension and VS the vectorization factor:
+  //
+  //  for (d in D) {
+  //    vector_acc = splat(init)
+  //    scalar_acc = init
+  //    for (r in R) {
+  //      for (m in M with stride VS, as long as VS elements remain) {
+  //        vector_acc = elementwise_reduce(vector_acc, input[d, r, m:m+VS])
+  //      }
+  //      for (m in the remaining elements of M) {
+  //        scalar_acc = reduce(scalar_acc, input[d, r, m])
+  //      }
+  //    }
+  //    output[d] = reduce(horizontal_reduce(vector_acc), scalar_acc)
+  //  }
+  llvm_ir::ForLoopNest loop_nest(IrName(reduce), &ir_builder_);
+  const llvm_ir::IrArray::Index output_index =
+      loop_nest.AddLoopsForShape(reduce->shape(), "dim");
+  if (llvm::BasicBlock* innermost_body_bb =
+          loop_nest.GetInnerLoopBodyBasicBlock()) {
+    SetToFirstInsertPoint(innermost_body_bb, &ir_builder_);
+  }
+  llvm::BasicBlock* outermost_loop_exit_block =
+      loop_nest.GetOuterLoopExitBasicBlock();
+
+  llvm::Value* init_value_ssa =
+      ir_builder_.CreateLoad(GetEmittedValueFor(init_value));
+  ShardedVector vector_accumulator;
+  for (llvm::Type* shard_type : vector_type) {
+    llvm::Value* shard = llvm_ir::EmitAllocaAtFunctionEntry(
+        shard_type, "vector_accumulator", &ir_builder_, 0);
+    ir_builder_.CreateAlignedStore(
+        ir_builder_.CreateVectorSplat(shard_type->getVectorNumElements(),
+                                      init_value_ssa),
+        shard, element_alignment);
+    vector_accumulator.push_back(shard);
+  }
+  llvm::Value* scalar_accumulator = llvm_ir::EmitAllocaAtFunctionEntry(
+      llvm_ir::PrimitiveTypeToIrType(element_type, module_),
+      "scalar_accumulator", &ir_builder_, 0);
+  ir_builder_.CreateAlignedStore(init_value_ssa, scalar_accumulator,
+                                 element_alignment);
+
+  std::vector<int64> major_reduced_dimensions;
+  for (int64 dimension : dimensions) {
+    if (dimension != minor_dimension) {
+      major_reduced_dimensions.push_back(dimension);
+    }
+  }
+  llvm_ir::ForLoopNest reduction_loop_nest(IrName(arg, "vectorized_inner"),
+                                           &ir_builder_);
+  llvm_ir::IrArray::Index input_index =
+      reduction_loop_nest.AddLoopsForShapeOnDimensions(
+          arg->shape(), major_reduced_dimensions, "reduction_dim");
+  if (llvm::BasicBlock* reduction_body_bb =
+          reduction_loop_nest.GetInnerLoopBodyBasicBlock()) {
+    SetToFirstInsertPoint(reduction_body_bb, &ir_builder_);
+  }
+  llvm_ir::IrArray::Index::const_iterator it = output_index.begin();
+  for (int64 i = 0; i < input_index.size(); ++i) {
+    if (input_index[i] == nullptr && i != minor_dimension) {
+      input_index[i] = *it++;
+    }
+  }
+  CHECK(output_index.end() == it);
+
+  llvm_ir::IrArray arg_array(GetIrArrayFor(arg));
+  const int64 vectorized_size =
+      (minor_dimension_size / vectorization_factor) * vectorization_factor;
+  {
+    llvm_ir::ForLoopNest vector_loop_nest(IrName(arg, "vector"), &ir_builder_);
+    std::unique_ptr<llvm_ir::ForLoop> loop = vector_loop_nest.AddLoop(
+        0, vectorized_size, vectorization_factor,
+        tensorflow::strings::Printf("dim.%lld", minor_dimension));
+    SetToFirstInsertPoint(loop->GetBodyBasicBlock(), &ir_builder_);
+    input_index[minor_dimension] = loop->GetIndVarValue();
+    llvm::Value* input_address = ir_builder_.CreateBitCast(
+        arg_array.EmitArrayElementAddress(input_index, &ir_builder_),
+        ir_builder_.getInt8PtrTy());
+    for (int i = 0; i < vector_accumulator.size(); i++) {
+      auto input_address_typed = ir_builder_.CreateBitCast(
+          input_address, vector_accumulator[i]->getType());
+      auto current_accumulator_value = ir_builder_.CreateAlignedLoad(
+          vector_accumulator[i], element_alignment);
+      auto addend =
+          ir_builder_.CreateAlignedLoad(input_address_typed, element_alignment);
+      arg_array.AnnotateLoadStoreInstructionWithMetadata(addend);
+      ir_builder_.CreateAlignedStore(
+          reduction_generator(&ir_builder_, current_accumulator_value, addend),
+          vector_accumulator[i], element_alignment);
+      input_address = ir_builder_.CreateConstInBoundsGEP1_32(
+          addend->getType(), input_address_typed, 1);
+    }
+    SetToFirstInsertPoint(vector_loop_nest.GetOuterLoopExitBasicBlock(),
+                          &ir_builder_);
+  }
+  if (vectorized_size < minor_dimension_size) {
+    llvm_ir::ForLoopNest remainder_loop_nest(IrName(arg, "remainder"),
+                                             &ir_builder_);
+    std::unique_ptr<llvm_ir::ForLoop> loop = remainder_loop_nest.AddLoop(
+        vectorized_size, minor_dimension_size,
+        tensorflow::strings::Printf("dim.%lld", minor_dimension));
+    SetToFirstInsertPoint(loop->GetBodyBasicBlock(), &ir_builder_);
+    input_index[minor_dimension] = loop->GetIndVarValue();
+    llvm::Value* element =
+        arg_array.EmitReadArrayElement(input_index, &ir_builder_);
+    ir_builder_.CreateAlignedStore(
+        reduction_generator(
+            &ir_builder_,
+            ir_builder_.CreateAlignedLoad(scalar_accumulator,
+                                          element_alignment),
+            element),
+        scalar_accumulator, element_alignment);
+    SetToFirstInsertPoint(remainder_loop_nest.GetOuterLoopExitBasicBlock(),
+                          &ir_builder_);
+  }
+  if (llvm::BasicBlock* reduction_exit_bb =
+          reduction_loop_nest.GetOuterLoopExitBasicBlock()) {
+    SetToFirstInsertPoint(reduction_exit_bb, &ir_builder_);
+  }
+
+  ShardedVector vector_result;
+  for (llvm::Value* shard : vector_accumulator) {
+    vector_result.push_back(
+        ir_builder_.CreateAlignedLoad(shard, element_alignment));
+  }
+  llvm::Value* result = reduction_generator(
+      &ir_builder_, EmitHorizontalReduction(reduction_generator, vector_result),
+      ir_builder_.CreateAlignedLoad(scalar_accumulator, element_alignment));
+  GetIrArrayFor(reduce).EmitWriteArrayElement(output_index, result,
+                                              &ir_builder_);
+
+  if (outermost_loop_exit_block) {
+    ir_builder_.SetInsertPoint(outermost_loop_exit_block);
+  }
+  return true;
+}
+
 Status IrEmitter::HandleReduce(HloInstruction* reduce) {
   auto arg = reduce->mutable_operand(0);
   auto init_value = reduce->mutable_operand(1);
@@ -1759,11 +2745,9 @@ Status IrEmitter::HandleReduce(HloInstruction* reduce) {
     }
   }
 
-  // The called computation should have been emitted previously.
-  llvm::Function* reducer_function = FindOrDie(emitted_functions_, function);
   return EmitTargetElementLoop(
       reduce, [this, reduce, arg, init_value, dimensions,
-               reducer_function](const llvm_ir::IrArray::Index& index) {
+               function](const llvm_ir::IrArray::Index& index) {
         // Initialize an accumulator with init_value.
         PrimitiveType accumulator_type = reduce->shape().element_type();
         llvm::AllocaInst* accumulator_addr = llvm_ir::EmitAllocaAtFunctionEntry(
@@ -1806,9 +2790,11 @@ Status IrEmitter::HandleReduce(HloInstruction* reduce) {
         // Apply the reduction function to the loaded value.
         llvm::Value* input_address =
             arg_array.EmitArrayElementAddress(input_index, &ir_builder_);
-        llvm::Value* result = EmitElementFunctionCall(
-            reducer_function, reduce->shape(),
-            {accumulator_addr, input_address}, "reduce_function");
+        TF_ASSIGN_OR_RETURN(
+            llvm::Value * result,
+            EmitScalarComputation(function, reduce->shape(),
+                                  {accumulator_addr, input_address},
+                                  "reduce_function"));
         ir_builder_.CreateStore(result, accumulator_addr);
 
         SetToFirstInsertPoint(loops.GetOuterLoopExitBasicBlock(), &ir_builder_);
@@ -1816,14 +2802,113 @@ Status IrEmitter::HandleReduce(HloInstruction* reduce) {
       });
 }
 
+llvm::Value* IrEmitter::EmitAcquireChannel(int64 channel_id,
+                                           int64 message_bytes) {
+  llvm::FunctionType* acquire_type = llvm::FunctionType::get(
+      llvm::Type::getInt8PtrTy(module_->getContext()),
+      {ir_builder_.getInt64Ty(), ir_builder_.getInt64Ty()},
+      /*isVarArg=*/false);
+  llvm::Function* acquire_func =
+      llvm::cast<llvm::Function>(module_->getOrInsertFunction(
+          runtime::kAcquireChannelSymbolName, acquire_type));
+  acquire_func->setCallingConv(llvm::CallingConv::C);
+  acquire_func->setDoesNotThrow();
+  return ir_builder_.CreateCall(
+      acquire_func,
+      {ir_builder_.getInt64(channel_id), ir_builder_.getInt64(message_bytes)});
+}
+
+void IrEmitter::EmitReleaseChannel(int64 channel_id) {
+  llvm::FunctionType* release_type = llvm::FunctionType::get(
+      ir_builder_.getVoidTy(), {ir_builder_.getInt64Ty()},
+      /*isVarArg=*/false);
+  llvm::Function* release_func =
+      llvm::cast<llvm::Function>(module_->getOrInsertFunction(
+          runtime::kReleaseChannelSymbolName, release_type));
+  release_func->setCallingConv(llvm::CallingConv::C);
+  release_func->setDoesNotThrow();
+  ir_builder_.CreateCall(release_func, {ir_builder_.getInt64(channel_id)});
+}
+
+llvm::Function* IrEmitter::GetChannelFunction(const char* name,
+                                              llvm::Type* return_type) {
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  llvm::FunctionType* function_type = llvm::FunctionType::get(
+      return_type, {i8_ptr_type, i8_ptr_type, ir_builder_.getInt64Ty()},
+      /*isVarArg=*/false);
+  llvm::Function* function = llvm::cast<llvm::Function>(
+      module_->getOrInsertFunction(name, function_type));
+  function->setCallingConv(llvm::CallingConv::C);
+  function->setDoesNotThrow();
+  return function;
+}
+
+llvm::Value* IrEmitter::EmitChannelTransferPending(const HloInstruction& hlo) {
+  const Shape context_shape = ShapeUtil::MakeShape(U32, {});
+  llvm::Value* context = llvm_ir::EmitGetTupleElement(
+      context_shape, 1, MinimumAlignmentForShape(context_shape),
+      GetEmittedValueFor(&hlo), &ir_builder_, module_);
+  return ir_builder_.CreateICmpEQ(ir_builder_.CreateLoad(context),
+                                  ir_builder_.getInt32(0));
+}
+
+/**
+ * Send produces the tuple {operand, context}.  The message is copied into the
+ * channel right away if there is room, and the U32 context records whether
+ * it was; otherwise SendDone waits for room.  The operand buffer stays alive
+ * until SendDone, since Send's output aliases it.
+ */
 Status IrEmitter::HandleSend(HloInstruction* send) {
-  // TODO(b/33942983): Support Send/Recv on CPU.
-  return Unimplemented("Send is not implemented on CPU.");
+  const HloInstruction* operand = send->operand(0);
+  if (ShapeUtil::IsTuple(operand->shape())) {
+    return Unimplemented("Send of a tuple is not implemented on CPU.");
+  }
+  const int64 message_bytes = ByteSizeOf(operand->shape());
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(send));
+
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice context_slice,
+                      assignment_.GetUniqueSlice(send, {1}));
+  llvm::Value* context = EmitTempBufferPointer(
+      context_slice, ShapeUtil::MakeShape(U32, {}));
+  llvm::Value* data = GetEmittedValueFor(operand);
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  llvm::Value* channel =
+      EmitAcquireChannel(send->channel_id(), message_bytes);
+  llvm::Value* sent = ir_builder_.CreateCall(
+      GetChannelFunction(runtime::kChannelTrySendSymbolName,
+                         ir_builder_.getInt32Ty()),
+      {channel, ir_builder_.CreateBitCast(data, i8_ptr_type),
+       ir_builder_.getInt64(message_bytes)});
+  EmitReleaseChannel(send->channel_id());
+  ir_builder_.CreateStore(sent, context);
+
+  llvm_ir::EmitTuple(GetIrArrayFor(send), {data, context}, &ir_builder_,
+                     module_);
+  return Status::OK();
 }
 
 Status IrEmitter::HandleSendDone(HloInstruction* send_done) {
-  // TODO(b/33942983): Support Send/Recv on CPU.
-  return Unimplemented("Send-done is not implemented on CPU.");
+  const HloInstruction* send = send_done->operand(0);
+  const Shape& operand_shape = send->operand(0)->shape();
+  const int64 message_bytes = ByteSizeOf(operand_shape);
+
+  llvm_ir::LlvmIfData if_data = llvm_ir::EmitIfThenElse(
+      EmitChannelTransferPending(*send), "send_pending", &ir_builder_,
+      /*emit_else=*/false);
+  SetToFirstInsertPoint(if_data.true_block, &ir_builder_);
+  llvm::Value* data = llvm_ir::EmitGetTupleElement(
+      operand_shape, 0, MinimumAlignmentForShape(operand_shape),
+      GetEmittedValueFor(send), &ir_builder_, module_);
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  ir_builder_.CreateCall(
+      GetChannelFunction(runtime::kChannelSendSymbolName,
+                         ir_builder_.getVoidTy()),
+      {EmitAcquireChannel(send->channel_id(), message_bytes),
+       ir_builder_.CreateBitCast(data, i8_ptr_type),
+       ir_builder_.getInt64(message_bytes)});
+  EmitReleaseChannel(send->channel_id());
+  SetToFirstInsertPoint(if_data.after_block, &ir_builder_);
+  return Status::OK();
 }
 
 Status IrEmitter::HandleSlice(HloInstruction* slice) {
@@ -1986,14 +3071,118 @@ Status IrEmitter::HandleDynamicUpdateSlice(
   return DefaultAction(dynamic_update_slice);
 }
 
+/**
+ * Recv produces the tuple {receive buffer, context}.  A message already in
+ * the channel is copied into the receive buffer right away, and the U32
+ * context records whether it was; otherwise RecvDone waits for one.
+ */
 Status IrEmitter::HandleRecv(HloInstruction* recv) {
-  // TODO(b/33942983): Support Send/Recv on CPU.
-  return Unimplemented("Recv is not implemented on CPU.");
+  const Shape& data_shape = ShapeUtil::GetTupleElementShape(recv->shape(), 0);
+  if (ShapeUtil::IsTuple(data_shape)) {
+    return Unimplemented("Recv of a tuple is not implemented on CPU.");
+  }
+  const int64 message_bytes = ByteSizeOf(data_shape);
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(recv));
+
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice data_slice,
+                      assignment_.GetUniqueSlice(recv, {0}));
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice context_slice,
+                      assignment_.GetUniqueSlice(recv, {1}));
+  llvm::Value* data = EmitTempBufferPointer(data_slice, data_shape);
+  llvm::Value* context = EmitTempBufferPointer(
+      context_slice, ShapeUtil::MakeShape(U32, {}));
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  llvm::Value* channel =
+      EmitAcquireChannel(recv->channel_id(), message_bytes);
+  llvm::Value* received = ir_builder_.CreateCall(
+      GetChannelFunction(runtime::kChannelTryRecvSymbolName,
+                         ir_builder_.getInt32Ty()),
+      {channel, ir_builder_.CreateBitCast(data, i8_ptr_type),
+       ir_builder_.getInt64(message_bytes)});
+  EmitReleaseChannel(recv->channel_id());
+  ir_builder_.CreateStore(received, context);
+
+  llvm_ir::EmitTuple(GetIrArrayFor(recv), {data, context}, &ir_builder_,
+                     module_);
+  return Status::OK();
 }
 
 Status IrEmitter::HandleRecvDone(HloInstruction* recv_done) {
-  // TODO(b/33942983): Support Send/Recv on CPU.
-  return Unimplemented("Recv-done is not implemented on CPU.");
+  const HloInstruction* recv = recv_done->operand(0);
+  const Shape& data_shape = recv_done->shape();
+  const int64 message_bytes = ByteSizeOf(data_shape);
+
+  // RecvDone's output aliases Recv's receive buffer.
+  llvm::Value* data = llvm_ir::EmitGetTupleElement(
+      data_shape, 0, MinimumAlignmentForShape(data_shape),
+      GetEmittedValueFor(recv), &ir_builder_, module_);
+  llvm_ir::LlvmIfData if_data = llvm_ir::EmitIfThenElse(
+      EmitChannelTransferPending(*recv), "recv_pending", &ir_builder_,
+      /*emit_else=*/false);
+  SetToFirstInsertPoint(if_data.true_block, &ir_builder_);
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  ir_builder_.CreateCall(
+      GetChannelFunction(runtime::kChannelRecvSymbolName,
+                         ir_builder_.getVoidTy()),
+      {EmitAcquireChannel(recv->channel_id(), message_bytes),
+       ir_builder_.CreateBitCast(data, i8_ptr_type),
+       ir_builder_.getInt64(message_bytes)});
+  EmitReleaseChannel(recv->channel_id());
+  SetToFirstInsertPoint(if_data.after_block, &ir_builder_);
+
+  emitted_value_[recv_done] = data;
+  return Status::OK();
+}
+
+llvm::Value* IrEmitter::EmitRngInvocation(const HloInstruction& rng) {
+  llvm::GlobalVariable*& invocation_counter = rng_invocation_counters_[&rng];
+  if (invocation_counter == nullptr) {
+    invocation_counter = new llvm::GlobalVariable(
+        /*Module=*/*module_,
+        /*Type=*/ir_builder_.getInt64Ty(),
+        /*isConstant=*/false,
+        /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+        /*Initializer=*/ir_builder_.getInt64(0),
+        /*Name=*/AsStringRef(IrName(&rng, "invocation_counter")));
+    invocation_counter->setAlignment(8);
+  }
+  return ir_builder_.CreateAtomicRMW(
+      llvm::AtomicRMWInst::Add, invocation_counter, ir_builder_.getInt64(1),
+      llvm::AtomicOrdering::Monotonic);
+}
+
+Status IrEmitter::HandleRng(HloInstruction* rng) {
+  // Every execution of 'rng' draws a fresh invocation number from a counter
+  // private to the instruction.  When the element loop is split into parallel
+  // partitions, the caller draws it once before forking and passes its address
+  // to all partitions after the parameters (see HandleCall).
+  llvm::Value* invocation;
+  if (ShouldEmitParallelLoopFor(*rng)) {
+    llvm::Value* invocation_address = ir_builder_.CreateLoad(
+        llvm_ir::EmitBufferIndexingGEP(compute_function_->parameters_arg(),
+                                       rng->parent()->num_parameters(),
+                                       &ir_builder_),
+        "rng_invocation_untyped");
+    invocation = ir_builder_.CreateLoad(
+        ir_builder_.CreateBitCast(invocation_address,
+                                  ir_builder_.getInt64Ty()->getPointerTo()),
+        "rng_invocation");
+  } else {
+    invocation = EmitRngInvocation(*rng);
+  }
+
+  auto operand_generator = [this, rng](int64 operand_no) {
+    return [this, rng, operand_no](const llvm_ir::IrArray::Index& index)
+               -> StatusOr<llvm::Value*> {
+      return GetIrArrayFor(rng->operand(operand_no))
+          .EmitReadArrayElement(index, &ir_builder_);
+    };
+  };
+  return EmitTargetElementLoop(
+      rng, llvm_ir::MakePhiloxRngElementGenerator(
+               rng, ir_builder_.getInt64(rng->GetModule()->RandomNew64()),
+               invocation, operand_generator(0), operand_generator(1),
+               &ir_builder_, module_));
 }
 
 Status IrEmitter::HandlePad(HloInstruction* pad) {
@@ -2129,6 +3318,9 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
     TF_RETURN_IF_ERROR(fusion->fused_expression_root()->Accept(&fused_emitter));
 
     return EmitTargetElementLoop(fusion, fused_emitter.GetRootGenerator());
+  } else if (const HloInstruction* dot = GetGemmEpilogueDot(*fusion)) {
+    VLOG(3) << "HandleFusion GEMM epilogue";
+    return EmitGemmWithEpilogue(fusion, dot);
   } else if (fusion->fusion_kind() == HloInstruction::FusionKind::kOutput) {
     VLOG(3) << "HandleFusion kOutput";
     int64 dot_op_index = root->operand(0)->opcode() == HloOpcode::kDot ? 0 : 1;
@@ -2163,6 +3355,140 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
   }
 }
 
+/**
+ * 1. Take the panel height from `xla::cpu::GemmEpiloguePanelRows`, which
+ *    CpuInstructionFusion checked before fusing.
+ * 2. For each full panel (in an IR loop), then for the remaining rows:
+ *   1. Emit the dot of the panel's lhs rows with the whole rhs into the
+ *      scratch buffer with `xla::cpu::DotOpEmitter`.
+ *   2. Visit the fused computation with a `xla::FusedIrEmitter` whose
+ *      generator for the dot reads the scratch buffer, and emit a loop over
+ *      the panel which writes the fusion root's elements to the target.
+ *
+ * The target is only written by the epilogue, so the fusion's output may
+ * share a buffer with an operand the epilogue reads elementwise.
+ */
+Status IrEmitter::EmitGemmWithEpilogue(HloInstruction* fusion,
+                                       const HloInstruction* dot) {
+  const HloInstruction* lhs_parameter = dot->operand(0);
+  const HloInstruction* rhs_parameter = dot->operand(1);
+  TF_RET_CHECK(lhs_parameter->opcode() == HloOpcode::kParameter &&
+               rhs_parameter->opcode() == HloOpcode::kParameter);
+  const HloInstruction* lhs =
+      fusion->operand(lhs_parameter->parameter_number());
+  const HloInstruction* rhs =
+      fusion->operand(rhs_parameter->parameter_number());
+  TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
+      /*instruction=*/*dot, /*operands=*/{lhs, rhs},
+      /*supported_types=*/{F16, F32, F64}));
+  // Panels are ranges of lhs rows, which CpuLayoutAssignment makes row-major
+  // like every other fusion operand.
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(lhs->shape().layout()));
+
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(fusion));
+  if (ShapeUtil::HasZeroElements(fusion->shape())) {
+    return Status::OK();
+  }
+  llvm_ir::IrArray target_array = GetIrArrayFor(fusion);
+  llvm_ir::IrArray lhs_array = GetIrArrayFor(lhs);
+  llvm_ir::IrArray rhs_array = GetIrArrayFor(rhs);
+  const std::vector<llvm_ir::IrArray> operand_arrays =
+      GetIrArraysForOperandsOf(fusion);
+
+  const PrimitiveType element_type = dot->shape().element_type();
+  const int64 element_bytes = ShapeUtil::ByteSizeOfPrimitiveType(element_type);
+  const int64 m = dot->shape().dimensions(0);
+  const int64 n = dot->shape().dimensions(1);
+  const int64 k = lhs->shape().dimensions(1);
+  const int64 alignment = MinimumAlignmentForShape(lhs->shape());
+  TF_RET_CHECK(kGemmEpilogueLhsAlignment % alignment == 0);
+  const int64 panel_rows = GemmEpiloguePanelRows(*dot);
+  TF_RET_CHECK(panel_rows > 0 &&
+               panel_rows * n * element_bytes <= kGemmEpilogueTileBytes)
+      << "GEMM epilogue fused into " << fusion->name()
+      << " without a valid panel";
+
+  llvm::Type* element_ir_type =
+      llvm_ir::PrimitiveTypeToIrType(element_type, module_);
+  llvm::Value* scratch = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      element_ir_type, ir_builder_.getInt64(panel_rows * n),
+      IrName(fusion, "panel"), &ir_builder_, alignment);
+  llvm::Value* lhs_elements = ir_builder_.CreateBitCast(
+      lhs_array.GetBasePointer(), element_ir_type->getPointerTo());
+
+  // Emits the panel of 'rows' output rows starting at row 'row_start'.
+  auto emit_panel = [&](llvm::Value* row_start, int64 rows) -> Status {
+    const Shape lhs_panel_shape =
+        ShapeUtil::MakeShapeWithLayout(element_type, {rows, k}, {1, 0});
+    const Shape panel_shape =
+        ShapeUtil::MakeShapeWithLayout(element_type, {rows, n}, {1, 0});
+    llvm_ir::IrArray lhs_panel(
+        ir_builder_.CreateBitCast(
+            ir_builder_.CreateInBoundsGEP(
+                lhs_elements,
+                ir_builder_.CreateNSWMul(row_start, ir_builder_.getInt64(k))),
+            llvm_ir::ShapeToIrType(lhs_panel_shape, module_)->getPointerTo()),
+        lhs_panel_shape);
+    llvm_ir::IrArray panel(
+        ir_builder_.CreateBitCast(
+            scratch,
+            llvm_ir::ShapeToIrType(panel_shape, module_)->getPointerTo()),
+        panel_shape);
+    TF_RETURN_IF_ERROR(DotOpEmitter::EmitDotOperation(
+        *dot, /*transpose_lhs=*/false, /*transpose_rhs=*/false, panel,
+        lhs_panel, rhs_array, /*addend_array=*/nullptr,
+        GetExecutableRunOptionsArgument(), &ir_builder_, hlo_module_config_,
+        target_machine_features_));
+
+    CpuElementalIrEmitter elemental_emitter(hlo_module_config_, this, module_);
+    FusedIrEmitter fused_emitter(operand_arrays, &elemental_emitter);
+    fused_emitter.BindGenerator(
+        dot, [this, panel, row_start](const llvm_ir::IrArray::Index& index)
+                 -> StatusOr<llvm::Value*> {
+          llvm_ir::IrArray::Index panel_index(index.size());
+          panel_index[0] = ir_builder_.CreateNSWSub(index[0], row_start);
+          panel_index[1] = index[1];
+          return panel.EmitReadArrayElement(panel_index, &ir_builder_);
+        });
+    TF_RETURN_IF_ERROR(fusion->fused_expression_root()->Accept(&fused_emitter));
+
+    llvm_ir::ForLoopNest loops(IrName(fusion, "epilogue"), &ir_builder_);
+    const llvm_ir::IrArray::Index panel_index =
+        loops.AddLoopsForShape(panel_shape, "panel");
+    SetToFirstInsertPoint(loops.GetInnerLoopBodyBasicBlock(), &ir_builder_);
+    llvm_ir::IrArray::Index target_index(panel_index.size());
+    target_index[0] = ir_builder_.CreateNSWAdd(panel_index[0], row_start);
+    target_index[1] = panel_index[1];
+    TF_ASSIGN_OR_RETURN(llvm::Value * value,
+                        fused_emitter.GetRootGenerator()(target_index));
+    target_array.EmitWriteArrayElement(target_index, value, &ir_builder_);
+    SetToFirstInsertPoint(loops.GetOuterLoopExitBasicBlock(), &ir_builder_);
+    return Status::OK();
+  };
+
+  const int64 full_panels = m / panel_rows;
+  const int64 tail_rows = m % panel_rows;
+  VLOG(2) << "EmitGemmWithEpilogue: " << full_panels << " panels of "
+          << panel_rows << " rows and " << tail_rows << " remaining rows";
+  if (full_panels > 0) {
+    llvm_ir::ForLoopNest panel_loops(IrName(fusion, "panels"), &ir_builder_);
+    std::unique_ptr<llvm_ir::ForLoop> panel_loop =
+        panel_loops.AddLoop(0, full_panels, "panel");
+    SetToFirstInsertPoint(panel_loop->GetBodyBasicBlock(), &ir_builder_);
+    TF_RETURN_IF_ERROR(emit_panel(
+        ir_builder_.CreateNSWMul(panel_loop->GetIndVarValue(),
+                                 ir_builder_.getInt64(panel_rows)),
+        panel_rows));
+    SetToFirstInsertPoint(panel_loops.GetOuterLoopExitBasicBlock(),
+                          &ir_builder_);
+  }
+  if (tail_rows > 0) {
+    TF_RETURN_IF_ERROR(
+        emit_panel(ir_builder_.getInt64(full_panels * panel_rows), tail_rows));
+  }
+  return Status::OK();
+}
+
 Status IrEmitter::HandleCall(HloInstruction* call) {
   HloComputation* computation = call->to_apply();
   llvm::Function* call_ir_function = FindOrDie(emitted_functions_, computation);
@@ -2174,10 +3500,33 @@ Status IrEmitter::HandleCall(HloInstruction* call) {
 
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(call));
 
-  if (!computation->root_instruction()->outer_dimension_partitions().empty() &&
-      !parallel_cpu_backend_) {
+  if (inter_op_parallelism_ && is_top_level_computation_) {
+    // InterOpParallelization wraps partitioned calls, so every task is a plain
+    // call.  The task graph is launched once all tasks are known.
+    TF_RET_CHECK(
+        computation->root_instruction()->outer_dimension_partitions().empty());
+    inter_op_tasks_.push_back(
+        {call, call_ir_function,
+         GetArrayFunctionCallArguments(
+             parameter_addresses, &ir_builder_, computation->name(),
+             /*return_value_buffer=*/emitted_value_[call],
+             /*exec_run_options_arg=*/GetExecutableRunOptionsArgument(),
+             /*temp_buffers_arg=*/GetTempBuffersArgument(),
+             /*profile_counters_arg=*/GetProfileCountersArgument())});
+  } else if (!computation->root_instruction()
+                  ->outer_dimension_partitions()
+                  .empty() &&
+             !parallel_cpu_backend_) {
     // ParallelTaskAssignment assigned partitions, emit call to
     // ParallelForkJoin.
+    HloInstruction* root = computation->root_instruction();
+    if (root->opcode() == HloOpcode::kRng) {
+      // All partitions draw from the same invocation (see HandleRng).
+      llvm::Value* invocation = llvm_ir::EmitAllocaAtFunctionEntry(
+          ir_builder_.getInt64Ty(), "rng_invocation", &ir_builder_);
+      ir_builder_.CreateStore(EmitRngInvocation(*root), invocation);
+      parameter_addresses.push_back(invocation);
+    }
     std::vector<llvm::Value*> call_args = GetArrayFunctionCallArguments(
         parameter_addresses, &ir_builder_, computation->name(),
         /*return_value_buffer=*/emitted_value_[call],
@@ -2185,7 +3534,6 @@ Status IrEmitter::HandleCall(HloInstruction* call) {
         /*temp_buffers_arg=*/GetTempBuffersArgument(),
         /*profile_counters_arg=*/GetProfileCountersArgument());
 
-    HloInstruction* root = computation->root_instruction();
     TF_RETURN_IF_ERROR(EmitCallToParallelForkJoin(
         call_args, root->shape(), root->outer_dimension_partitions(),
         &ir_builder_, call_ir_function, computation->name()));
@@ -2552,6 +3900,9 @@ Status IrEmitter::FinishVisit(HloInstruction* root) {
   // nothing to do since the result was already written directly into the output
   // buffer.
   VLOG(2) << "FinishVisit root: " << root->ToString();
+  TF_RET_CHECK(in_place_infeeds_.empty())
+      << "an in-place infeed's ring slot was never released";
+  TF_RETURN_IF_ERROR(EmitInterOpTaskGraph());
   llvm::Value* root_value = GetEmittedValueFor(root);
   VLOG(2) << "  value: " << llvm_ir::DumpToString(*root_value);
 
@@ -2584,6 +3935,159 @@ Status IrEmitter::FinishVisit(HloInstruction* root) {
   return Status::OK();
 }
 
+Status IrEmitter::EmitInterOpTaskGraph() {
+  if (inter_op_tasks_.empty()) {
+    return Status::OK();
+  }
+  if (inter_op_tasks_.size() == 1) {
+    ir_builder_.CreateCall(inter_op_tasks_[0].function,
+                           inter_op_tasks_[0].arguments);
+    inter_op_tasks_.clear();
+    return Status::OK();
+  }
+
+  // Only the entry computation's parameters and constants are not tasks, and
+  // they are ready before any task runs.
+  const int32 task_count = inter_op_tasks_.size();
+  std::unordered_map<const HloInstruction*, int32> task_indices;
+  for (int32 i = 0; i < task_count; ++i) {
+    task_indices[inter_op_tasks_[i].call] = i;
+  }
+  std::vector<int32> predecessor_counts(task_count, 0);
+  std::vector<std::vector<int32>> successors(task_count);
+  std::vector<uint8> caller_thread_tasks(task_count, 0);
+  int32 previous_side_effect = -1;
+  for (int32 i = 0; i < task_count; ++i) {
+    const HloInstruction* call = inter_op_tasks_[i].call;
+    std::set<int32> predecessors;
+    // Tasks with side effects run in the order of the module sequence, which
+    // InterOpParallelization also enforces by control dependencies.
+    if (call->HasSideEffect()) {
+      if (previous_side_effect >= 0) {
+        predecessors.insert(previous_side_effect);
+      }
+      previous_side_effect = i;
+    }
+    caller_thread_tasks[i] = PerformsHostTransfers(*call) ? 1 : 0;
+    for (const HloInstruction* operand : call->operands()) {
+      auto it = task_indices.find(operand);
+      if (it != task_indices.end()) {
+        predecessors.insert(it->second);
+      } else {
+        TF_RET_CHECK(operand->opcode() == HloOpcode::kParameter ||
+                     operand->opcode() == HloOpcode::kConstant)
+            << "inter-op task " << call->name() << " depends on "
+            << operand->name() << ", which is not a task";
+      }
+    }
+    for (const HloInstruction* predecessor : call->control_predecessors()) {
+      auto it = task_indices.find(predecessor);
+      if (it != task_indices.end()) {
+        predecessors.insert(it->second);
+      }
+    }
+    predecessor_counts[i] = predecessors.size();
+    for (int32 predecessor : predecessors) {
+      TF_RET_CHECK(predecessor < i);
+      successors[predecessor].push_back(i);
+    }
+  }
+  std::vector<uint32> task_graph(predecessor_counts.begin(),
+                                 predecessor_counts.end());
+  uint32 successor_offset = 0;
+  for (int32 i = 0; i < task_count; ++i) {
+    task_graph.push_back(successor_offset);
+    successor_offset += successors[i].size();
+  }
+  task_graph.push_back(successor_offset);
+  for (const std::vector<int32>& task_successors : successors) {
+    task_graph.insert(task_graph.end(), task_successors.begin(),
+                      task_successors.end());
+  }
+  llvm::Constant* task_graph_initializer =
+      llvm::ConstantDataArray::get(module_->getContext(), task_graph);
+  llvm::GlobalVariable* task_graph_global = new llvm::GlobalVariable(
+      /*Module=*/*module_,
+      /*Type=*/task_graph_initializer->getType(),
+      /*isConstant=*/true,
+      /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+      /*Initializer=*/task_graph_initializer,
+      /*Name=*/"inter_op_task_graph");
+  llvm::Constant* caller_thread_tasks_initializer =
+      llvm::ConstantDataArray::get(module_->getContext(), caller_thread_tasks);
+  llvm::GlobalVariable* caller_thread_tasks_global = new llvm::GlobalVariable(
+      /*Module=*/*module_,
+      /*Type=*/caller_thread_tasks_initializer->getType(),
+      /*isConstant=*/true,
+      /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+      /*Initializer=*/caller_thread_tasks_initializer,
+      /*Name=*/"inter_op_caller_thread_tasks");
+
+  // The function pointers are constant; results and parameter arrays are
+  // computed from this invocation's buffers.
+  llvm::Type* i8_ptr_type = ir_builder_.getInt8PtrTy();
+  std::vector<llvm::Constant*> functions;
+  for (const InterOpTask& task : inter_op_tasks_) {
+    functions.push_back(
+        llvm::ConstantExpr::getBitCast(task.function, i8_ptr_type));
+  }
+  llvm::ArrayType* functions_type =
+      llvm::ArrayType::get(i8_ptr_type, task_count);
+  llvm::GlobalVariable* functions_global = new llvm::GlobalVariable(
+      /*Module=*/*module_,
+      /*Type=*/functions_type,
+      /*isConstant=*/true,
+      /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+      /*Initializer=*/llvm::ConstantArray::get(functions_type, functions),
+      /*Name=*/"inter_op_task_functions");
+  llvm::Value* results = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      i8_ptr_type, ir_builder_.getInt32(task_count), "inter_op_task_results",
+      &ir_builder_);
+  llvm::Value* params = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      i8_ptr_type, ir_builder_.getInt32(task_count), "inter_op_task_params",
+      &ir_builder_);
+  for (int32 i = 0; i < task_count; ++i) {
+    const std::vector<llvm::Value*>& arguments = inter_op_tasks_[i].arguments;
+    ir_builder_.CreateStore(
+        ir_builder_.CreateBitCast(arguments[0], i8_ptr_type),
+        ir_builder_.CreateInBoundsGEP(results, {ir_builder_.getInt64(i)}));
+    ir_builder_.CreateStore(
+        ir_builder_.CreateBitCast(arguments[2], i8_ptr_type),
+        ir_builder_.CreateInBoundsGEP(params, {ir_builder_.getInt64(i)}));
+  }
+
+  llvm::Type* int32_type = ir_builder_.getInt32Ty();
+  llvm::Type* int64_ptr_type = ir_builder_.getInt64Ty()->getPointerTo();
+  llvm::Type* i8_ptr_ptr_type = i8_ptr_type->getPointerTo();
+  llvm::FunctionType* execute_type = llvm::FunctionType::get(
+      ir_builder_.getVoidTy(),
+      {i8_ptr_type, i8_ptr_ptr_type, int64_ptr_type, int32_type, int32_type,
+       i8_ptr_ptr_type, i8_ptr_ptr_type, i8_ptr_ptr_type,
+       int32_type->getPointerTo(), i8_ptr_type},
+      /*isVarArg=*/false);
+  llvm::Function* execute_func = llvm::cast<llvm::Function>(
+      module_->getOrInsertFunction(runtime::kExecuteTaskGraphSymbolName,
+                                   execute_type));
+  execute_func->setCallingConv(llvm::CallingConv::C);
+  ir_builder_.CreateCall(
+      execute_func,
+      {GetExecutableRunOptionsArgument(), GetTempBuffersArgument(),
+       GetProfileCountersArgument(),
+       ir_builder_.getInt32(hlo_module_config_.debug_options()
+                                .xla_cpu_inter_op_parallelism_threads()),
+       ir_builder_.getInt32(task_count),
+       ir_builder_.CreateConstInBoundsGEP2_32(functions_type, functions_global,
+                                              0, 0),
+       results, params,
+       ir_builder_.CreateConstInBoundsGEP2_32(
+           task_graph_initializer->getType(), task_graph_global, 0, 0),
+       ir_builder_.CreateConstInBoundsGEP2_32(
+           caller_thread_tasks_initializer->getType(),
+           caller_thread_tasks_global, 0, 0)});
+  inter_op_tasks_.clear();
+  return Status::OK();
+}
+
 template <typename T>
 llvm::Value* IrEmitter::GetProfileCounterCommon(
     const T& hlo,
@@ -2680,6 +4184,21 @@ Status IrEmitter::Postprocess(HloInstruction* hlo) {
   if (auto* prof_counter = GetProfileCounterFor(*hlo)) {
     profiling_state_.RecordCycleDelta(&ir_builder_, hlo, prof_counter);
   }
+  // Release the ring slots of in-place infeeds whose last user this is.
+  const gtl::FlatSet<const HloInstruction*> operands(hlo->operands().begin(),
+                                                     hlo->operands().end());
+  for (const HloInstruction* operand : operands) {
+    auto it = in_place_infeeds_.find(operand);
+    if (it == in_place_infeeds_.end() || --it->second.pending_users > 0) {
+      continue;
+    }
+    const InPlaceInfeed& in_place = it->second;
+    ir_builder_.CreateCall(
+        GetXfeedFunctions(XfeedKind::kInfeed).second,
+        {ir_builder_.getInt32(in_place.length), in_place.slot,
+         in_place.shape_ptr, ir_builder_.getInt32(in_place.shape_length)});
+    in_place_infeeds_.erase(it);
+  }
   return Status::OK();
 }
 
@@ -2802,6 +4321,92 @@ llvm::Value* IrEmitter::EmitElementFunctionCall(
       AsStringRef(tensorflow::strings::StrCat(name, "_return_value")));
 }
 
+StatusOr<llvm::Value*> IrEmitter::EmitScalarComputation(
+    HloComputation* computation, const Shape& return_shape,
+    gtl::ArraySlice<llvm::Value*> parameter_addresses,
+    tensorflow::StringPiece name) {
+  if (CanInlineScalarComputation(computation)) {
+    std::vector<llvm::Value*> arguments;
+    for (llvm::Value* parameter_address : parameter_addresses) {
+      arguments.push_back(ir_builder_.CreateLoad(parameter_address));
+    }
+    return EmitInlinedScalarComputation(computation, arguments);
+  }
+  // The called computation should have been emitted previously.
+  llvm::Function* function = FindOrDie(emitted_functions_, computation);
+  return EmitElementFunctionCall(function, return_shape, parameter_addresses,
+                                 name);
+}
+
+bool IrEmitter::CanInlineScalarComputation(HloComputation* computation) {
+  // Larger computations are cheaper to call than to duplicate at every call
+  // site.
+  const int64 kMaxInlinedInstructionCount = 16;
+  if (computation->instruction_count() > kMaxInlinedInstructionCount) {
+    return false;
+  }
+  for (const HloInstruction* instruction : computation->instructions()) {
+    if (!ShapeUtil::IsScalar(instruction->shape())) {
+      return false;
+    }
+    // The elemental emitter would bypass the lowering of side-effecting
+    // instructions, e.g. the Philox generator of HandleRng.
+    if (instruction->HasSideEffect()) {
+      return false;
+    }
+    switch (instruction->opcode()) {
+      case HloOpcode::kParameter:
+      case HloOpcode::kConstant:
+        break;
+      case HloOpcode::kMap:
+        return false;
+      default:
+        if (!instruction->IsElementwise()) {
+          return false;
+        }
+        break;
+    }
+  }
+  return true;
+}
+
+StatusOr<llvm::Value*> IrEmitter::EmitInlinedScalarComputation(
+    HloComputation* computation, gtl::ArraySlice<llvm::Value*> arguments) {
+  TF_RET_CHECK(static_cast<int64>(arguments.size()) ==
+               computation->num_parameters());
+  // Every instruction is emitted once, in post order, so the operand
+  // generators only forward values that have already been emitted.
+  CpuElementalIrEmitter elemental_emitter(hlo_module_config_, this, module_);
+  ElementalIrEmitter::HloToElementGeneratorMap operand_to_generator;
+  std::unordered_map<const HloInstruction*, llvm::Value*> values;
+  for (const HloInstruction* instruction :
+       computation->MakeInstructionPostOrder()) {
+    llvm::Value* value;
+    switch (instruction->opcode()) {
+      case HloOpcode::kParameter:
+        value = arguments[instruction->parameter_number()];
+        break;
+      case HloOpcode::kConstant:
+        value = llvm_ir::ConvertLiteralToIrConstant(instruction->literal(),
+                                                    module_);
+        break;
+      default: {
+        TF_ASSIGN_OR_RETURN(
+            value, elemental_emitter.MakeElementGenerator(
+                       instruction, operand_to_generator)(
+                       llvm_ir::IrArray::Index()));
+        break;
+      }
+    }
+    values[instruction] = value;
+    operand_to_generator[instruction] =
+        [value](const llvm_ir::IrArray::Index&) -> StatusOr<llvm::Value*> {
+      return value;
+    };
+  }
+  return values.at(computation->root_instruction());
+}
+
 // Emits a core function call based on the following pseudo-code.
 //
 //   char** parameter_addresses_buffer =
@@ -2974,6 +4579,9 @@ Status IrEmitter::DefaultAction(HloInstruction* hlo) {
 StatusOr<llvm::Value*> IrEmitter::EmitScalarCall(
     PrimitiveType return_type, HloComputation* computation,
     const std::vector<llvm::Value*>& arguments, tensorflow::StringPiece name) {
+  if (CanInlineScalarComputation(computation)) {
+    return EmitInlinedScalarComputation(computation, arguments);
+  }
   llvm::Function* llvm_function = FindOrDie(emitted_functions_, computation);
   std::vector<llvm::Value*> argument_addrs;
   for (auto argument : arguments) {
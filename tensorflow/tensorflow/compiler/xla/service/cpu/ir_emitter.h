@@ -23,10 +23,12 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Value.h"
@@ -149,11 +151,13 @@ class IrEmitter : public DfsHloVisitorWithDefault {
   Status HandleSend(HloInstruction* send) override;
   Status HandleSendDone(HloInstruction* send_done) override;
   Status HandleSlice(HloInstruction* slice) override;
+  Status HandleTranspose(HloInstruction* transpose) override;
   Status HandleDynamicSlice(HloInstruction* dynamic_slice) override;
   Status HandleDynamicUpdateSlice(
       HloInstruction* dynamic_update_slice) override;
   Status HandleRecv(HloInstruction* recv) override;
   Status HandleRecvDone(HloInstruction* recv_done) override;
+  Status HandleRng(HloInstruction* rng) override;
   Status HandlePad(HloInstruction* pad) override;
   Status HandleTuple(HloInstruction* tuple) override;
   Status HandleMap(HloInstruction* map) override;
@@ -260,6 +264,27 @@ class IrEmitter : public DfsHloVisitorWithDefault {
       tensorflow::gtl::ArraySlice<llvm::Value*> parameter_addresses,
       tensorflow::StringPiece name);
 
+  // Emits 'computation', which returns a scalar, applied to the scalars at
+  // 'parameter_addresses'.  Small computations are emitted inline into the
+  // caller, where the loop vectorizer can see through them; others are called
+  // with EmitElementFunctionCall.
+  StatusOr<llvm::Value*> EmitScalarComputation(
+      HloComputation* computation, const Shape& return_shape,
+      tensorflow::gtl::ArraySlice<llvm::Value*> parameter_addresses,
+      tensorflow::StringPiece name);
+
+  // Whether 'computation' is a small graph of scalar elementwise operations
+  // without side effects, which can be emitted inline by
+  // EmitInlinedScalarComputation.
+  bool CanInlineScalarComputation(HloComputation* computation);
+
+  // Emits the instructions of 'computation', which must satisfy
+  // CanInlineScalarComputation, as elemental IR applied to 'arguments', and
+  // returns the value of its root.
+  StatusOr<llvm::Value*> EmitInlinedScalarComputation(
+      HloComputation* computation,
+      tensorflow::gtl::ArraySlice<llvm::Value*> arguments);
+
   // Array function call emitter.  Stores the function's result into a supplied
   // buffer.
   // Parameters:
@@ -316,6 +341,21 @@ class IrEmitter : public DfsHloVisitorWithDefault {
   // calling GetIrArrayForOp or GetEmittedValueFor.
   Status EmitTargetAddressForOp(const HloInstruction* op);
 
+  // Emits a GEMM epilogue fusion (see GetGemmEpilogueDot), whose fused dot is
+  // 'dot'.  The dot is computed into a scratch buffer one panel of output rows
+  // at a time, and the rest of the fused computation is applied to each panel
+  // while it is still in cache, before the next panel is computed.
+  Status EmitGemmWithEpilogue(HloInstruction* fusion,
+                              const HloInstruction* dot);
+
+  // Emits 'hlo', which copies its operand with the target element at index I
+  // being the operand element at index J, J[permutation[i]] = I[i], with a
+  // llvm_ir::TiledLoopEmitter if the operand and the result are contiguous
+  // along different dimensions, also within the partition of a parallel loop.
+  // Returns false, emitting nothing, otherwise.
+  StatusOr<bool> EmitTiledTranspose(
+      HloInstruction* hlo, tensorflow::gtl::ArraySlice<int64> permutation);
+
   // Structurizes "array_elements" into an MD array that represents "shape".
   // This is a recursive function, and "dimension_index" indicates the index of
   // the current dimension that the function is considering (0 means the
@@ -338,6 +378,30 @@ class IrEmitter : public DfsHloVisitorWithDefault {
       tensorflow::gtl::ArraySlice<int64> dimensions, HloComputation* function,
       string* failure_reason);
 
+  // Tries to emit "convolution", which is not lowered to Eigen, as a direct
+  // convolution loop nest which computes blocks of output features together.
+  // Returns false, emitting nothing, if the element type is not F32 or the
+  // output features are partitioned across parallel tasks.
+  StatusOr<bool> EmitDirectConvolution(HloInstruction* convolution);
+
+  // Emits, at "output_index" (whose output feature component is unset), the
+  // "block_size" consecutive output features of "convolution" starting at
+  // "first_output_feature".  Helper function for EmitDirectConvolution.
+  void EmitDirectConvolutionBlock(const HloInstruction* convolution,
+                                  const llvm_ir::IrArray::Index& output_index,
+                                  llvm::Value* first_output_feature,
+                                  int64 block_size);
+
+  // Tries to emit "reduce_window", whose window extends along a single
+  // dimension, with the van Herk/Gil-Werman sliding-window algorithm, which
+  // does a constant amount of work per output element instead of re-walking
+  // the window.  Lines are scanned a tile of the minor dimension at a time,
+  // with the minor dimension innermost.  Returns false, emitting nothing and
+  // setting "failure_reason", if the reduce-window or its reducer do not
+  // qualify.
+  StatusOr<bool> EmitSlidingWindowReduce(HloInstruction* reduce_window,
+                                         string* failure_reason);
+
   // We'd like to keep one or two one cache-line's worth of data in registers
   // without generating IR with illegal (e.g. excessively large or
   // non-power-of-two) vector types.  We do this by introducing a layer of
@@ -389,6 +453,22 @@ class IrEmitter : public DfsHloVisitorWithDefault {
       HloInstruction* arg, tensorflow::gtl::ArraySlice<int64> dimensions,
       unsigned element_alignment);
 
+  // Emits a reduction whose reduced dimensions include the operand's minor-most
+  // dimension, by accumulating vectors of "vectorization_factor" contiguous
+  // elements and reducing their lanes at the end.  Helper function for
+  // EmitVectorizedReduce.
+  StatusOr<bool> EmitVectorizedReduceOverMinorDimension(
+      HloInstruction* reduce, HloInstruction* arg, HloInstruction* init_value,
+      tensorflow::gtl::ArraySlice<int64> dimensions, HloComputation* function,
+      const ReductionGenerator& reduction_generator, int vectorization_factor,
+      unsigned element_alignment, string* failure_reason);
+
+  // Reduces the lanes of all shards of "accumulator", which must have the same
+  // power-of-two vector type, to a scalar.
+  llvm::Value* EmitHorizontalReduction(
+      const ReductionGenerator& reduction_generator,
+      const ShardedVector& accumulator);
+
   // Tries to emit a fast concatenate operation using memcpy.  Returns true if
   // successful, and false on failure.  On failure, sets "failure_reason" to a
   // string describing why it could not emit a fast concatenate.
@@ -543,10 +623,83 @@ class IrEmitter : public DfsHloVisitorWithDefault {
   Status EmitXfeedTransfer(XfeedKind kind, const Shape& shape,
                            llvm::Value* program_buffer_address);
 
+  // Returns the size of an xfeed buffer of 'shape' as passed to the runtime,
+  // or an error if it is out of range.
+  StatusOr<int32> GetXfeedBufferLength(const Shape& shape);
+
+  // Returns the runtime functions which acquire and release a buffer of the
+  // given kind, from the xfeed rings if the module was compiled with the
+  // xla_cpu_xfeed_ring_slots debug option.
+  std::pair<llvm::Function*, llvm::Function*> GetXfeedFunctions(XfeedKind kind);
+
+  // Whether xfeed buffers come from the xfeed rings.
+  bool UseXfeedRing() const;
+
+  // Whether the array-shaped 'infeed' can be read in place from its ring slot
+  // rather than copied into its own buffer: none of its users may alias its
+  // buffer or pass it on to another computation.
+  bool CanReadInfeedInPlace(const HloInstruction& infeed) const;
+
+  // An infeed read in place from a ring slot, which is released once all of
+  // its users have been emitted.
+  struct InPlaceInfeed {
+    llvm::Value* slot;
+    llvm::Value* shape_ptr;
+    int32 shape_length;
+    int32 length;
+    int64 pending_users;
+  };
+  std::unordered_map<const HloInstruction*, InPlaceInfeed> in_place_infeeds_;
+
+  // Emit IR acquiring a reference to the in-process channel 'channel_id',
+  // which carries messages of 'message_bytes', and returning its address.
+  // The address is only valid until the matching EmitReleaseChannel.
+  llvm::Value* EmitAcquireChannel(int64 channel_id, int64 message_bytes);
+
+  // Emit IR releasing a reference taken by EmitAcquireChannel.
+  void EmitReleaseChannel(int64 channel_id);
+
+  // Returns the channel runtime function 'name', which takes a channel, a data
+  // pointer and a message size, and returns 'return_type'.
+  llvm::Function* GetChannelFunction(const char* name,
+                                     llvm::Type* return_type);
+
+  // Emit IR loading the U32 context of the Send or Recv 'hlo', and returns
+  // whether it records that the transfer is still pending.
+  llvm::Value* EmitChannelTransferPending(const HloInstruction& hlo);
+
+  // Emit IR drawing the next invocation number of the kRng 'rng' from its
+  // counter, which is created on first use.
+  llvm::Value* EmitRngInvocation(const HloInstruction& rng);
+
+  // The invocation counter of each kRng, shared by the function emitting a
+  // partitioned kRng and the call forking it.
+  std::unordered_map<const HloInstruction*, llvm::GlobalVariable*>
+      rng_invocation_counters_;
+
+  // A top-level kCall of the entry computation whose emission is deferred to
+  // the inter-op task graph, together with the arguments of its function.
+  struct InterOpTask {
+    const HloInstruction* call;
+    llvm::Function* function;
+    std::vector<llvm::Value*> arguments;
+  };
+  std::vector<InterOpTask> inter_op_tasks_;
+
+  // Emit IR running 'inter_op_tasks_', which must be in a topological order,
+  // through the task graph runtime, and clears them.  A single task is called
+  // directly.  Tasks with side effects are chained in order, and those
+  // performing host transfers are kept on the calling thread.
+  Status EmitInterOpTaskGraph();
+
   const HloModuleConfig& hlo_module_config_;
 
   const bool parallel_cpu_backend_;
 
+  // Whether the top-level kCalls of the entry computation are run as an
+  // inter-op task graph (see InterOpParallelization).
+  const bool inter_op_parallelism_;
+
   bool is_top_level_computation_;
 
   TargetMachineFeatures target_machine_features_;
@@ -0,0 +1,158 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/machine_profile.h"
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// Binds each serialized field name to its member.
+struct IntField {
+  const char* name;
+  int64 MachineProfile::*member;
+};
+
+struct DoubleField {
+  const char* name;
+  double MachineProfile::*member;
+};
+
+const IntField kIntFields[] = {
+    {"num_cores", &MachineProfile::num_cores},
+    {"l2_cache_bytes", &MachineProfile::l2_cache_bytes},
+    {"l3_cache_bytes", &MachineProfile::l3_cache_bytes},
+};
+
+const DoubleField kDoubleFields[] = {
+    {"per_core_bandwidth", &MachineProfile::per_core_bandwidth},
+    {"aggregate_bandwidth", &MachineProfile::aggregate_bandwidth},
+    {"per_core_flops", &MachineProfile::per_core_flops},
+    {"transcendental_cost", &MachineProfile::transcendental_cost},
+    {"fork_join_overhead", &MachineProfile::fork_join_overhead},
+};
+
+}  // namespace
+
+/* static */ MachineProfile MachineProfile::Default() {
+  MachineProfile profile;
+  profile.num_cores = tensorflow::port::NumSchedulableCPUs();
+  profile.l2_cache_bytes = 256LL << 10;
+  profile.l3_cache_bytes = 8LL << 20;
+  profile.per_core_bandwidth = 10e9;
+  // Bandwidth-bound ops used to scale with the square root of the core count.
+  profile.aggregate_bandwidth =
+      profile.per_core_bandwidth * std::sqrt(profile.num_cores);
+  profile.per_core_flops = 2e9;
+  profile.transcendental_cost = 2.0;
+  // The old model required 100us of work per task.
+  profile.fork_join_overhead = 10e-6;
+  return profile;
+}
+
+/* static */ StatusOr<MachineProfile> MachineProfile::FromString(
+    const string& text) {
+  MachineProfile profile = Default();
+  for (tensorflow::StringPiece line : tensorflow::str_util::Split(text, '\n')) {
+    const size_t comment = line.find('#');
+    if (comment != tensorflow::StringPiece::npos) {
+      line = line.substr(0, comment);
+    }
+    tensorflow::str_util::RemoveWhitespaceContext(&line);
+    if (line.empty()) {
+      continue;
+    }
+    const size_t colon = line.find(':');
+    if (colon == tensorflow::StringPiece::npos) {
+      return InvalidArgument("Malformed machine profile line: %s",
+                             line.ToString().c_str());
+    }
+    tensorflow::StringPiece name = line.substr(0, colon);
+    tensorflow::StringPiece value = line.substr(colon + 1);
+    tensorflow::str_util::RemoveWhitespaceContext(&name);
+    tensorflow::str_util::RemoveWhitespaceContext(&value);
+
+    bool known = false;
+    for (const IntField& field : kIntFields) {
+      if (name == field.name) {
+        if (!tensorflow::strings::safe_strto64(value,
+                                               &(profile.*field.member))) {
+          return InvalidArgument("Invalid value for machine profile field %s",
+                                 field.name);
+        }
+        known = true;
+      }
+    }
+    for (const DoubleField& field : kDoubleFields) {
+      if (name == field.name) {
+        if (!tensorflow::strings::safe_strtod(value.ToString().c_str(),
+                                              &(profile.*field.member))) {
+          return InvalidArgument("Invalid value for machine profile field %s",
+                                 field.name);
+        }
+        known = true;
+      }
+    }
+    if (!known) {
+      return InvalidArgument("Unknown machine profile field: %s",
+                             name.ToString().c_str());
+    }
+  }
+
+  if (profile.num_cores < 1 || profile.l2_cache_bytes < 1 ||
+      profile.per_core_bandwidth <= 0 ||
+      profile.aggregate_bandwidth <= 0 || profile.per_core_flops <= 0 ||
+      profile.fork_join_overhead < 0) {
+    return InvalidArgument("Machine profile values out of range:\n%s",
+                           profile.ToString().c_str());
+  }
+  return profile;
+}
+
+/* static */ StatusOr<MachineProfile> MachineProfile::Load(const string& path) {
+  string text;
+  TF_RETURN_IF_ERROR(
+      tensorflow::ReadFileToString(tensorflow::Env::Default(), path, &text));
+  return FromString(text);
+}
+
+string MachineProfile::ToString() const {
+  string result;
+  for (const IntField& field : kIntFields) {
+    tensorflow::strings::StrAppend(&result, field.name, ": ",
+                                   this->*field.member, "\n");
+  }
+  for (const DoubleField& field : kDoubleFields) {
+    tensorflow::strings::StrAppend(&result, field.name, ": ",
+                                   this->*field.member, "\n");
+  }
+  return result;
+}
+
+}  // namespace cpu
+}  // namespace xla
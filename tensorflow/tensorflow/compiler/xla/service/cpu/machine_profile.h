@@ -0,0 +1,79 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_MACHINE_PROFILE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_MACHINE_PROFILE_H_
+
+#include <string>
+
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace cpu {
+
+/**
+ * Performance characteristics of the host, used by the roofline parallel cost
+ * model in parallel_task_assignment.cc.
+ *
+ * A profile is measured once per machine type with
+ * tensorflow/compiler/xla/tools/measure_cpu_machine_profile and stored as
+ * text, one "name: value" pair per line ('#' starts a comment).  Fields
+ * missing from the text keep the values of MachineProfile::Default().
+ */
+struct MachineProfile {
+  // Number of cores available to the intra-op thread pool.
+  int64 num_cores;
+
+  // Per-core L2 cache size in bytes.  Memory-bound tasks are not made
+  // smaller than this.
+  int64 l2_cache_bytes;
+  // Shared last-level cache size in bytes.
+  int64 l3_cache_bytes;
+
+  // Streaming memory bandwidth one core can sustain, in bytes per second.
+  double per_core_bandwidth;
+  // Streaming memory bandwidth of all cores together, in bytes per second.
+  double aggregate_bandwidth;
+
+  // Scalar floating point operations per second of one core, as counted by
+  // HloCostAnalysis::flop_count.
+  double per_core_flops;
+  // Cost of one transcendental function relative to one flop.
+  double transcendental_cost;
+
+  // Time to fork and join one additional parallel task, in seconds.
+  double fork_join_overhead;
+
+  // Returns a conservative profile derived from the host's core count,
+  // matching the assumptions of the original cost model (256KB L2, 2GHz).
+  static MachineProfile Default();
+
+  // Parses a profile in the text format described above.
+  static StatusOr<MachineProfile> FromString(const string& text);
+
+  // Reads and parses the profile stored at 'path'.
+  static StatusOr<MachineProfile> Load(const string& path);
+
+  // Serializes the profile in the text format accepted by FromString.
+  string ToString() const;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_MACHINE_PROFILE_H_
@@ -17,16 +17,69 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
 
+#include <map>
+
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
+#include "tensorflow/compiler/xla/service/cpu/machine_profile.h"
 #include "tensorflow/compiler/xla/service/cpu/shape_partition.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace xla {
 namespace cpu {
 
+namespace {
+
+// Returns how many of the most-major dimensions of 'instruction's shape its
+// parallel tasks may be partitioned on.  Partitions of a select-and-scatter
+// must not scatter into each other's part of the output, so only its leading
+// dimensions along which the window neither extends nor moves qualify.
+int64 MaxPartitionedDimensionCount(const HloInstruction& instruction) {
+  const Shape& shape = instruction.shape();
+  if (instruction.opcode() != HloOpcode::kSelectAndScatter) {
+    return ShapeUtil::Rank(shape);
+  }
+  int64 count = 0;
+  for (; count < ShapeUtil::Rank(shape); ++count) {
+    const WindowDimension& dimension = instruction.window().dimensions(
+        LayoutUtil::Major(shape.layout(), count));
+    if (dimension.size() != 1 || dimension.stride() != 1 ||
+        dimension.padding_low() != 0 || dimension.padding_high() != 0 ||
+        dimension.base_dilation() != 1) {
+      break;
+    }
+  }
+  return count;
+}
+
+// Returns the machine profile stored at 'path'.  Each path is read once per
+// process, and a failure to load it is only reported then.
+const StatusOr<MachineProfile>& GetMachineProfile(const string& path) {
+  static tensorflow::mutex* mu = new tensorflow::mutex;
+  static auto* profiles = new std::map<string, StatusOr<MachineProfile>>;
+  tensorflow::mutex_lock lock(*mu);
+  auto it = profiles->find(path);
+  if (it == profiles->end()) {
+    it = profiles->emplace(path, MachineProfile::Load(path)).first;
+    if (it->second.ok()) {
+      VLOG(1) << "Using machine profile " << path << ":\n"
+              << it->second.ValueOrDie().ToString();
+    } else {
+      LOG(WARNING) << "Failed to load machine profile " << path << ": "
+                   << it->second.status()
+                   << "; using the default cost model.";
+    }
+  }
+  return it->second;
+}
+
+}  // namespace
+
 class SimpleCostModel : public ParallelCostModel {
  public:
   SimpleCostModel(const int64 max_parallelism,
@@ -104,6 +157,69 @@ class DefaultCostModel : public ParallelCostModel {
   const std::unique_ptr<HloCostAnalysis> cost_analysis_;
 };
 
+// Picks the task count that minimizes a roofline estimate of the running time,
+// using the bandwidth, compute and fork-join costs of a measured machine
+// profile.
+class RooflineCostModel : public ParallelCostModel {
+ public:
+  RooflineCostModel(const int64 max_parallelism, const MachineProfile& profile,
+                    std::unique_ptr<HloCostAnalysis> cost_analysis)
+      : max_parallelism_(std::min(max_parallelism, profile.num_cores)),
+        profile_(profile),
+        cost_analysis_(std::move(cost_analysis)) {}
+  ~RooflineCostModel() override {}
+
+  int64 GetParallelTaskCount(HloInstruction* instruction) override {
+    const double flops =
+        cost_analysis_->flop_count(*instruction) +
+        profile_.transcendental_cost *
+            cost_analysis_->transcendental_count(*instruction);
+    const double bytes = cost_analysis_->bytes_accessed(*instruction);
+    // As in DefaultCostModel, memory-bound instructions are not split into
+    // tasks touching less than a core's L2 cache.
+    int64 max_task_count = max_parallelism_;
+    if (flops <= bytes) {
+      max_task_count = std::min(
+          max_task_count,
+          std::max<int64>(1, static_cast<int64>(bytes) /
+                                 profile_.l2_cache_bytes));
+    }
+    // The estimate is cheap, so just try every feasible task count.
+    int64 best_task_count = 1;
+    double best_seconds = EstimateSeconds(flops, bytes, 1);
+    for (int64 task_count = 2; task_count <= max_task_count; ++task_count) {
+      const double seconds = EstimateSeconds(flops, bytes, task_count);
+      if (seconds < best_seconds) {
+        best_seconds = seconds;
+        best_task_count = task_count;
+      }
+    }
+    return best_task_count;
+  }
+
+ private:
+  // Estimated time to run 'flops' and move 'bytes' split over 'task_count'
+  // equal tasks.
+  double EstimateSeconds(double flops, double bytes, int64 task_count) const {
+    const double compute_seconds =
+        flops / (task_count * profile_.per_core_flops);
+    // Working sets that fit in the last-level cache are likely still resident
+    // from their producers, so they scale with the core count; larger ones
+    // are bound by the aggregate memory bandwidth.
+    double bandwidth = task_count * profile_.per_core_bandwidth;
+    if (bytes > profile_.l3_cache_bytes) {
+      bandwidth = std::min(bandwidth, profile_.aggregate_bandwidth);
+    }
+    const double memory_seconds = bytes / bandwidth;
+    return std::max(compute_seconds, memory_seconds) +
+           (task_count - 1) * profile_.fork_join_overhead;
+  }
+
+  const int64 max_parallelism_;
+  const MachineProfile profile_;
+  const std::unique_ptr<HloCostAnalysis> cost_analysis_;
+};
+
 ParallelTaskAssignment::ParallelTaskAssignment(
     const int64 max_parallelism,
     const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module) {
@@ -112,6 +228,16 @@ ParallelTaskAssignment::ParallelTaskAssignment(
   auto cost_analysis = MakeUnique<HloCostAnalysis>(shape_size);
   HloComputation* computation = module->entry_computation();
   Status status = computation->root_instruction()->Accept(cost_analysis.get());
+  const string& profile_path =
+      module->config().debug_options().xla_cpu_machine_profile_path();
+  if (status.ok() && !profile_path.empty()) {
+    const StatusOr<MachineProfile>& profile = GetMachineProfile(profile_path);
+    if (profile.ok()) {
+      cost_model_.reset(new RooflineCostModel(
+          max_parallelism, profile.ValueOrDie(), std::move(cost_analysis)));
+      return;
+    }
+  }
   if (status.ok()) {
     // Set default cost model based on 'cost_analysis'.
     cost_model_.reset(new DefaultCostModel(max_parallelism, shape_size,
@@ -128,18 +254,22 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
     HloInstruction* instruction) {
   // Currently, we do not assign parallel tasks to instructions with at least
   // one of the following properties:
-  // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall).
-  // *) Emit custom loops (kSelectAndScatter, FusionKind::kTransposeDot).
-  // *) Operations that are not thread safe (like infeed and rng).
+  // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall,
+  //    kSort).
+  // *) Emit custom loops (FusionKind::kTransposeDot), or kSelectAndScatter
+  //    with a window spanning its most-major dimension.
+  // *) Operations that are not thread safe (like infeed).
   // *) Tuple-shaped.
   // TODO(b/27458679) Parallelize instructions which are skipped here.
   auto opcode = instruction->opcode();
   if (opcode == HloOpcode::kParameter || opcode == HloOpcode::kConstant ||
       opcode == HloOpcode::kCall || opcode == HloOpcode::kCustomCall ||
-      opcode == HloOpcode::kDot || opcode == HloOpcode::kSelectAndScatter ||
+      opcode == HloOpcode::kDot ||
+      (opcode == HloOpcode::kSelectAndScatter &&
+       MaxPartitionedDimensionCount(*instruction) == 0) ||
       opcode == HloOpcode::kGetTupleElement || opcode == HloOpcode::kBitcast ||
       opcode == HloOpcode::kFft || opcode == HloOpcode::kInfeed ||
-      opcode == HloOpcode::kOutfeed || opcode == HloOpcode::kRng ||
+      opcode == HloOpcode::kOutfeed || opcode == HloOpcode::kSort ||
       (opcode == HloOpcode::kConvolution &&
        PotentiallyImplementedAsEigenConvolution(*instruction)) ||
       PotentiallyImplementedAsEigenDot(*instruction) ||
@@ -205,6 +335,12 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
     // Assign feasible dimension partitions (based on actual dimension sizes).
     auto dim_partition_counts = ShapePartitionAssigner(instruction->shape())
                                     .Run(target_parallel_task_count);
+    const int64 max_partitioned_dimension_count =
+        MaxPartitionedDimensionCount(*instruction);
+    if (static_cast<int64>(dim_partition_counts.size()) >
+        max_partitioned_dimension_count) {
+      dim_partition_counts.resize(max_partitioned_dimension_count);
+    }
     const int64 total_partition_count =
         ShapePartitionAssigner::GetTotalPartitionCount(dim_partition_counts);
     if (total_partition_count <= 1) {
@@ -39,6 +39,9 @@ class ParallelTaskAssignment {
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
   // 'module': the containing HloModule.
+  // If the module's 'xla_cpu_machine_profile_path' debug option names a
+  // MachineProfile, task counts come from a roofline model of that machine;
+  // otherwise a fixed-constant model is used.
   ParallelTaskAssignment(const int64 max_parallelism,
                          const HloCostAnalysis::ShapeSizeFunction& shape_size,
                          HloModule* module);
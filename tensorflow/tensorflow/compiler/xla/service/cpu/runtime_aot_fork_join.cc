@@ -0,0 +1,137 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_aot_fork_join.h"
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <mutex>               // NOLINT(build/c++11)
+#include <vector>
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kAotParallelForkJoinSymbolName =
+    "__xla_cpu_runtime_AotParallelForkJoin";
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+// This runtime is linked into tfcompile'd binaries, so it deliberately uses
+// only the standard library rather than tensorflow/core synchronization.
+namespace {
+
+using tensorflow::int32;
+using tensorflow::int64;
+using tensorflow::uint64;
+
+using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
+                                     int64*, uint64*);
+
+// The scheduler is written once during application setup and read on every
+// fork, so it is not guarded beyond the documented contract of
+// __xla_cpu_runtime_SetAotTaskScheduler.
+XlaAotScheduleFunction g_schedule = nullptr;
+void* g_schedule_context = nullptr;
+
+// Counts outstanding partitions of a single fork-join call.
+class JoinCounter {
+ public:
+  explicit JoinCounter(int32 count) : count_(count) {}
+
+  void DecrementCount() {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (--count_ == 0) {
+      cv_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] { return count_ == 0; });
+  }
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+  int32 count_;
+};
+
+// Arguments of one partition, shared with the scheduler through a void*.
+struct PartitionTask {
+  ComputeFunctionType function;
+  void* result_ptr;
+  const void* run_options_ptr;
+  const void** params;
+  void** temps;
+  int64* dynamic_loop_bounds;
+  uint64* prof_counters;
+  JoinCounter* join;
+};
+
+void RunPartitionTask(void* arg) {
+  PartitionTask* task = static_cast<PartitionTask*>(arg);
+  task->function(task->result_ptr, task->run_options_ptr, task->params,
+                 task->temps, task->dynamic_loop_bounds, task->prof_counters);
+  task->join->DecrementCount();
+}
+
+}  // namespace
+
+void __xla_cpu_runtime_SetAotTaskScheduler(XlaAotScheduleFunction schedule,
+                                           void* context) {
+  g_schedule = schedule;
+  g_schedule_context = schedule == nullptr ? nullptr : context;
+}
+
+// Partition layout matches __xla_cpu_runtime_ParallelForkJoin: partition 'i'
+// starts at 'partitions + i * num_partitioned_dims * 2'.
+void __xla_cpu_runtime_AotParallelForkJoin(
+    void* result_ptr, const void* run_options_ptr, const void** params,
+    void** temps, uint64* prof_counters, int32 num_partitions,
+    int64* partitions, int32 num_partitioned_dims, void* function_ptr) {
+  ComputeFunctionType function =
+      reinterpret_cast<ComputeFunctionType>(function_ptr);
+  const int32 stride = 2 * num_partitioned_dims;
+
+  // Without a bound scheduler (or with nothing to fork) run every partition on
+  // the calling thread, which is what single-threaded AOT code would have done.
+  XlaAotScheduleFunction schedule = g_schedule;
+  if (schedule == nullptr || num_partitions <= 1) {
+    for (int32 i = 0; i < num_partitions; ++i) {
+      function(result_ptr, run_options_ptr, params, temps,
+               &partitions[i * stride], prof_counters);
+    }
+    return;
+  }
+
+  JoinCounter join(num_partitions - 1);
+  std::vector<PartitionTask> tasks(num_partitions - 1);
+  for (int32 i = 1; i < num_partitions; ++i) {
+    PartitionTask& task = tasks[i - 1];
+    task = {function,      result_ptr,         run_options_ptr,
+            params,        temps,              &partitions[i * stride],
+            prof_counters, &join};
+    schedule(g_schedule_context, &RunPartitionTask, &task);
+  }
+
+  // Run the first partition inline and wait for the rest.
+  function(result_ptr, run_options_ptr, params, temps, &partitions[0],
+           prof_counters);
+  join.Wait();
+}
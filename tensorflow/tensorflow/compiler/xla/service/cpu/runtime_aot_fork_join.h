@@ -0,0 +1,76 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_AOT_FORK_JOIN_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_AOT_FORK_JOIN_H_
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+// Name of the fork-join entry point called by multi-threaded AOT code.
+extern const char* const kAotParallelForkJoinSymbolName;
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * Standalone fork-join runtime for tfcompile'd objects built with
+ * `--max_parallelism` greater than 1.
+ *
+ * Unlike `__xla_cpu_runtime_ParallelForkJoin`, which dispatches to the Eigen
+ * thread pool carried in the ExecutableRunOptions, this runtime has no thread
+ * pool of its own and depends only on the C++ standard library.  The embedding
+ * application binds its own scheduler once with
+ * `__xla_cpu_runtime_SetAotTaskScheduler`; until then (or after binding a null
+ * scheduler) every partition runs on the calling thread.
+ */
+extern "C" {
+
+// A unit of work handed to the scheduler.  It must be invoked exactly once
+// with the 'arg' it was scheduled with.
+typedef void (*XlaAotTaskFunction)(void* arg);
+
+// Schedules 'task(arg)' to run asynchronously, e.g. on a thread pool owned by
+// the caller.  'context' is the value passed to
+// __xla_cpu_runtime_SetAotTaskScheduler.
+typedef void (*XlaAotScheduleFunction)(void* context, XlaAotTaskFunction task,
+                                       void* arg);
+
+// Binds the scheduler used by all subsequent fork-join calls in the process.
+// Passing a null 'schedule' reverts to running partitions on the calling
+// thread.  Must not be called while a compiled function is executing.
+extern void __xla_cpu_runtime_SetAotTaskScheduler(
+    XlaAotScheduleFunction schedule, void* context);
+
+// Has the same signature as __xla_cpu_runtime_ParallelForkJoin.  Schedules
+// 'num_partitions - 1' calls to 'function_ptr' and runs the first partition
+// inline, returning once all partitions have completed.  'partitions' holds
+// [start, limit) pairs for each of the 'num_partitioned_dims' most-major
+// dimensions of each partition.
+extern void __xla_cpu_runtime_AotParallelForkJoin(
+    void* result_ptr, const void* run_options_ptr, const void** params,
+    void** temps, tensorflow::uint64* prof_counters,
+    tensorflow::int32 num_partitions, tensorflow::int64* partitions,
+    tensorflow::int32 num_partitioned_dims, void* function_ptr);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_AOT_FORK_JOIN_H_
@@ -0,0 +1,163 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_batch_matmul.h"
+
+#define EIGEN_USE_THREADS
+
+#include <utility>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int32;
+using tensorflow::int64;
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kEigenBatchMatMulF32SymbolName =
+    "__xla_cpu_runtime_EigenBatchMatMulF32";
+const char* const kEigenBatchMatMulF64SymbolName =
+    "__xla_cpu_runtime_EigenBatchMatMulF64";
+const char* const kEigenSingleThreadedBatchMatMulF32SymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedBatchMatMulF32";
+const char* const kEigenSingleThreadedBatchMatMulF64SymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedBatchMatMulF64";
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+namespace {
+
+// Multiplies the 'index'-th matrices of 'lhs' and 'rhs' into 'out' on
+// 'device'.  Individual matrices are only element aligned, since the batch
+// stride need not be a multiple of the vector width.
+template <typename T, typename Device>
+void MatMulOne(const Device& device, T* out, T* lhs, T* rhs, int64 index,
+               int64 m, int64 n, int64 k, int32 transpose_lhs,
+               int32 transpose_rhs) {
+  int64 lhs_rows = m;
+  int64 lhs_cols = k;
+  if (transpose_lhs) {
+    std::swap(lhs_rows, lhs_cols);
+  }
+  int64 rhs_rows = k;
+  int64 rhs_cols = n;
+  if (transpose_rhs) {
+    std::swap(rhs_rows, rhs_cols);
+  }
+
+  const Eigen::TensorMap<Eigen::Tensor<const T, 2, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+      A(lhs + index * m * k, lhs_rows, lhs_cols);
+  const Eigen::TensorMap<Eigen::Tensor<const T, 2, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+      B(rhs + index * k * n, rhs_rows, rhs_cols);
+  Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned> C(
+      out + index * m * n, m, n);
+
+  typedef typename Eigen::Tensor<T, 2>::DimensionPair DimPair;
+  const int lhs_contract_dim = transpose_lhs ? 0 : 1;
+  const int rhs_contract_dim = transpose_rhs ? 1 : 0;
+  const Eigen::array<DimPair, 1> dims(
+      {DimPair(lhs_contract_dim, rhs_contract_dim)});
+
+  C.device(device) = A.contract(B, dims);
+}
+
+template <typename T>
+void BatchMatMul(const void* run_options_ptr, T* out, T* lhs, T* rhs,
+                 int64 batch, int64 m, int64 n, int64 k, int32 transpose_lhs,
+                 int32 transpose_rhs) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  const Eigen::ThreadPoolDevice* pool = run_options->intra_op_thread_pool();
+
+  // With at least one matrix per thread, partition the batch across the pool
+  // and run each GEMM single-threaded; this avoids the per-call sharding
+  // overhead that dominates many small products.  Otherwise let each GEMM use
+  // the whole pool.
+  if (batch >= pool->numThreads()) {
+    const Eigen::TensorOpCost cost(
+        /*bytes_loaded=*/sizeof(T) * (m * k + k * n),
+        /*bytes_stored=*/sizeof(T) * m * n,
+        /*compute_cycles=*/2.0 * m * n * k);
+    pool->parallelFor(batch, cost, [&](Eigen::Index first, Eigen::Index last) {
+      Eigen::DefaultDevice device;
+      for (Eigen::Index i = first; i < last; ++i) {
+        MatMulOne(device, out, lhs, rhs, i, m, n, k, transpose_lhs,
+                  transpose_rhs);
+      }
+    });
+  } else {
+    for (int64 i = 0; i < batch; ++i) {
+      MatMulOne(*pool, out, lhs, rhs, i, m, n, k, transpose_lhs,
+                transpose_rhs);
+    }
+  }
+}
+
+template <typename T>
+void SingleThreadedBatchMatMul(T* out, T* lhs, T* rhs, int64 batch, int64 m,
+                               int64 n, int64 k, int32 transpose_lhs,
+                               int32 transpose_rhs) {
+  Eigen::DefaultDevice device;
+  for (int64 i = 0; i < batch; ++i) {
+    MatMulOne(device, out, lhs, rhs, i, m, n, k, transpose_lhs, transpose_rhs);
+  }
+}
+
+}  // namespace
+
+void __xla_cpu_runtime_EigenBatchMatMulF32(const void* run_options_ptr,
+                                           float* out, float* lhs, float* rhs,
+                                           int64 batch, int64 m, int64 n,
+                                           int64 k, int32 transpose_lhs,
+                                           int32 transpose_rhs) {
+  BatchMatMul<float>(run_options_ptr, out, lhs, rhs, batch, m, n, k,
+                     transpose_lhs, transpose_rhs);
+}
+
+void __xla_cpu_runtime_EigenBatchMatMulF64(const void* run_options_ptr,
+                                           double* out, double* lhs,
+                                           double* rhs, int64 batch, int64 m,
+                                           int64 n, int64 k,
+                                           int32 transpose_lhs,
+                                           int32 transpose_rhs) {
+  BatchMatMul<double>(run_options_ptr, out, lhs, rhs, batch, m, n, k,
+                      transpose_lhs, transpose_rhs);
+}
+
+void __xla_cpu_runtime_EigenSingleThreadedBatchMatMulF32(
+    const void* run_options_ptr, float* out, float* lhs, float* rhs,
+    int64 batch, int64 m, int64 n, int64 k, int32 transpose_lhs,
+    int32 transpose_rhs) {
+  SingleThreadedBatchMatMul<float>(out, lhs, rhs, batch, m, n, k,
+                                   transpose_lhs, transpose_rhs);
+}
+
+void __xla_cpu_runtime_EigenSingleThreadedBatchMatMulF64(
+    const void* run_options_ptr, double* out, double* lhs, double* rhs,
+    int64 batch, int64 m, int64 n, int64 k, int32 transpose_lhs,
+    int32 transpose_rhs) {
+  SingleThreadedBatchMatMul<double>(out, lhs, rhs, batch, m, n, k,
+                                    transpose_lhs, transpose_rhs);
+}
@@ -0,0 +1,77 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_BATCH_MATMUL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_BATCH_MATMUL_H_
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+extern const char* const kEigenBatchMatMulF32SymbolName;
+extern const char* const kEigenBatchMatMulF64SymbolName;
+extern const char* const kEigenSingleThreadedBatchMatMulF32SymbolName;
+extern const char* const kEigenSingleThreadedBatchMatMulF64SymbolName;
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * Batched matrix multiplication over row-major operands.
+ *
+ * For each b in [0, batch): out[b] = op(lhs[b]) x op(rhs[b]), where lhs[b] is
+ * the b-th [m, k] matrix (stored [k, m] if 'transpose_lhs'), rhs[b] is the
+ * b-th [k, n] matrix (stored [n, k] if 'transpose_rhs') and out[b] is [m, n].
+ * Consecutive matrices of each operand are densely packed, so the batch stride
+ * is the matrix size.
+ *
+ * The multi-threaded variants use the intra-op thread pool in the
+ * ExecutableRunOptions pointed to by 'run_options_ptr': large batches are
+ * split across threads, small batches use a multi-threaded GEMM per matrix.
+ */
+extern "C" {
+
+extern void __xla_cpu_runtime_EigenBatchMatMulF32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    float* lhs, float* rhs, tensorflow::int64 batch, tensorflow::int64 m,
+    tensorflow::int64 n, tensorflow::int64 k, tensorflow::int32 transpose_lhs,
+    tensorflow::int32 transpose_rhs);
+
+extern void __xla_cpu_runtime_EigenBatchMatMulF64(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, double* out,
+    double* lhs, double* rhs, tensorflow::int64 batch, tensorflow::int64 m,
+    tensorflow::int64 n, tensorflow::int64 k, tensorflow::int32 transpose_lhs,
+    tensorflow::int32 transpose_rhs);
+
+extern void __xla_cpu_runtime_EigenSingleThreadedBatchMatMulF32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    float* lhs, float* rhs, tensorflow::int64 batch, tensorflow::int64 m,
+    tensorflow::int64 n, tensorflow::int64 k, tensorflow::int32 transpose_lhs,
+    tensorflow::int32 transpose_rhs);
+
+extern void __xla_cpu_runtime_EigenSingleThreadedBatchMatMulF64(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, double* out,
+    double* lhs, double* rhs, tensorflow::int64 batch, tensorflow::int64 m,
+    tensorflow::int64 n, tensorflow::int64 k, tensorflow::int32 transpose_lhs,
+    tensorflow::int32 transpose_rhs);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_BATCH_MATMUL_H_
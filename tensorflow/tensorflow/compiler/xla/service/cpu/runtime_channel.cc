@@ -0,0 +1,137 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_channel.h"
+
+#include <string.h>
+#include <memory>
+#include <unordered_map>
+
+#include "tensorflow/compiler/xla/service/xfeed_ring.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int32;
+using tensorflow::int64;
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kAcquireChannelSymbolName =
+    "__xla_cpu_runtime_AcquireChannel";
+const char* const kReleaseChannelSymbolName =
+    "__xla_cpu_runtime_ReleaseChannel";
+const char* const kChannelTrySendSymbolName =
+    "__xla_cpu_runtime_ChannelTrySend";
+const char* const kChannelSendSymbolName = "__xla_cpu_runtime_ChannelSend";
+const char* const kChannelTryRecvSymbolName =
+    "__xla_cpu_runtime_ChannelTryRecv";
+const char* const kChannelRecvSymbolName = "__xla_cpu_runtime_ChannelRecv";
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+namespace {
+
+tensorflow::mutex channels_mu(tensorflow::LINKER_INITIALIZED);
+
+struct Channel {
+  std::unique_ptr<xla::XfeedRing> ring;
+  // Number of transfers between AcquireChannel and ReleaseChannel.
+  int64 references = 0;
+};
+
+std::unordered_map<int64, Channel>* channels GUARDED_BY(channels_mu) =
+    nullptr;
+
+xla::XfeedRing* AsRing(void* channel) {
+  return static_cast<xla::XfeedRing*>(channel);
+}
+
+}  // namespace
+
+void* __xla_cpu_runtime_AcquireChannel(int64 channel_id, int64 message_bytes) {
+  tensorflow::mutex_lock lock(channels_mu);
+  if (channels == nullptr) {
+    channels = new std::unordered_map<int64, Channel>;
+  }
+  Channel& channel = (*channels)[channel_id];
+  if (channel.ring == nullptr) {
+    channel.ring.reset(
+        new xla::XfeedRing(xla::cpu::runtime::kChannelCapacity, message_bytes));
+  }
+  CHECK_GE(channel.ring->slot_bytes(), message_bytes)
+      << "Send and Recv on channel " << channel_id
+      << " disagree on the message size";
+  ++channel.references;
+  return channel.ring.get();
+}
+
+void __xla_cpu_runtime_ReleaseChannel(int64 channel_id) {
+  tensorflow::mutex_lock lock(channels_mu);
+  CHECK(channels != nullptr);
+  auto it = channels->find(channel_id);
+  CHECK(it != channels->end() && it->second.references > 0)
+      << "channel " << channel_id << " released more often than acquired";
+  // With no transfer in flight nothing else touches the ring, so it can be
+  // destroyed unless it still holds a message for a later Recv.
+  if (--it->second.references == 0 && it->second.ring->empty()) {
+    channels->erase(it);
+  }
+}
+
+int32 __xla_cpu_runtime_ChannelTrySend(void* channel, const void* data,
+                                       int64 message_bytes) {
+  void* slot = AsRing(channel)->TryBeginWrite();
+  if (slot == nullptr) {
+    return 0;
+  }
+  memcpy(slot, data, message_bytes);
+  AsRing(channel)->EndWrite(message_bytes);
+  return 1;
+}
+
+void __xla_cpu_runtime_ChannelSend(void* channel, const void* data,
+                                   int64 message_bytes) {
+  memcpy(AsRing(channel)->BeginWrite(), data, message_bytes);
+  AsRing(channel)->EndWrite(message_bytes);
+}
+
+int32 __xla_cpu_runtime_ChannelTryRecv(void* channel, void* data,
+                                       int64 message_bytes) {
+  int64 length;
+  void* slot = AsRing(channel)->TryBeginRead(&length);
+  if (slot == nullptr) {
+    return 0;
+  }
+  CHECK_EQ(length, message_bytes);
+  memcpy(data, slot, message_bytes);
+  AsRing(channel)->EndRead(slot);
+  return 1;
+}
+
+void __xla_cpu_runtime_ChannelRecv(void* channel, void* data,
+                                   int64 message_bytes) {
+  int64 length;
+  void* slot = AsRing(channel)->BeginRead(&length);
+  CHECK_EQ(length, message_bytes);
+  memcpy(data, slot, message_bytes);
+  AsRing(channel)->EndRead(slot);
+}
@@ -0,0 +1,93 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_CHANNEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_CHANNEL_H_
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+extern const char* const kAcquireChannelSymbolName;
+extern const char* const kReleaseChannelSymbolName;
+extern const char* const kChannelTrySendSymbolName;
+extern const char* const kChannelSendSymbolName;
+extern const char* const kChannelTryRecvSymbolName;
+extern const char* const kChannelRecvSymbolName;
+
+// Number of messages a channel holds before Send has to wait for Recv.
+constexpr tensorflow::int64 kChannelCapacity = 8;
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * In-process channels backing Send and Recv on the CPU backend.
+ *
+ * A channel is an xla::XfeedRing of 'kChannelCapacity' messages, kept in a
+ * process-wide registry under its channel id.  Every transfer holds a
+ * reference to its channel from before it touches the ring until it is done
+ * with it, and the registry destroys a channel once no transfer references it
+ * and it holds no undelivered message.  Emitted code therefore never keeps a
+ * channel's address beyond one transfer, and a channel outlives the
+ * executables using it only while a message sent by one awaits the other.
+ *
+ * Every channel has one sending and one receiving instruction, which may
+ * belong to different executables running on different threads.  Concurrent
+ * executions of the same side are serialized by the ring, and a side that
+ * has to wait blocks on the ring's condition variable.
+ *
+ * Send and Recv first try to complete without waiting, and record in their
+ * context whether they did.  Otherwise SendDone and RecvDone wait, so a
+ * pipeline stage only stalls at the point where it needs the transfer to have
+ * happened.
+ */
+extern "C" {
+
+// Returns the channel with id 'channel_id', carrying messages of
+// 'message_bytes' bytes, creating it if needed.  The caller holds a reference
+// to the channel until it calls __xla_cpu_runtime_ReleaseChannel.
+extern void* __xla_cpu_runtime_AcquireChannel(
+    tensorflow::int64 channel_id, tensorflow::int64 message_bytes);
+
+// Drops a reference obtained from __xla_cpu_runtime_AcquireChannel.
+extern void __xla_cpu_runtime_ReleaseChannel(tensorflow::int64 channel_id);
+
+// Copies 'message_bytes' from 'data' into the channel if it has room.
+// Returns whether it did.
+extern tensorflow::int32 __xla_cpu_runtime_ChannelTrySend(
+    void* channel, const void* data, tensorflow::int64 message_bytes);
+
+// Copies 'message_bytes' from 'data' into the channel, waiting for room.
+extern void __xla_cpu_runtime_ChannelSend(void* channel, const void* data,
+                                          tensorflow::int64 message_bytes);
+
+// Copies the oldest message of the channel into 'data' if there is one.
+// Returns whether it did.
+extern tensorflow::int32 __xla_cpu_runtime_ChannelTryRecv(
+    void* channel, void* data, tensorflow::int64 message_bytes);
+
+// Copies the oldest message of the channel into 'data', waiting for one.
+extern void __xla_cpu_runtime_ChannelRecv(void* channel, void* data,
+                                          tensorflow::int64 message_bytes);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_CHANNEL_H_
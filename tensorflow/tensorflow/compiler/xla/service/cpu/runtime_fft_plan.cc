@@ -0,0 +1,445 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_fft_plan.h"
+
+#define EIGEN_USE_THREADS
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <type_traits>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int32;
+using tensorflow::int64;
+using tensorflow::uint8;
+
+namespace {
+
+using Complex = std::complex<float>;
+
+// The values of xla::FftType, which the runtime does not depend on.
+constexpr int32 kFft = 0;
+constexpr int32 kIfft = 1;
+constexpr int32 kRfft = 2;
+constexpr int32 kIrfft = 3;
+
+// Bump whenever the layout below changes.
+constexpr int64 kFftPlanVersion = 2;
+constexpr int kMaxFftRank = 3;
+// The largest radix the butterflies handle well.  A length with a larger
+// prime factor p costs O(p) per element and stage, and is left to Eigen.
+constexpr int64 kMaxFftRadix = 16;
+// Enough for any radix decomposition of an int64 length.
+constexpr int kMaxFactors = 64;
+
+// The plan of the transform along one dimension.
+struct FftAxisPlan {
+  int64 length;
+  // The radices of the decimation-in-time stages, outermost first; their
+  // product is 'length'.
+  int64 num_factors;
+  int64 factors[kMaxFactors];
+  // Index of this dimension's 'length' roots of unity exp(-2*pi*i*k/length)
+  // within the plan's table.
+  int64 twiddle_offset;
+};
+
+// A plan is an FftPlan followed by its table of roots of unity.
+struct FftPlan {
+  int64 version;
+  int32 fft_type;
+  int32 fft_rank;
+  FftAxisPlan axes[kMaxFftRank];
+  int64 twiddle_count;
+  // The per-thread scratch of one transform, in complex elements: a line and
+  // its transform, each of the longest axis's length, the butterfly inputs
+  // of the largest radix, and for kIrfft a copy of the half spectra.
+  int64 max_length;
+  int64 max_factor;
+  int64 spectra_elements;
+};
+
+static_assert(std::is_trivially_copyable<FftPlan>::value,
+              "FFT plans are copied as bytes");
+static_assert(sizeof(FftPlan) % alignof(Complex) == 0,
+              "the table of roots of unity must be aligned");
+static_assert(alignof(FftPlan) <= 16, "plans are placed 16-byte aligned");
+
+// Prefers radix 4, then the small primes, so that the common power-of-two
+// and 2^a*3^b*5^c lengths only use cheap butterflies.  Returns false if a
+// factor is larger than kMaxFftRadix.
+bool Factorize(int64 length, FftAxisPlan* axis) {
+  axis->length = length;
+  axis->num_factors = 0;
+  int64 p = 4;
+  while (length > 1) {
+    while (length % p != 0) {
+      switch (p) {
+        case 4:
+          p = 2;
+          break;
+        case 2:
+          p = 3;
+          break;
+        default:
+          p += 2;
+          break;
+      }
+      if (p * p > length) {
+        p = length;
+      }
+    }
+    if (p > kMaxFftRadix) {
+      return false;
+    }
+    CHECK_LT(axis->num_factors, kMaxFactors);
+    axis->factors[axis->num_factors++] = p;
+    length /= p;
+  }
+  return true;
+}
+
+const Complex* Twiddles(const FftPlan& plan) {
+  return reinterpret_cast<const Complex*>(&plan + 1);
+}
+
+// Per-thread buffers of a transform, sized by the plan (see FftPlan).
+struct Workspace {
+  Complex* line;
+  Complex* transformed;
+  Complex* butterfly;
+  Complex* spectra;
+};
+
+// Returns the workspace of 'plan' in this thread's scratch buffer.  The
+// buffer only grows, so a thread allocates once for the largest plan it runs
+// rather than on every call.
+Workspace GetWorkspace(const FftPlan& plan) {
+  static thread_local std::vector<Complex> scratch;
+  const int64 scratch_elements =
+      2 * plan.max_length + plan.max_factor + plan.spectra_elements;
+  if (static_cast<int64>(scratch.size()) < scratch_elements) {
+    scratch.resize(scratch_elements);
+  }
+  Workspace workspace;
+  workspace.line = scratch.data();
+  workspace.transformed = workspace.line + plan.max_length;
+  workspace.butterfly = workspace.transformed + plan.max_length;
+  workspace.spectra = workspace.butterfly + plan.max_factor;
+  return workspace;
+}
+
+// Computes into 'out' the DFT of the 'n' elements in[j * stride], for the
+// sub-transform of 'axis' whose stages are 'factors'.  'twiddle_stride' is
+// axis.length / n, by which the roots of unity of the whole axis are strided
+// for this sub-transform.  This is the out-of-place mixed-radix
+// decimation-in-time recursion: the p sub-sequences of every p-th element are
+// transformed into consecutive parts of 'out', which are then combined in
+// place by radix-p butterflies.
+void Transform(Complex* out, const Complex* in, int64 n, int64 stride,
+               int64 twiddle_stride, const int64* factors,
+               const FftAxisPlan& axis, const Complex* twiddles, bool inverse,
+               Complex* butterfly) {
+  const int64 p = factors[0];
+  const int64 m = n / p;
+  if (m == 1) {
+    for (int64 q = 0; q < p; ++q) {
+      out[q] = in[q * stride];
+    }
+  } else {
+    for (int64 q = 0; q < p; ++q) {
+      Transform(out + q * m, in + q * stride, m, stride * p,
+                twiddle_stride * p, factors + 1, axis, twiddles, inverse,
+                butterfly);
+    }
+  }
+  for (int64 u = 0; u < m; ++u) {
+    for (int64 q = 0; q < p; ++q) {
+      butterfly[q] = out[u + q * m];
+    }
+    for (int64 q1 = 0; q1 < p; ++q1) {
+      const int64 k = u + q1 * m;
+      Complex sum = butterfly[0];
+      int64 twiddle_index = 0;
+      for (int64 q = 1; q < p; ++q) {
+        twiddle_index += twiddle_stride * k;
+        if (twiddle_index >= axis.length) {
+          twiddle_index -= axis.length;
+        }
+        const Complex twiddle = inverse ? std::conj(twiddles[twiddle_index])
+                                        : twiddles[twiddle_index];
+        sum += butterfly[q] * twiddle;
+      }
+      out[k] = sum;
+    }
+  }
+}
+
+// Transforms the line in workspace->line into workspace->transformed.
+void TransformLine(const FftPlan& plan, const FftAxisPlan& axis, bool inverse,
+                   Workspace* workspace) {
+  const int64 n = axis.length;
+  Transform(workspace->transformed, workspace->line, n, /*stride=*/1,
+            /*twiddle_stride=*/1, axis.factors, axis,
+            Twiddles(plan) + axis.twiddle_offset, inverse,
+            workspace->butterfly);
+  if (inverse) {
+    const float scale = 1.0f / n;
+    for (int64 j = 0; j < n; ++j) {
+      workspace->transformed[j] *= scale;
+    }
+  }
+}
+
+// Transforms, in place, every line along dimension 'dimension' of the dense
+// row-major complex array 'data' of dimensions 'dims'.
+void TransformDimension(const FftPlan& plan, int dimension, const int64* dims,
+                        int rank, bool inverse, Complex* data,
+                        Workspace* workspace) {
+  const FftAxisPlan& axis = plan.axes[dimension];
+  const int64 n = axis.length;
+  int64 outer = 1;
+  for (int i = 0; i < dimension; ++i) {
+    outer *= dims[i];
+  }
+  int64 inner = 1;
+  for (int i = dimension + 1; i < rank; ++i) {
+    inner *= dims[i];
+  }
+  for (int64 o = 0; o < outer; ++o) {
+    for (int64 i = 0; i < inner; ++i) {
+      Complex* line = data + o * n * inner + i;
+      for (int64 j = 0; j < n; ++j) {
+        workspace->line[j] = line[j * inner];
+      }
+      TransformLine(plan, axis, inverse, workspace);
+      for (int64 j = 0; j < n; ++j) {
+        line[j * inner] = workspace->transformed[j];
+      }
+    }
+  }
+}
+
+// Computes the FFT of one array of the batch.
+void PlannedFft(const FftPlan& plan, const void* operand, void* out,
+                Workspace* workspace) {
+  const int rank = plan.fft_rank;
+  int64 dims[kMaxFftRank];
+  int64 elements = 1;
+  for (int i = 0; i < rank; ++i) {
+    dims[i] = plan.axes[i].length;
+    elements *= dims[i];
+  }
+  const int last = rank - 1;
+  const int64 n = dims[last];
+  const int64 half = n / 2 + 1;
+  switch (plan.fft_type) {
+    case kFft:
+    case kIfft: {
+      Complex* data = static_cast<Complex*>(out);
+      if (data != operand) {
+        memcpy(data, operand, elements * sizeof(Complex));
+      }
+      for (int i = 0; i < rank; ++i) {
+        TransformDimension(plan, i, dims, rank, plan.fft_type == kIfft, data,
+                           workspace);
+      }
+      break;
+    }
+    case kRfft: {
+      // Transform the real lines along the last dimension, keeping the
+      // non-redundant half of each spectrum, then the other dimensions.
+      const float* input = static_cast<const float*>(operand);
+      Complex* data = static_cast<Complex*>(out);
+      for (int64 l = 0; l < elements / n; ++l) {
+        for (int64 j = 0; j < n; ++j) {
+          workspace->line[j] = Complex(input[l * n + j], 0.0f);
+        }
+        TransformLine(plan, plan.axes[last], /*inverse=*/false, workspace);
+        std::copy(workspace->transformed, workspace->transformed + half,
+                  data + l * half);
+      }
+      dims[last] = half;
+      for (int i = 0; i < last; ++i) {
+        TransformDimension(plan, i, dims, rank, /*inverse=*/false, data,
+                           workspace);
+      }
+      break;
+    }
+    case kIrfft: {
+      // Invert the other dimensions on a copy of the half spectra, then
+      // restore each full Hermitian spectrum along the last dimension and
+      // invert it into real values.  Only the copy is needed when the last
+      // dimension is the only one.
+      float* output = static_cast<float*>(out);
+      dims[last] = half;
+      const int64 lines = elements / n;
+      const Complex* data = static_cast<const Complex*>(operand);
+      if (last > 0) {
+        memcpy(workspace->spectra, data, lines * half * sizeof(Complex));
+        for (int i = 0; i < last; ++i) {
+          TransformDimension(plan, i, dims, rank, /*inverse=*/true,
+                             workspace->spectra, workspace);
+        }
+        data = workspace->spectra;
+      }
+      for (int64 l = 0; l < lines; ++l) {
+        const Complex* spectrum = data + l * half;
+        for (int64 k = 0; k < n; ++k) {
+          workspace->line[k] =
+              k < half ? spectrum[k] : std::conj(spectrum[n - k]);
+        }
+        TransformLine(plan, plan.axes[last], /*inverse=*/true, workspace);
+        for (int64 j = 0; j < n; ++j) {
+          output[l * n + j] = workspace->transformed[j].real();
+        }
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Invalid FFT type " << plan.fft_type;
+  }
+}
+
+}  // namespace
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kPlannedFftSymbolName = "__xla_cpu_runtime_PlannedFft";
+
+bool CanBuildFftPlan(const int64* fft_length, int32 fft_rank) {
+  if (fft_rank < 1 || fft_rank > kMaxFftRank) {
+    return false;
+  }
+  for (int32 i = 0; i < fft_rank; ++i) {
+    FftAxisPlan axis;
+    if (fft_length[i] <= 0 || !Factorize(fft_length[i], &axis)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int64 FftPlanSize(const int64* fft_length, int32 fft_rank) {
+  int64 twiddle_count = 0;
+  for (int32 i = 0; i < fft_rank; ++i) {
+    twiddle_count += fft_length[i];
+  }
+  return sizeof(FftPlan) + twiddle_count * sizeof(Complex);
+}
+
+std::vector<uint8> BuildFftPlan(int32 fft_type, const int64* fft_length,
+                                int32 fft_rank) {
+  CHECK(CanBuildFftPlan(fft_length, fft_rank));
+  FftPlan plan;
+  memset(&plan, 0, sizeof(plan));
+  plan.version = kFftPlanVersion;
+  plan.fft_type = fft_type;
+  plan.fft_rank = fft_rank;
+  std::vector<Complex> twiddles;
+  plan.max_factor = 1;
+  int64 elements = 1;
+  for (int32 i = 0; i < fft_rank; ++i) {
+    FftAxisPlan* axis = &plan.axes[i];
+    CHECK(Factorize(fft_length[i], axis));
+    plan.max_length = std::max(plan.max_length, fft_length[i]);
+    for (int64 f = 0; f < axis->num_factors; ++f) {
+      plan.max_factor = std::max(plan.max_factor, axis->factors[f]);
+    }
+    elements *= fft_length[i];
+    axis->twiddle_offset = twiddles.size();
+    for (int64 k = 0; k < fft_length[i]; ++k) {
+      const double angle = -2.0 * M_PI * k / fft_length[i];
+      twiddles.emplace_back(static_cast<float>(std::cos(angle)),
+                            static_cast<float>(std::sin(angle)));
+    }
+  }
+  plan.twiddle_count = twiddles.size();
+  if (fft_type == kIrfft && fft_rank > 1) {
+    const int64 n = fft_length[fft_rank - 1];
+    plan.spectra_elements = elements / n * (n / 2 + 1);
+  }
+
+  std::vector<uint8> bytes(sizeof(plan) + twiddles.size() * sizeof(Complex));
+  memcpy(bytes.data(), &plan, sizeof(plan));
+  memcpy(bytes.data() + sizeof(plan), twiddles.data(),
+         twiddles.size() * sizeof(Complex));
+  DCHECK_EQ(bytes.size(), FftPlanSize(fft_length, fft_rank));
+  return bytes;
+}
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+void __xla_cpu_runtime_PlannedFft(const void* run_options_ptr,
+                                  const void* plan_ptr, void* out,
+                                  void* operand, int64 input_batch) {
+  const FftPlan& plan = *static_cast<const FftPlan*>(plan_ptr);
+  CHECK_EQ(plan.version, kFftPlanVersion);
+  int64 elements = 1;
+  for (int i = 0; i < plan.fft_rank; ++i) {
+    elements *= plan.axes[i].length;
+  }
+  const int64 half_elements =
+      elements / plan.axes[plan.fft_rank - 1].length *
+      (plan.axes[plan.fft_rank - 1].length / 2 + 1);
+  int64 operand_bytes = elements * sizeof(Complex);
+  int64 out_bytes = elements * sizeof(Complex);
+  if (plan.fft_type == kRfft) {
+    operand_bytes = elements * sizeof(float);
+    out_bytes = half_elements * sizeof(Complex);
+  } else if (plan.fft_type == kIrfft) {
+    operand_bytes = half_elements * sizeof(Complex);
+    out_bytes = elements * sizeof(float);
+  }
+
+  auto transform_batch = [&](int64 first, int64 last) {
+    Workspace workspace = GetWorkspace(plan);
+    for (int64 b = first; b < last; ++b) {
+      PlannedFft(plan, static_cast<const char*>(operand) + b * operand_bytes,
+                 static_cast<char*>(out) + b * out_bytes, &workspace);
+    }
+  };
+
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  const Eigen::ThreadPoolDevice* pool =
+      run_options == nullptr ? nullptr : run_options->intra_op_thread_pool();
+  if (pool != nullptr && input_batch > 1) {
+    const double bytes = operand_bytes + out_bytes;
+    const Eigen::TensorOpCost cost(
+        bytes, bytes,
+        5.0 * elements * std::log2(std::max<double>(2.0, elements)));
+    pool->parallelFor(input_batch, cost,
+                      [&](Eigen::Index first, Eigen::Index last) {
+                        transform_batch(first, last);
+                      });
+  } else {
+    transform_batch(0, input_batch);
+  }
+}
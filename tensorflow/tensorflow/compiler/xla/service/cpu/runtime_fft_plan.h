@@ -0,0 +1,82 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FFT_PLAN_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FFT_PLAN_H_
+
+#include <vector>
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+extern const char* const kPlannedFftSymbolName;
+
+/**
+ * Returns whether BuildFftPlan supports these lengths: 'fft_rank' is between 1
+ * and 3, and every length is positive and has no prime factor above 16.
+ * Larger radices are left to the Eigen FFT.
+ */
+bool CanBuildFftPlan(const tensorflow::int64* fft_length,
+                     tensorflow::int32 fft_rank);
+
+/**
+ * Builds the plan of an FFT of type 'fft_type' (an xla::FftType) over the
+ * 'fft_rank' <= 3 innermost dimensions, whose lengths are 'fft_length'.
+ *
+ * The plan holds, for each transformed dimension, its radix decomposition and
+ * its table of roots of unity, computed in double precision.  It is returned
+ * as bytes so that the compiler can embed it in the generated code as a
+ * constant; it must be placed at a 16-byte aligned address.  The plan also
+ * records the size of the scratch a transform needs, which each thread keeps
+ * across calls.  Requires CanBuildFftPlan.
+ */
+std::vector<tensorflow::uint8> BuildFftPlan(tensorflow::int32 fft_type,
+                                            const tensorflow::int64* fft_length,
+                                            tensorflow::int32 fft_rank);
+
+/**
+ * Returns the size in bytes of the plan BuildFftPlan would build, without
+ * building it.
+ */
+tensorflow::int64 FftPlanSize(const tensorflow::int64* fft_length,
+                              tensorflow::int32 fft_rank);
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * Computes the FFT described by 'plan' (see xla::cpu::runtime::BuildFftPlan)
+ * on each of the 'input_batch' dense row-major arrays in 'operand', writing
+ * the results to 'out'.  Complex elements are pairs of floats.
+ *
+ * Nothing is computed from the FFT lengths at run time: the mixed-radix
+ * transforms only index into the plan's tables.  The batch is split across the
+ * intra-op thread pool in the ExecutableRunOptions, if there is one.
+ */
+extern "C" {
+
+extern void __xla_cpu_runtime_PlannedFft(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const void* plan, void* out, void* operand, tensorflow::int64 input_batch);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FFT_PLAN_H_
@@ -0,0 +1,422 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_sort.h"
+
+#define EIGEN_USE_THREADS
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int32;
+using tensorflow::int64;
+using tensorflow::uint32;
+using tensorflow::uint64;
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kSortF32SymbolName = "__xla_cpu_runtime_SortF32";
+const char* const kSortF64SymbolName = "__xla_cpu_runtime_SortF64";
+const char* const kSortS32SymbolName = "__xla_cpu_runtime_SortS32";
+const char* const kSortS64SymbolName = "__xla_cpu_runtime_SortS64";
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+namespace {
+
+// Rows up to this length are sorted with a sorting network.
+constexpr int64 kNetworkMaxLength = 32;
+
+// Rows shorter than this are never split across threads.
+constexpr int64 kParallelRowMinLength = 1 << 16;
+
+// Maps keys to unsigned integers of the same width whose unsigned order is the
+// total order of the keys, so every sort below only compares integers.
+template <typename T>
+struct OrderedBits;
+
+template <>
+struct OrderedBits<float> {
+  using Type = uint32;
+  static Type Encode(float key) {
+    uint32 bits;
+    memcpy(&bits, &key, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  }
+  static float Decode(Type bits) {
+    bits = (bits & 0x80000000u) ? bits ^ 0x80000000u : ~bits;
+    float key;
+    memcpy(&key, &bits, sizeof(key));
+    return key;
+  }
+};
+
+template <>
+struct OrderedBits<double> {
+  using Type = uint64;
+  static Type Encode(double key) {
+    uint64 bits;
+    memcpy(&bits, &key, sizeof(bits));
+    return (bits & (1ULL << 63)) ? ~bits : bits | (1ULL << 63);
+  }
+  static double Decode(Type bits) {
+    bits = (bits & (1ULL << 63)) ? bits ^ (1ULL << 63) : ~bits;
+    double key;
+    memcpy(&key, &bits, sizeof(key));
+    return key;
+  }
+};
+
+template <>
+struct OrderedBits<int32> {
+  using Type = uint32;
+  static Type Encode(int32 key) {
+    return static_cast<uint32>(key) ^ 0x80000000u;
+  }
+  static int32 Decode(Type bits) {
+    return static_cast<int32>(bits ^ 0x80000000u);
+  }
+};
+
+template <>
+struct OrderedBits<int64> {
+  using Type = uint64;
+  static Type Encode(int64 key) {
+    return static_cast<uint64>(key) ^ (1ULL << 63);
+  }
+  static int64 Decode(Type bits) {
+    return static_cast<int64>(bits ^ (1ULL << 63));
+  }
+};
+
+// Key/value sorts carry the original position of each key so that values can
+// be gathered afterwards and equal keys keep their order.  32-bit keys are
+// packed with their position into a single integer, which keeps them on the
+// integer sorting-network path.
+struct WideKeyAndIndex {
+  uint64 key;
+  uint64 index;
+  bool operator<(const WideKeyAndIndex& other) const {
+    return key < other.key || (key == other.key && index < other.index);
+  }
+};
+
+// In-place bitonic sorting network over a power-of-two 'n' elements.  All
+// compare-exchanges are branch-free min/max pairs, which the compiler turns
+// into vector min/max instructions.
+template <typename U>
+void BitonicSort(U* data, int64 n) {
+  for (int64 k = 2; k <= n; k <<= 1) {
+    for (int64 j = k >> 1; j > 0; j >>= 1) {
+      for (int64 i = 0; i < n; ++i) {
+        const int64 l = i ^ j;
+        if (l > i) {
+          const U lo = std::min(data[i], data[l]);
+          const U hi = std::max(data[i], data[l]);
+          const bool ascending = (i & k) == 0;
+          data[i] = ascending ? lo : hi;
+          data[l] = ascending ? hi : lo;
+        }
+      }
+    }
+  }
+}
+
+// Sorts 'length' <= kNetworkMaxLength integers by padding them to a power of
+// two with maximal sentinels, which the network moves past the real elements.
+template <typename U>
+void NetworkSort(U* data, int64 length) {
+  U buffer[kNetworkMaxLength];
+  int64 padded_length = 1;
+  while (padded_length < length) {
+    padded_length <<= 1;
+  }
+  std::copy(data, data + length, buffer);
+  std::fill(buffer + length, buffer + padded_length,
+            std::numeric_limits<U>::max());
+  BitonicSort(buffer, padded_length);
+  std::copy(buffer, buffer + length, data);
+}
+
+// Returns how many of the first 'diagonal' outputs of merging 'a' and 'b' come
+// from 'a' (the merge path split point).
+template <typename U>
+int64 MergePathSplit(const U* a, int64 a_length, const U* b, int64 b_length,
+                     int64 diagonal) {
+  int64 lo = std::max<int64>(0, diagonal - b_length);
+  int64 hi = std::min(diagonal, a_length);
+  while (lo < hi) {
+    const int64 i = lo + (hi - lo) / 2;
+    if (b[diagonal - i - 1] < a[i]) {
+      hi = i;
+    } else {
+      lo = i + 1;
+    }
+  }
+  return lo;
+}
+
+// Sorts 'length' elements using every thread of 'pool': equal chunks are
+// sorted independently, then merged pairwise in log2(chunks) rounds.  Each
+// round splits its merges along the merge path so that all threads stay busy
+// even when only one merge remains.
+template <typename U>
+void ParallelMergeSort(U* data, int64 length,
+                       const Eigen::ThreadPoolDevice* pool) {
+  const int64 num_threads = pool->numThreads();
+  int64 num_chunks = 1;
+  while (num_chunks * 2 <= num_threads &&
+         length / (num_chunks * 2) >= kNetworkMaxLength) {
+    num_chunks *= 2;
+  }
+  auto chunk_begin = [length, num_chunks](int64 chunk) {
+    return length * chunk / num_chunks;
+  };
+
+  const double chunk_length = static_cast<double>(length) / num_chunks;
+  const Eigen::TensorOpCost sort_cost(
+      sizeof(U) * chunk_length, sizeof(U) * chunk_length,
+      chunk_length * std::log2(std::max(2.0, chunk_length)));
+  pool->parallelFor(num_chunks, sort_cost,
+                    [&](Eigen::Index first, Eigen::Index last) {
+                      for (Eigen::Index c = first; c < last; ++c) {
+                        std::sort(data + chunk_begin(c),
+                                  data + chunk_begin(c + 1));
+                      }
+                    });
+
+  std::vector<U> scratch(length);
+  U* src = data;
+  U* dst = scratch.data();
+  for (int64 width = 1; width < num_chunks; width *= 2) {
+    const int64 num_merges = num_chunks / (2 * width);
+    const int64 parts_per_merge = std::max<int64>(1, num_threads / num_merges);
+    const double part_length =
+        static_cast<double>(length) / (num_merges * parts_per_merge);
+    const Eigen::TensorOpCost merge_cost(sizeof(U) * part_length,
+                                         sizeof(U) * part_length, part_length);
+    pool->parallelFor(
+        num_merges * parts_per_merge, merge_cost,
+        [&](Eigen::Index first, Eigen::Index last) {
+          for (Eigen::Index t = first; t < last; ++t) {
+            const int64 merge = t / parts_per_merge;
+            const int64 part = t % parts_per_merge;
+            const int64 begin = chunk_begin(2 * merge * width);
+            const int64 middle = chunk_begin((2 * merge + 1) * width);
+            const int64 end = chunk_begin((2 * merge + 2) * width);
+            const U* a = src + begin;
+            const U* b = src + middle;
+            const int64 a_length = middle - begin;
+            const int64 b_length = end - middle;
+            const int64 total = end - begin;
+            const int64 diagonal_lo = total * part / parts_per_merge;
+            const int64 diagonal_hi = total * (part + 1) / parts_per_merge;
+            const int64 a_lo =
+                MergePathSplit(a, a_length, b, b_length, diagonal_lo);
+            const int64 a_hi =
+                MergePathSplit(a, a_length, b, b_length, diagonal_hi);
+            std::merge(a + a_lo, a + a_hi, b + (diagonal_lo - a_lo),
+                       b + (diagonal_hi - a_hi), dst + begin + diagonal_lo);
+          }
+        });
+    std::swap(src, dst);
+  }
+  if (src != data) {
+    std::copy(src, src + length, data);
+  }
+}
+
+// Sorts short rows of integers with NetworkSort; returns false if the row is
+// not eligible.
+template <typename U>
+typename std::enable_if<std::is_integral<U>::value, bool>::type TryNetworkSort(
+    U* data, int64 length) {
+  if (length > kNetworkMaxLength) {
+    return false;
+  }
+  NetworkSort(data, length);
+  return true;
+}
+
+bool TryNetworkSort(WideKeyAndIndex* data, int64 length) { return false; }
+
+// Sorts 'length' unique-or-interchangeable elements, picking the algorithm by
+// length.  'pool' may be null to stay on the calling thread.
+template <typename U>
+void SortElements(U* data, int64 length, const Eigen::ThreadPoolDevice* pool) {
+  if (TryNetworkSort(data, length)) {
+    return;
+  } else if (pool != nullptr && pool->numThreads() > 1 &&
+             length >= kParallelRowMinLength) {
+    ParallelMergeSort(data, length, pool);
+  } else {
+    std::sort(data, data + length);
+  }
+}
+
+// Reorders the 'value_bytes'-sized elements of 'values' so that element i
+// becomes old element 'index_of(i)'.
+template <typename IndexOf>
+void GatherValues(char* values, int64 value_bytes, int64 length,
+                  IndexOf index_of) {
+  std::vector<char> sorted_values(length * value_bytes);
+  for (int64 i = 0; i < length; ++i) {
+    memcpy(&sorted_values[i * value_bytes], values + index_of(i) * value_bytes,
+           value_bytes);
+  }
+  memcpy(values, sorted_values.data(), length * value_bytes);
+}
+
+template <typename T>
+void SortKeysRow(T* keys, int64 length, const Eigen::ThreadPoolDevice* pool) {
+  using Bits = OrderedBits<T>;
+  using U = typename Bits::Type;
+  U small_buffer[kNetworkMaxLength];
+  std::vector<U> large_buffer;
+  U* encoded = small_buffer;
+  if (length > kNetworkMaxLength) {
+    large_buffer.resize(length);
+    encoded = large_buffer.data();
+  }
+  for (int64 i = 0; i < length; ++i) {
+    encoded[i] = Bits::Encode(keys[i]);
+  }
+  SortElements(encoded, length, pool);
+  for (int64 i = 0; i < length; ++i) {
+    keys[i] = Bits::Decode(encoded[i]);
+  }
+}
+
+template <typename T>
+typename std::enable_if<sizeof(T) == 4>::type SortKeyValueRow(
+    T* keys, char* values, int64 value_bytes, int64 length,
+    const Eigen::ThreadPoolDevice* pool) {
+  using Bits = OrderedBits<T>;
+  CHECK_LE(length, int64{1} << 32);
+  std::vector<uint64> packed(length);
+  for (int64 i = 0; i < length; ++i) {
+    packed[i] = (static_cast<uint64>(Bits::Encode(keys[i])) << 32) |
+                static_cast<uint64>(i);
+  }
+  SortElements(packed.data(), length, pool);
+  for (int64 i = 0; i < length; ++i) {
+    keys[i] = Bits::Decode(static_cast<uint32>(packed[i] >> 32));
+  }
+  GatherValues(values, value_bytes, length,
+               [&packed](int64 i) { return packed[i] & 0xffffffffu; });
+}
+
+template <typename T>
+typename std::enable_if<sizeof(T) == 8>::type SortKeyValueRow(
+    T* keys, char* values, int64 value_bytes, int64 length,
+    const Eigen::ThreadPoolDevice* pool) {
+  using Bits = OrderedBits<T>;
+  std::vector<WideKeyAndIndex> pairs(length);
+  for (int64 i = 0; i < length; ++i) {
+    pairs[i] = {Bits::Encode(keys[i]), static_cast<uint64>(i)};
+  }
+  SortElements(pairs.data(), length, pool);
+  for (int64 i = 0; i < length; ++i) {
+    keys[i] = Bits::Decode(pairs[i].key);
+  }
+  GatherValues(values, value_bytes, length,
+               [&pairs](int64 i) { return pairs[i].index; });
+}
+
+template <typename T>
+void Sort(const void* run_options_ptr, T* keys, void* values,
+          int64 value_bytes, int64 num_rows, int64 row_length) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  const Eigen::ThreadPoolDevice* pool =
+      run_options == nullptr ? nullptr : run_options->intra_op_thread_pool();
+  char* value_bytes_ptr = static_cast<char*>(values);
+
+  auto sort_rows = [=](int64 first, int64 last,
+                       const Eigen::ThreadPoolDevice* row_pool) {
+    for (int64 row = first; row < last; ++row) {
+      T* row_keys = keys + row * row_length;
+      if (value_bytes_ptr == nullptr) {
+        SortKeysRow(row_keys, row_length, row_pool);
+      } else {
+        SortKeyValueRow(row_keys,
+                        value_bytes_ptr + row * row_length * value_bytes,
+                        value_bytes, row_length, row_pool);
+      }
+    }
+  };
+
+  // Parallelize across rows when there are enough of them to occupy the pool
+  // or they are too short to split; otherwise split each row instead.
+  if (pool != nullptr && num_rows > 1 &&
+      (num_rows >= pool->numThreads() || row_length < kParallelRowMinLength)) {
+    const double row_bytes =
+        static_cast<double>(row_length) * (sizeof(T) + value_bytes);
+    const Eigen::TensorOpCost cost(
+        row_bytes, row_bytes,
+        row_length * std::log2(std::max<double>(2.0, row_length)));
+    pool->parallelFor(num_rows, cost,
+                      [&](Eigen::Index first, Eigen::Index last) {
+                        sort_rows(first, last, /*row_pool=*/nullptr);
+                      });
+  } else {
+    sort_rows(0, num_rows, pool);
+  }
+}
+
+}  // namespace
+
+void __xla_cpu_runtime_SortF32(const void* run_options_ptr, float* keys,
+                               void* values, int64 value_bytes, int64 num_rows,
+                               int64 row_length) {
+  Sort<float>(run_options_ptr, keys, values, value_bytes, num_rows,
+              row_length);
+}
+
+void __xla_cpu_runtime_SortF64(const void* run_options_ptr, double* keys,
+                               void* values, int64 value_bytes, int64 num_rows,
+                               int64 row_length) {
+  Sort<double>(run_options_ptr, keys, values, value_bytes, num_rows,
+               row_length);
+}
+
+void __xla_cpu_runtime_SortS32(const void* run_options_ptr, int32* keys,
+                               void* values, int64 value_bytes, int64 num_rows,
+                               int64 row_length) {
+  Sort<int32>(run_options_ptr, keys, values, value_bytes, num_rows,
+              row_length);
+}
+
+void __xla_cpu_runtime_SortS64(const void* run_options_ptr, int64* keys,
+                               void* values, int64 value_bytes, int64 num_rows,
+                               int64 row_length) {
+  Sort<int64>(run_options_ptr, keys, values, value_bytes, num_rows,
+              row_length);
+}
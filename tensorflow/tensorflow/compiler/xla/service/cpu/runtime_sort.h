@@ -0,0 +1,79 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_SORT_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_SORT_H_
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+extern const char* const kSortF32SymbolName;
+extern const char* const kSortF64SymbolName;
+extern const char* const kSortS32SymbolName;
+extern const char* const kSortS64SymbolName;
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * In-place ascending sort of 'num_rows' dense rows of 'row_length' keys each,
+ * i.e. a sort along the minor dimension of a row-major array.
+ *
+ * Floating point keys are ordered by their IEEE total order, so -0 sorts
+ * before +0 and NaNs are placed at the ends of the row according to their
+ * sign bit.
+ *
+ * If 'values' is non-null it holds one 'value_bytes'-sized element per key,
+ * laid out like 'keys', and is permuted along with them.  Equal keys keep
+ * their relative order in that case, so the result is deterministic.
+ *
+ * Rows short enough for a sorting network are sorted with branch-free
+ * compare-exchange sequences over an order-preserving integer encoding of the
+ * keys.  Many rows are split across the intra-op thread pool in the
+ * ExecutableRunOptions; a few long rows are each sorted in chunks in parallel
+ * and combined with parallel merge rounds.  A null thread pool sorts on the
+ * calling thread.
+ */
+extern "C" {
+
+extern void __xla_cpu_runtime_SortF32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* keys,
+    void* values, tensorflow::int64 value_bytes, tensorflow::int64 num_rows,
+    tensorflow::int64 row_length);
+
+extern void __xla_cpu_runtime_SortF64(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, double* keys,
+    void* values, tensorflow::int64 value_bytes, tensorflow::int64 num_rows,
+    tensorflow::int64 row_length);
+
+extern void __xla_cpu_runtime_SortS32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    tensorflow::int32* keys, void* values, tensorflow::int64 value_bytes,
+    tensorflow::int64 num_rows, tensorflow::int64 row_length);
+
+extern void __xla_cpu_runtime_SortS64(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    tensorflow::int64* keys, void* values, tensorflow::int64 value_bytes,
+    tensorflow::int64 num_rows, tensorflow::int64 row_length);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_SORT_H_
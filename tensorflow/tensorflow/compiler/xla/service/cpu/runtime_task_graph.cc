@@ -0,0 +1,221 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_task_graph.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int32;
+using tensorflow::uint64;
+using tensorflow::uint8;
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kExecuteTaskGraphSymbolName =
+    "__xla_cpu_runtime_ExecuteTaskGraph";
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+namespace {
+
+using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
+                                     uint64*);
+
+tensorflow::mutex pools_mu(tensorflow::LINKER_INITIALIZED);
+
+// Pools are never destroyed, since executables may run until process exit.
+std::map<int32, std::unique_ptr<tensorflow::thread::ThreadPool>>* pools
+    GUARDED_BY(pools_mu) = nullptr;
+
+// Returns the inter-op thread pool with 'num_threads' threads, creating it on
+// first use.  tensorflow::thread::ThreadPool keeps a queue per worker and lets
+// idle workers steal from the others.
+tensorflow::thread::ThreadPool* GetInterOpThreadPool(int32 num_threads) {
+  tensorflow::mutex_lock lock(pools_mu);
+  if (pools == nullptr) {
+    pools =
+        new std::map<int32, std::unique_ptr<tensorflow::thread::ThreadPool>>;
+  }
+  std::unique_ptr<tensorflow::thread::ThreadPool>& pool =
+      (*pools)[num_threads];
+  if (pool == nullptr) {
+    pool.reset(new tensorflow::thread::ThreadPool(
+        tensorflow::Env::Default(), "xla_cpu_inter_op", num_threads));
+  }
+  return pool.get();
+}
+
+// State of one call to __xla_cpu_runtime_ExecuteTaskGraph.
+class TaskGraphExecution {
+ public:
+  TaskGraphExecution(tensorflow::thread::ThreadPool* pool,
+                     const void* run_options_ptr, void** temps,
+                     uint64* prof_counters, int32 task_count,
+                     void** task_functions, void** task_results,
+                     void** task_params, const int32* task_graph,
+                     const uint8* caller_thread_tasks)
+      : pool_(pool),
+        run_options_ptr_(run_options_ptr),
+        temps_(temps),
+        prof_counters_(prof_counters),
+        task_functions_(task_functions),
+        task_results_(task_results),
+        task_params_(task_params),
+        successor_offsets_(task_graph + task_count),
+        successors_(task_graph + 2 * task_count + 1),
+        caller_thread_tasks_(caller_thread_tasks),
+        pending_predecessors_(new std::atomic<int32>[task_count]),
+        unfinished_tasks_(task_count) {
+    for (int32 i = 0; i < task_count; ++i) {
+      pending_predecessors_[i].store(task_graph[i], std::memory_order_relaxed);
+    }
+  }
+
+  // Runs 'task', then keeps running one of the successors it makes ready on
+  // this thread, which is likely to have their operands in cache.  Further
+  // ready successors are scheduled.  Pool threads only continue with tasks
+  // that may run off the calling thread.
+  void Run(int32 task, bool on_caller_thread) {
+    while (task >= 0) {
+      reinterpret_cast<ComputeFunctionType>(task_functions_[task])(
+          task_results_[task], run_options_ptr_,
+          static_cast<const void**>(task_params_[task]), temps_,
+          prof_counters_);
+      int32 next_task = -1;
+      for (int32 i = successor_offsets_[task];
+           i < successor_offsets_[task + 1]; ++i) {
+        const int32 successor = successors_[i];
+        if (pending_predecessors_[successor].fetch_sub(
+                1, std::memory_order_acq_rel) != 1) {
+          continue;
+        }
+        if (next_task < 0 &&
+            (on_caller_thread || !caller_thread_tasks_[successor])) {
+          next_task = successor;
+        } else {
+          Schedule(successor);
+        }
+      }
+      FinishTask();
+      task = next_task;
+    }
+  }
+
+  // Hands the ready 'task' to the pool, or to the calling thread.
+  void Schedule(int32 task) {
+    if (caller_thread_tasks_[task]) {
+      tensorflow::mutex_lock lock(mu_);
+      caller_ready_.push_back(task);
+      cv_.notify_all();
+      return;
+    }
+    pool_->Schedule([this, task]() { Run(task, /*on_caller_thread=*/false); });
+  }
+
+  // Runs the tasks handed to the calling thread until all tasks have
+  // finished.
+  void RunCallerThreadTasks() {
+    while (true) {
+      int32 task;
+      {
+        tensorflow::mutex_lock lock(mu_);
+        while (caller_ready_.empty() && unfinished_tasks_ > 0) {
+          cv_.wait(lock);
+        }
+        if (caller_ready_.empty()) {
+          return;
+        }
+        task = caller_ready_.front();
+        caller_ready_.pop_front();
+      }
+      Run(task, /*on_caller_thread=*/true);
+    }
+  }
+
+ private:
+  // Nothing may touch this object after the last task is counted down, as
+  // the calling thread then returns.
+  void FinishTask() {
+    tensorflow::mutex_lock lock(mu_);
+    if (--unfinished_tasks_ == 0) {
+      cv_.notify_all();
+    }
+  }
+
+  tensorflow::thread::ThreadPool* const pool_;
+  const void* const run_options_ptr_;
+  void** const temps_;
+  uint64* const prof_counters_;
+  void** const task_functions_;
+  void** const task_results_;
+  void** const task_params_;
+  const int32* const successor_offsets_;
+  const int32* const successors_;
+  const uint8* const caller_thread_tasks_;
+  std::unique_ptr<std::atomic<int32>[]> pending_predecessors_;
+
+  tensorflow::mutex mu_;
+  tensorflow::condition_variable cv_;
+  std::deque<int32> caller_ready_ GUARDED_BY(mu_);
+  int32 unfinished_tasks_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+void __xla_cpu_runtime_ExecuteTaskGraph(
+    const void* run_options_ptr, void** temps, uint64* prof_counters,
+    int32 num_threads, int32 task_count, void** task_functions,
+    void** task_results, void** task_params, const int32* task_graph,
+    const uint8* caller_thread_tasks) {
+  CHECK_GT(num_threads, 0);
+  TaskGraphExecution execution(GetInterOpThreadPool(num_threads),
+                               run_options_ptr, temps, prof_counters,
+                               task_count, task_functions, task_results,
+                               task_params, task_graph, caller_thread_tasks);
+  // Schedule all but the first source task, and run that one on the calling
+  // thread, which then runs the tasks handed to it.
+  int32 first_source = -1;
+  for (int32 i = 0; i < task_count; ++i) {
+    if (task_graph[i] != 0) {
+      continue;
+    }
+    if (first_source < 0) {
+      first_source = i;
+    } else {
+      execution.Schedule(i);
+    }
+  }
+  CHECK(task_count == 0 || first_source >= 0)
+      << "task graph without a source task";
+  if (first_source >= 0) {
+    execution.Run(first_source, /*on_caller_thread=*/true);
+  }
+  execution.RunCallerThreadTasks();
+}
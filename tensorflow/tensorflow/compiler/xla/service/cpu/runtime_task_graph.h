@@ -0,0 +1,70 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_TASK_GRAPH_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_TASK_GRAPH_H_
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+extern const char* const kExecuteTaskGraphSymbolName;
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * Inter-op scheduler of the sequential CPU backend.
+ *
+ * With the `xla_cpu_inter_op_parallelism_threads` debug option set, the
+ * top-level instructions of the entry computation are outlined into tasks
+ * (see `xla::cpu::InterOpParallelization`), and the entry function hands them
+ * to this runtime together with their dependency graph instead of calling
+ * them in sequence.  Tasks whose predecessors have all finished are run on a
+ * work-stealing thread pool shared by all executables asking for the same
+ * number of threads.  That pool is separate from the intra-op Eigen pool, so
+ * tasks may fork and join partitioned instructions without starving it.
+ *
+ * Tasks that may block on the host, such as infeeds and outfeeds, only run on
+ * the thread that called the entry function: blocked on the shared pool, they
+ * would hold its workers while the executions that are to unblock them wait.
+ */
+extern "C" {
+
+// Runs 'task_count' tasks and returns once all of them have finished.  Task
+// 'i' is a call to the compute function 'task_functions[i]' with result
+// buffer 'task_results[i]', parameter array 'task_params[i]', and the given
+// 'run_options_ptr', 'temps' and 'prof_counters'.
+//
+// 'task_graph' holds the dependencies in compressed sparse row form: the
+// number of predecessors of each task, then 'task_count + 1' offsets into the
+// successor list, then the successor list itself.  Tasks are numbered in a
+// topological order.  Task 'i' only runs on the calling thread if
+// 'caller_thread_tasks[i]' is nonzero.
+extern void __xla_cpu_runtime_ExecuteTaskGraph(
+    const void* run_options_ptr, void** temps,
+    tensorflow::uint64* prof_counters, tensorflow::int32 num_threads,
+    tensorflow::int32 task_count, void** task_functions, void** task_results,
+    void** task_params, const tensorflow::int32* task_graph,
+    const tensorflow::uint8* caller_thread_tasks);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_TASK_GRAPH_H_
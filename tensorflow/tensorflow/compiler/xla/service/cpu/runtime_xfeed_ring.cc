@@ -0,0 +1,88 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_xfeed_ring.h"
+
+#include "tensorflow/compiler/xla/service/xfeed_ring.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int32;
+using tensorflow::int64;
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+const char* const kAcquireInfeedRingSlotSymbolName =
+    "__xla_cpu_runtime_AcquireInfeedRingSlot";
+const char* const kReleaseInfeedRingSlotSymbolName =
+    "__xla_cpu_runtime_ReleaseInfeedRingSlot";
+const char* const kAcquireOutfeedRingSlotSymbolName =
+    "__xla_cpu_runtime_AcquireOutfeedRingSlot";
+const char* const kReleaseOutfeedRingSlotSymbolName =
+    "__xla_cpu_runtime_ReleaseOutfeedRingSlot";
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+namespace {
+
+xla::XfeedRing* GetRing(xla::XfeedRing* ring) {
+  CHECK(ring != nullptr)
+      << "code compiled with xla_cpu_xfeed_ring_slots ran before the host "
+         "xfeed rings were configured";
+  return ring;
+}
+
+}  // namespace
+
+void* __xla_cpu_runtime_AcquireInfeedRingSlot(int32 buffer_length,
+                                              const void* shape,
+                                              int32 shape_length) {
+  int64 length;
+  void* slot = GetRing(xla::XfeedRing::HostInfeed())->BeginRead(&length);
+  // The infeed's result is read straight out of the slot, so it must hold
+  // exactly the bytes the program expects.
+  CHECK_EQ(length, buffer_length)
+      << "infeed entry does not match the shape of the infeed instruction";
+  return slot;
+}
+
+void __xla_cpu_runtime_ReleaseInfeedRingSlot(int32 buffer_length,
+                                             void* buffer_ptr,
+                                             const void* shape,
+                                             int32 shape_length) {
+  GetRing(xla::XfeedRing::HostInfeed())->EndRead(buffer_ptr);
+}
+
+void* __xla_cpu_runtime_AcquireOutfeedRingSlot(int32 buffer_length,
+                                               const void* shape,
+                                               int32 shape_length) {
+  xla::XfeedRing* ring = GetRing(xla::XfeedRing::HostOutfeed());
+  CHECK_LE(buffer_length, ring->slot_bytes())
+      << "outfeed entry does not fit in an xfeed ring slot";
+  return ring->BeginWrite();
+}
+
+void __xla_cpu_runtime_ReleaseOutfeedRingSlot(int32 buffer_length,
+                                              void* buffer_ptr,
+                                              const void* shape,
+                                              int32 shape_length) {
+  GetRing(xla::XfeedRing::HostOutfeed())->EndWrite(buffer_length);
+}
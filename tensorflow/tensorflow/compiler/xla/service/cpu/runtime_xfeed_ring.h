@@ -0,0 +1,67 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_XFEED_RING_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_XFEED_RING_H_
+
+#include "tensorflow/core/platform/types.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+extern const char* const kAcquireInfeedRingSlotSymbolName;
+extern const char* const kReleaseInfeedRingSlotSymbolName;
+extern const char* const kAcquireOutfeedRingSlotSymbolName;
+extern const char* const kReleaseOutfeedRingSlotSymbolName;
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+/**
+ * Ring-backed counterparts of the infeed and outfeed buffer functions in
+ * cpu_runtime.h, with the same signatures, used when the module was compiled
+ * with the xla_cpu_xfeed_ring_slots debug option.  They operate on the host
+ * rings of xla::XfeedRing, which must have been configured.
+ *
+ * The acquired slot is used in place: an infeed slot may be read until it is
+ * released, and releasing an outfeed slot publishes the 'buffer_length' bytes
+ * written to it.  Waits for an entry or a free slot block the calling thread.
+ * Concurrent executions may share the rings; see xla::XfeedRing.
+ */
+extern "C" {
+
+extern void* __xla_cpu_runtime_AcquireInfeedRingSlot(
+    tensorflow::int32 buffer_length, const void* shape,
+    tensorflow::int32 shape_length);
+
+extern void __xla_cpu_runtime_ReleaseInfeedRingSlot(
+    tensorflow::int32 buffer_length, void* buffer_ptr, const void* shape,
+    tensorflow::int32 shape_length);
+
+extern void* __xla_cpu_runtime_AcquireOutfeedRingSlot(
+    tensorflow::int32 buffer_length, const void* shape,
+    tensorflow::int32 shape_length);
+
+extern void __xla_cpu_runtime_ReleaseOutfeedRingSlot(
+    tensorflow::int32 buffer_length, void* buffer_ptr, const void* shape,
+    tensorflow::int32 shape_length);
+
+}  // extern "C"
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_XFEED_RING_H_
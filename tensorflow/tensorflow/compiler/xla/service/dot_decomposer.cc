@@ -142,7 +142,7 @@ Status DecomposeBatchDot(HloInstruction* dot) {
  * 1. For All non-fusion computations in hlo module
  *   1. For all the instructions in the computation
  *     1. Ignore all `HloOpcode::kDot` instructions
- *     2. Store it into `batch_dots` if `xla::DotDecomposer::decompose_batch_dot_` is set
+ *     2. Store it into `batch_dots` if `xla::DotDecomposer::decompose_batch_dot_` is set and `xla::DotDecomposer::filter_` (if any) accepts it
  * 2. `xla::anonymous_namespace{dot_decomposer.cc}::DecomposeBatchDot` to decompose
  */
 StatusOr<bool> DotDecomposer::Run(HloModule* module) {
@@ -155,7 +155,8 @@ StatusOr<bool> DotDecomposer::Run(HloModule* module) {
         continue;
       }
       const DotDimensionNumbers& dnums = instruction->dot_dimension_numbers();
-      if (dnums.lhs_batch_dimensions_size() > 0 && decompose_batch_dot_) {
+      if (dnums.lhs_batch_dimensions_size() > 0 && decompose_batch_dot_ &&
+          (filter_ == nullptr || filter_(*instruction))) {
         batch_dots.push_back(instruction);
       }
     }
@@ -13,6 +13,8 @@ limitations under the License.
 ==============================================================================*/
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_DOT_DECOMPOSER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_DOT_DECOMPOSER_H_
+#include <functional>
+#include <utility>
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 namespace xla {
@@ -23,9 +25,15 @@ namespace xla {
  */
 class DotDecomposer : public HloPassInterface {
  public:
-  // Decomposes batch Dot operations when 'decompose_batch_dot' is true.
-  DotDecomposer(bool decompose_batch_dot = true)
-      : decompose_batch_dot_(decompose_batch_dot) {}
+  // Returns true if the given batch Dot should be decomposed.
+  using BatchDotFilter = std::function<bool(const HloInstruction&)>;
+  // Decomposes batch Dot operations when 'decompose_batch_dot' is true.  If
+  // 'filter' is set, only batch Dots for which it returns true are decomposed,
+  // which lets backends keep the ones they can lower natively.
+  DotDecomposer(bool decompose_batch_dot = true,
+                BatchDotFilter filter = nullptr)
+      : decompose_batch_dot_(decompose_batch_dot),
+        filter_(std::move(filter)) {}
   ~DotDecomposer() = default;
   /**
    * Return internal name "dot_decomposer"
@@ -43,6 +51,11 @@ class DotDecomposer : public HloPassInterface {
 	 * Indicate this instruction should be processed by `xla::DotDecomposer`
 	 */
   bool decompose_batch_dot_;
+	/**
+	 * Optional predicate selecting which batch Dots to decompose; all of them
+	 * when empty.
+	 */
+  BatchDotFilter filter_;
 };
 }  // namespace xla
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_DOT_DECOMPOSER_H_
@@ -0,0 +1,103 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/compiler/xla/service/hlo_computation_pass.h"
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+namespace xla {
+/**
+ * 1. Collect the computations to visit in post order.
+ * 2. Without a thread pool, visit them one at a time.
+ * 3. Otherwise give each computation a depth one greater than its deepest
+ *    callee, and visit the computations of each depth as one parallel wave.
+ * 4. Call `RunOnModule`.
+ */
+StatusOr<bool> HloComputationPass::Run(HloModule* module) {
+  XLA_VLOG_LINES(2, tensorflow::strings::StrCat(name(), "::Run(), before:\n",
+                                                module->ToString()));
+  const std::list<HloComputation*> post_order =
+      module->MakeComputationPostOrder();
+  bool changed = false;
+  if (thread_pool_ == nullptr) {
+    for (HloComputation* computation : post_order) {
+      if (computation->IsFusionComputation() && !VisitsFusionComputations()) {
+        continue;
+      }
+      TF_ASSIGN_OR_RETURN(bool changed_computation,
+                          RunOnComputation(computation));
+      changed |= changed_computation;
+    }
+  } else {
+    // Callees precede their callers in the post order, so one forward sweep
+    // computes every depth.
+    std::unordered_map<const HloComputation*, int64> depths;
+    std::vector<std::vector<HloComputation*>> waves;
+    for (HloComputation* computation : post_order) {
+      int64 depth = 0;
+      for (const HloInstruction* instruction : computation->instructions()) {
+        for (const HloComputation* callee :
+             instruction->called_computations()) {
+          depth = std::max(depth, depths.at(callee) + 1);
+        }
+      }
+      depths[computation] = depth;
+      if (computation->IsFusionComputation() && !VisitsFusionComputations()) {
+        continue;
+      }
+      if (static_cast<int64>(waves.size()) <= depth) {
+        waves.resize(depth + 1);
+      }
+      waves[depth].push_back(computation);
+    }
+    for (const std::vector<HloComputation*>& wave : waves) {
+      TF_ASSIGN_OR_RETURN(bool changed_wave, RunOnComputationsInParallel(wave));
+      changed |= changed_wave;
+    }
+  }
+  TF_ASSIGN_OR_RETURN(bool changed_module, RunOnModule(module));
+  changed |= changed_module;
+  XLA_VLOG_LINES(2, tensorflow::strings::StrCat(name(), "::Run(), after:\n",
+                                                module->ToString()));
+  return changed;
+}
+StatusOr<bool> HloComputationPass::RunOnComputationsInParallel(
+    const std::vector<HloComputation*>& computations) {
+  std::vector<StatusOr<bool>> results(computations.size());
+  if (computations.size() == 1) {
+    results[0] = RunOnComputation(computations[0]);
+  } else if (!computations.empty()) {
+    tensorflow::BlockingCounter counter(computations.size());
+    for (size_t i = 0; i < computations.size(); ++i) {
+      thread_pool_->Schedule([this, &computations, &results, &counter, i]() {
+        results[i] = RunOnComputation(computations[i]);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  // Merge in post order so that the outcome does not depend on which thread
+  // finished first.
+  bool changed = false;
+  for (StatusOr<bool>& result : results) {
+    TF_RETURN_IF_ERROR(result.status());
+    changed |= result.ValueOrDie();
+  }
+  return changed;
+}
+}  // namespace xla
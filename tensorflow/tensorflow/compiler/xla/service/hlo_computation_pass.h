@@ -0,0 +1,74 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_COMPUTATION_PASS_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_COMPUTATION_PASS_H_
+#include <vector>
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+namespace xla {
+/**
+ * Superclass of computation-local HLO passes, i.e. passes which transform
+ * each computation of a module independently of the others.
+ *
+ * While running on one computation, `RunOnComputation` may:
+ *   - read and mutate that computation, and the fusion computations of its
+ *     fusion instructions;
+ *   - read computations it calls (e.g. a reduce's `to_apply`), without
+ *     mutating them;
+ *   - add instructions, and add new embedded computations to the module.
+ *
+ * It must not touch any other computation, remove computations from the
+ * module, or keep state in the pass object that outlives the call.  Work that
+ * needs the whole module belongs in `RunOnModule`.
+ *
+ * With that contract the computations can be visited concurrently.  If a
+ * thread pool is set (`xla::HloPassPipeline` does this when the
+ * `xla_hlo_pass_threads` debug option is greater than 1), `Run` visits the
+ * computations in waves: each wave contains the computations whose callees
+ * have all been visited, so every computation still sees its callees in their
+ * final state, exactly as in the sequential post-order walk.  Per-computation
+ * results are merged in post order, so the returned `changed` flag and the
+ * first reported error do not depend on scheduling.  Only the names and unique
+ * ids of instructions added during a parallel run may differ between runs
+ * (see `HloModule::UniquifyInstruction`).
+ */
+class HloComputationPass : public HloPassInterface {
+ public:
+  ~HloComputationPass() override = default;
+  // Runs the pass on 'computation', returning whether it was changed.
+  virtual StatusOr<bool> RunOnComputation(HloComputation* computation) = 0;
+  // Whether RunOnComputation also visits fusion computations.
+  virtual bool VisitsFusionComputations() const { return false; }
+  // Runs once every computation has been visited, on the calling thread.
+  // Returns whether the module was changed.
+  virtual StatusOr<bool> RunOnModule(HloModule* module) { return false; }
+  // Visits every computation of 'module' in post order (concurrently if a
+  // thread pool is set), then calls RunOnModule.
+  StatusOr<bool> Run(HloModule* module) override;
+  // Sets the thread pool used by Run, or null to run sequentially.  Not owned.
+  void set_thread_pool(tensorflow::thread::ThreadPool* thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+ private:
+  // Visits 'computations', which do not call each other, concurrently.
+  StatusOr<bool> RunOnComputationsInParallel(
+      const std::vector<HloComputation*>& computations);
+  tensorflow::thread::ThreadPool* thread_pool_ = nullptr;
+};
+}  // namespace xla
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_HLO_COMPUTATION_PASS_H_
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -29,68 +30,184 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_evaluator.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
-#include "tensorflow/compiler/xla/service/hlo_query.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/core/lib/core/errors.h"
 
 namespace xla {
 
-StatusOr<bool> HloConstantFolding::Run(HloModule* module) {
-  // Limit the constant folding to 0 iterations to skip folding loops. This
-  // retains the behavior from before while loop support in HloEvaluator and may
-  // be revised.
-  auto evaluator = MakeUnique<HloEvaluator>(/*max_loop_iterations=*/0);
+namespace {
+
+// Adds an instruction computing 'literal' to 'computation': a constant, or
+// for a tuple a kTuple of the instructions computing its elements.
+HloInstruction* AddConstantOrTuple(HloComputation* computation,
+                                   std::unique_ptr<Literal> literal) {
+  if (!ShapeUtil::IsTuple(literal->shape())) {
+    return computation->AddInstruction(
+        HloInstruction::CreateConstant(std::move(literal)));
+  }
+  std::vector<HloInstruction*> elements;
+  for (Literal& element : literal->DecomposeTuple()) {
+    elements.push_back(AddConstantOrTuple(
+        computation, MakeUnique<Literal>(std::move(element))));
+  }
+  return computation->AddInstruction(HloInstruction::CreateTuple(elements));
+}
+
+// Whether 'instruction' is a constant, or a kTuple whose leaves are all
+// constants, e.g. the loop state of a while built by the frontend or left by
+// an earlier fold.
+bool IsConstantOrConstantTuple(const HloInstruction& instruction) {
+  if (instruction.opcode() == HloOpcode::kConstant) {
+    return true;
+  }
+  if (instruction.opcode() != HloOpcode::kTuple) {
+    return false;
+  }
+  for (const HloInstruction* operand : instruction.operands()) {
+    if (!IsConstantOrConstantTuple(*operand)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the value of 'instruction', for which IsConstantOrConstantTuple
+// holds.
+std::unique_ptr<Literal> ConstantOrTupleLiteral(
+    const HloInstruction& instruction) {
+  if (instruction.opcode() == HloOpcode::kConstant) {
+    return instruction.literal().CloneToUnique();
+  }
+  std::vector<std::unique_ptr<Literal>> elements;
+  for (const HloInstruction* operand : instruction.operands()) {
+    elements.push_back(ConstantOrTupleLiteral(*operand));
+  }
+  return Literal::MakeTupleOwned(std::move(elements));
+}
+
+}  // namespace
+
+constexpr int64 HloConstantFolding::kDefaultMaxLoopIterations;
+constexpr int64 HloConstantFolding::kDefaultMaxTupleFoldedBytes;
+
+int64 HloConstantFolding::MaxFoldedBytes(
+    const HloInstruction& instruction) const {
+  if (max_folded_bytes_ >= 0) {
+    return max_folded_bytes_;
+  }
+  const int64 configured = instruction.GetModule()
+                               ->config()
+                               .debug_options()
+                               .xla_constant_folding_max_bytes();
+  if (configured > 0) {
+    return configured;
+  }
+  return ShapeUtil::IsTuple(instruction.shape()) ? kDefaultMaxTupleFoldedBytes
+                                                 : -1;
+}
+
+bool HloConstantFolding::WithinFoldedBytesBudget(
+    const HloInstruction& instruction) const {
+  const int64 max_folded_bytes = MaxFoldedBytes(instruction);
+  if (max_folded_bytes < 0) {
+    return true;
+  }
+  // Count the elements of a tuple in full rather than as pointers, since each
+  // becomes a constant of its own.
+  int64 bytes = 0;
+  ShapeUtil::ForEachSubshape(
+      instruction.shape(),
+      [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        if (!ShapeUtil::IsTuple(subshape)) {
+          bytes += ShapeUtil::ByteSizeOf(subshape, sizeof(void*));
+        }
+      });
+  return bytes <= max_folded_bytes;
+}
+
+StatusOr<bool> HloConstantFolding::RunOnComputation(
+    HloComputation* computation) {
+  // The evaluator fails loops which run for more than max_loop_iterations_
+  // iterations, in which case the loop is left alone.
+  auto evaluator = MakeUnique<HloEvaluator>(max_loop_iterations_);
 
-  XLA_VLOG_LINES(2,
-                 "HloConstantFolding::Run(), before:\n" + module->ToString());
   bool changed = false;
+  for (auto instruction : computation->MakeInstructionPostOrder()) {
+    // Skip dead code.
+    if (instruction->user_count() == 0 &&
+        computation->root_instruction() != instruction) {
+      continue;
+    }
+    // Skip Constant, Parameter and Tuple operation.  A kTuple of constants
+    // is already what a tuple-shaped result is folded into.
+    if (instruction->opcode() == HloOpcode::kParameter ||
+        instruction->opcode() == HloOpcode::kConstant ||
+        instruction->opcode() == HloOpcode::kTuple) {
+      continue;
+    }
+    // Folding would drop the side effects of the instruction or of the
+    // computations it calls (e.g. an infeed in a while body).
+    if (instruction->HasSideEffect()) {
+      continue;
+    }
+    // Skip instructions with non-constant operands.
+    bool operands_constant = true;
+    for (const HloInstruction* operand : instruction->operands()) {
+      operands_constant &= IsConstantOrConstantTuple(*operand);
+    }
+    if (!operands_constant) {
+      continue;
+    }
 
-  for (auto* computation : module->MakeNonfusionComputations()) {
-    for (auto instruction : computation->MakeInstructionPostOrder()) {
-      // Skip dead code.
-      if (instruction->user_count() == 0 &&
-          computation->root_instruction() != instruction) {
-        continue;
-      }
-      // Skip Constant, Parameter, Reduce operation.
-      // TODO(b/35975797): Enable Reduce operation once arbitrary computation
-      // are supported by the evaluator.
-      // TODO(b/64407269): Enable Tuple once the timeout issue is resolved.
-      if (instruction->opcode() == HloOpcode::kParameter ||
-          instruction->opcode() == HloOpcode::kConstant ||
-          instruction->opcode() == HloOpcode::kTuple ||
-          instruction->opcode() == HloOpcode::kReduce) {
-        continue;
-      }
-      // Skip instructions with non-constant operands.
-      if (!hlo_query::AllOperandsAreConstants(*instruction)) {
-        continue;
-      }
+    // Broadcasts dramatically increase the size of constants, which is often
+    // detrimental to performance and memory capacity, so do not fold
+    // broadcasts.
+    if (instruction->opcode() == HloOpcode::kBroadcast ||
+        instruction->opcode() == HloOpcode::kBroadcastDimOne) {
+      continue;
+    }
 
-      // Broadcasts dramatically increase the size of constants, which is often
-      // detrimental to performance and memory capacity, so do not fold
-      // broadcasts.
-      if (instruction->opcode() == HloOpcode::kBroadcast ||
-          instruction->opcode() == HloOpcode::kBroadcastDimOne) {
-        continue;
-      }
+    if (!WithinFoldedBytesBudget(*instruction)) {
+      VLOG(2) << "Not folding instruction whose result exceeds "
+              << MaxFoldedBytes(*instruction)
+              << " bytes: " << instruction->ToString();
+      continue;
+    }
 
-      std::unique_ptr<Literal> result = evaluator->TryEvaluate(instruction);
-      // Currently we skip unimplemented operations.
-      // TODO(b/35975797): Fold constant computations for more operations.
-      if (result == nullptr) {
-        VLOG(2) << "Constant folding failed for instruction: "
-                << instruction->ToString();
-        continue;
+    // The evaluator only takes constant operands, so kTuple operands are
+    // substituted by the tuple literal of their leaves.
+    std::vector<std::unique_ptr<Literal>> tuple_literals;
+    std::unordered_map<const HloInstruction*, const Literal*> substitutions;
+    for (const HloInstruction* operand : instruction->operands()) {
+      if (operand->opcode() == HloOpcode::kTuple &&
+          substitutions.count(operand) == 0) {
+        tuple_literals.push_back(ConstantOrTupleLiteral(*operand));
+        substitutions[operand] = tuple_literals.back().get();
+      }
+    }
+    std::unique_ptr<Literal> result;
+    if (substitutions.empty()) {
+      result = evaluator->TryEvaluate(instruction);
+    } else {
+      StatusOr<std::unique_ptr<Literal>> evaluated =
+          evaluator->EvaluateWithSubstitutions(instruction, substitutions);
+      if (evaluated.ok()) {
+        result = std::move(evaluated.ValueOrDie());
       }
-
-      TF_RETURN_IF_ERROR(computation->ReplaceWithNewInstruction(
-          instruction, HloInstruction::CreateConstant(std::move(result))));
-      changed = true;
     }
+    // Currently we skip unimplemented operations.
+    // TODO(b/35975797): Fold constant computations for more operations.
+    if (result == nullptr) {
+      VLOG(2) << "Constant folding failed for instruction: "
+              << instruction->ToString();
+      continue;
+    }
+
+    TF_RETURN_IF_ERROR(computation->ReplaceInstruction(
+        instruction, AddConstantOrTuple(computation, std::move(result))));
+    changed = true;
   }
-  XLA_VLOG_LINES(2, "HloConstantFolding::Run(), after:\n" + module->ToString());
   return changed;
 }
 
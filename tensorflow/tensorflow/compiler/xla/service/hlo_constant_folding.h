@@ -19,24 +19,59 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_CONSTANT_FOLDING_H_
 
 #include "tensorflow/compiler/xla/service/hlo_module.h"
-#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/service/hlo_computation_pass.h"
 
 namespace xla {
 /**
  * Google docs:
  * > A pass which performs constant folding in order to avoid unnecessary
  * > computation on constants.
+ *
+ * Reduces (with any reducer computation) and while loops are folded too,
+ * within a budget: a while loop is only folded if it finishes within
+ * `max_loop_iterations` iterations, and a result is only folded if it fits in
+ * the byte budget (see `MaxFoldedBytes`).  Backends do not emit tuple-shaped
+ * constants, so a tuple-shaped result is folded into a kTuple of array
+ * constants, and kTuple itself is left alone.  A kTuple whose leaves are all
+ * constants counts as a constant operand, so a while loop over a constant
+ * initial state, and the get-tuple-elements of a folded tuple, fold too.
+ * Broadcasts are never folded.
  */
-class HloConstantFolding : public HloPassInterface {
+class HloConstantFolding : public HloComputationPass {
  public:
+  static constexpr int64 kDefaultMaxLoopIterations = 1000;
+  static constexpr int64 kDefaultMaxTupleFoldedBytes = 16 * 1024 * 1024;
+
+  // A negative max_loop_iterations means unbounded.  A nonnegative
+  // max_folded_bytes overrides the byte budget of every fold.
+  explicit HloConstantFolding(
+      int64 max_loop_iterations = kDefaultMaxLoopIterations,
+      int64 max_folded_bytes = -1)
+      : max_loop_iterations_(max_loop_iterations),
+        max_folded_bytes_(max_folded_bytes) {}
+
   /**
    * Return internal name "constant_folding"
    */
   tensorflow::StringPiece name() const override { return "constant_folding"; }
 
-  // Run constant folding operations on the given module. Returns whether the
-  // module was changed (constant expressions folded).
-  StatusOr<bool> Run(HloModule* module) override;
+  // Run constant folding operations on the given computation. Returns whether
+  // the computation was changed (constant expressions folded).
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
+
+ private:
+  // Returns the largest result of 'instruction', in bytes, that may be
+  // folded, or -1 for no limit: max_folded_bytes if given, otherwise the
+  // module's xla_constant_folding_max_bytes debug option if positive,
+  // otherwise kDefaultMaxTupleFoldedBytes for tuple-shaped results, which
+  // become one constant per element, and no limit for the others.
+  int64 MaxFoldedBytes(const HloInstruction& instruction) const;
+
+  // Whether the result of 'instruction' fits in the folding budget.
+  bool WithinFoldedBytesBudget(const HloInstruction& instruction) const;
+
+  const int64 max_loop_iterations_;
+  const int64 max_folded_bytes_;
 };
 
 }  // namespace xla
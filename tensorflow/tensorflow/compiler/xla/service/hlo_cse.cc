@@ -17,13 +17,10 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_cse.h"
 
+#include <functional>
 #include <list>
-#include <map>
 #include <memory>
-#include <set>
-#include <string>
-#include <utility>
-#include <vector>
+#include <unordered_set>
 
 #include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/literal_util.h"
@@ -34,114 +31,151 @@ limitations under the License.
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
 #include "tensorflow/core/lib/core/errors.h"
-#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/hash/hash.h"
 
 namespace xla {
 
 namespace {
 
-// Find and combine identical constants. Constants are identical if they have
-// the same type and value.
-bool CombineConstants(HloComputation* computation, bool is_layout_sensitive) {
-  bool changed = false;
-
-  // Map from ShortDebugString of the layoutless shape of the constant to the
-  // set of constant instructions with that shape. Layoutless shape is used to
-  // bin possible common constants together to reduce number of constant
-  // comparisons. If we end up having too many constant comparisons, a more
-  // precise binning might have to be used.
-  std::multimap<string, HloInstruction*> constants;
-
-  auto inst_it = computation->instructions().begin();
-  while (inst_it != computation->instructions().end()) {
-    HloInstruction* instruction = *inst_it;
-
-    // Advance list iterator before loop body because iterator may be
-    // invalidated due to deletion.
-    ++inst_it;
-
-    if (instruction->opcode() == HloOpcode::kConstant) {
-      Shape shape = instruction->shape();
-      if (!is_layout_sensitive) {
-        LayoutUtil::ClearLayout(&shape);
-      }
-      string shape_string = shape.ShortDebugString();
-
-      // Compare against all constants with the same shape
-      auto range = constants.equal_range(shape_string);
-      HloInstruction* match = nullptr;
-      for (auto it = range.first; it != range.second; ++it) {
-        if (instruction->literal() == it->second->literal()) {
-          match = it->second;
-          break;
+using tensorflow::Hash64;
+using tensorflow::Hash64Combine;
+
+// Hashes the element types and dimensions of 'shape' and, if
+// 'is_layout_sensitive', its layouts. Equal shapes (compatible shapes if not
+// layout sensitive) hash equally.
+uint64 HashShape(const Shape& shape, bool is_layout_sensitive) {
+  uint64 hash = 0;
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        hash = Hash64Combine(hash, subshape.element_type());
+        for (int64 dimension : subshape.dimensions()) {
+          hash = Hash64Combine(hash, dimension);
         }
-      }
-      if (match == nullptr) {
-        constants.emplace(shape_string, instruction);
-      } else {
-        // Match found, replace this instruction with the one in the multimap.
-        TF_CHECK_OK(instruction->ReplaceAllUsesWith(match));
-        TF_CHECK_OK(computation->RemoveInstruction(instruction));
-        changed = true;
-      }
-    }
+        if (is_layout_sensitive && subshape.has_layout()) {
+          for (int64 minor : subshape.layout().minor_to_major()) {
+            hash = Hash64Combine(hash, minor);
+          }
+        }
+      });
+  return hash;
+}
+
+// Hashes the contents of 'literal'. Literals which compare equal hash equally
+// regardless of their layouts, except that 0.0 and -0.0 (which compare equal)
+// may hash differently; such constants are then simply not commoned.
+uint64 HashLiteral(const Literal& literal) {
+  uint64 hash = HashShape(literal.shape(), /*is_layout_sensitive=*/false);
+  bool has_sparse_array = false;
+  ShapeUtil::ForEachSubshape(
+      literal.shape(), [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        has_sparse_array |= LayoutUtil::IsSparseArray(subshape);
+      });
+  if (has_sparse_array) {
+    return hash;
   }
 
-  return changed;
+  // Hash the elements in the default (major-to-minor) order so that the hash
+  // does not depend on the layout.
+  Shape default_shape = literal.shape();
+  LayoutUtil::SetToDefaultLayout(&default_shape);
+  std::unique_ptr<Literal> relaid;
+  const Literal* canonical = &literal;
+  if (!ShapeUtil::Equal(default_shape, literal.shape())) {
+    relaid = literal.Relayout(default_shape);
+    canonical = relaid.get();
+  }
+  ShapeUtil::ForEachSubshape(
+      canonical->shape(), [&](const Shape& subshape, const ShapeIndex& index) {
+        if (ShapeUtil::IsTuple(subshape)) {
+          return;
+        }
+        const char* data =
+            static_cast<const char*>(canonical->untyped_data(index));
+        hash = Hash64Combine(hash, Hash64(data, canonical->size_bytes(index)));
+      });
+  return hash;
 }
 
+// A structural hash of 'instruction': its opcode, shape, the ids of its
+// operands (which are already commoned when the instruction is visited), and
+// the attributes cheap enough to hash. Identical instructions hash equally;
+// anything the hash leaves out is resolved by HloInstruction::Identical on
+// collision.
+uint64 HashInstruction(const HloInstruction& instruction,
+                       bool is_layout_sensitive) {
+  uint64 hash = Hash64Combine(static_cast<uint64>(instruction.opcode()),
+                              HashShape(instruction.shape(),
+                                        is_layout_sensitive));
+  for (const HloInstruction* operand : instruction.operands()) {
+    hash = Hash64Combine(hash, operand->unique_id());
+  }
+  switch (instruction.opcode()) {
+    case HloOpcode::kConstant:
+      hash = Hash64Combine(hash, HashLiteral(instruction.literal()));
+      break;
+    case HloOpcode::kGetTupleElement:
+      hash = Hash64Combine(hash, instruction.tuple_index());
+      break;
+    default:
+      break;
+  }
+  return hash;
+}
+
+// An instruction together with its hash, which is computed once when the
+// instruction is visited.
+struct CseKey {
+  HloInstruction* instruction;
+  uint64 hash;
+};
+
 }  // namespace
 
-StatusOr<bool> HloCSE::Run(HloModule* module) {
+StatusOr<bool> HloCSE::RunOnComputation(HloComputation* computation) {
   bool changed = false;
   const std::function<bool(const HloInstruction*, const HloInstruction*)>
       eq_instructions = std::equal_to<const HloInstruction*>();
   const std::function<bool(const HloComputation*, const HloComputation*)>
       eq_computations = std::equal_to<const HloComputation*>();
-  for (auto* computation : module->computations()) {
-    changed |= CombineConstants(computation, is_layout_sensitive_);
-
-    std::list<HloInstruction*> post_order =
-        computation->MakeInstructionPostOrder();
-    std::set<HloInstruction*> removed_instructions;
-    for (auto instruction : post_order) {
-      // If the instruction has already been removed by CSE skip over it.
-      if (removed_instructions.count(instruction) > 0 ||
-          instruction->operand_count() == 0) {
-        continue;
-      }
-
-      // Skip instructions which have side effects.
-      if (instruction->HasSideEffect()) {
-        continue;
-      }
-
-      // An instruction is considered to be equivalent to another only if they
-      // share the exact same set of operands. So to find equivalent
-      // instructions, we just search among instructions which share operand(0)
-      // of this instruction.
-      const HloInstruction* operand = instruction->operand(0);
-
-      tensorflow::gtl::InlinedVector<HloInstruction*, 8>
-          equivalent_instructions;
-      for (HloInstruction* user : operand->users()) {
-        if (user != instruction && !user->HasSideEffect() &&
-            user->Identical(*instruction, eq_instructions, eq_computations,
-                            is_layout_sensitive_)) {
-          equivalent_instructions.push_back(user);
-        }
-      }
-
-      // Replace all equivalent instructions with this instruction.
-      for (HloInstruction* equivalent_instruction : equivalent_instructions) {
-        TF_RETURN_IF_ERROR(
-            equivalent_instruction->ReplaceAllUsesWith(instruction));
-        TF_RETURN_IF_ERROR(
-            computation->RemoveInstruction(equivalent_instruction));
-        removed_instructions.insert(equivalent_instruction);
-        changed = true;
-      }
+
+  // The representative of each class of identical instructions seen so far.
+  // Since operands are visited before their users, and an instruction's uses
+  // are redirected to its representative as soon as one is found, identical
+  // instructions have identical operand pointers by the time they are looked
+  // up here. HloInstruction::Identical only runs on hash collisions.
+  auto hash = [](const CseKey& key) { return static_cast<size_t>(key.hash); };
+  auto equal = [&](const CseKey& lhs, const CseKey& rhs) {
+    return lhs.hash == rhs.hash &&
+           lhs.instruction->Identical(*rhs.instruction, eq_instructions,
+                                      eq_computations, is_layout_sensitive_);
+  };
+  std::unordered_set<CseKey, decltype(hash), decltype(equal)> representatives(
+      computation->instruction_count(), hash, equal);
+
+  const std::list<HloInstruction*> post_order =
+      computation->MakeInstructionPostOrder();
+  for (HloInstruction* instruction : post_order) {
+    // Constants are the only leaves worth commoning. Instructions with side
+    // effects are never commoned.
+    if ((instruction->operand_count() == 0 &&
+         instruction->opcode() != HloOpcode::kConstant) ||
+        instruction->HasSideEffect()) {
+      continue;
+    }
+
+    const CseKey key{instruction,
+                     HashInstruction(*instruction, is_layout_sensitive_)};
+    auto insert_result = representatives.insert(key);
+    if (insert_result.second) {
+      continue;
     }
+
+    // Only the instruction being visited is removed, so 'post_order' never
+    // yields a removed instruction.
+    HloInstruction* representative = insert_result.first->instruction;
+    TF_RETURN_IF_ERROR(instruction->ReplaceAllUsesWith(representative));
+    TF_RETURN_IF_ERROR(computation->RemoveInstruction(instruction));
+    changed = true;
   }
   return changed;
 }
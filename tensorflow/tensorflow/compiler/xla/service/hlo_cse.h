@@ -19,7 +19,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_CSE_H_
 
 #include "tensorflow/compiler/xla/service/hlo_module.h"
-#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/service/hlo_computation_pass.h"
 
 namespace xla {
 /**
@@ -28,8 +28,14 @@ namespace xla {
  * > and identical instructions with the same operands are commoned. The pass
  * > iterates over the instructions in topological order which enables the pass to
  * > find arbitrarily large common expressions.
+ *
+ * Instructions are value-numbered: each one is hashed on its opcode, shape,
+ * operands and (for constants) literal contents, and compared with
+ * `xla::HloInstruction::Identical` only when its hash matches an instruction
+ * seen earlier.  The pass is therefore linear in the size of the computation
+ * plus the size of its constants, rather than quadratic in operand fan-out.
  */
-class HloCSE : public HloPassInterface {
+class HloCSE : public HloComputationPass {
  public:
   // If is_layout_sensitive is true, then the simplifier preserves layout during
   // transformation. Otherwise, layout is ignored.
@@ -41,9 +47,12 @@ class HloCSE : public HloPassInterface {
    */
   tensorflow::StringPiece name() const override { return "cse"; }
 
-  // Run CSE on the given module. Returns whether the module was changed (common
-  // subexpressions were found and eliminated).
-  StatusOr<bool> Run(HloModule* module) override;
+  // Run CSE on the given computation. Returns whether the computation was
+  // changed (common subexpressions were found and eliminated).
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
+
+  // Fused computations are CSE'd as well.
+  bool VisitsFusionComputations() const override { return true; }
 
  private:
   bool is_layout_sensitive_;
@@ -37,49 +37,49 @@ limitations under the License.
 namespace xla {
 
 /**
- * \brief Entry of `xla::HloDCE` pass
+ * \brief Per-computation half of `xla::HloDCE`
  *
- * For sequence of computation in hlo module in post order
- *   1. Mark all the removable instruction in the computation
- *   2. Remove the marked dead root and its sibling operand.
- *   3. Collect live computation(computation that is called by instruction)
- *   4. Remove dead computation(which is not live computation)
+ * 1. Mark all the removable instruction in the computation
+ * 2. Remove the marked dead root and its sibling operand.
+ *
+ * `xla::HloDCE::RunOnModule` then
+ * 3. Collect live computation(computation that is called by instruction)
+ * 4. Remove dead computation(which is not live computation)
  */
-StatusOr<bool> HloDCE::Run(HloModule* module) {
+StatusOr<bool> HloDCE::RunOnComputation(HloComputation* computation) {
   bool changed = false;
-
-  VLOG(2) << "Before dce:";
-  XLA_VLOG_LINES(2, module->ToString());
-
-  for (auto* computation : module->MakeComputationPostOrder()) {
-    std::unordered_set<HloInstruction*> live_instructions;
-    TF_RETURN_IF_ERROR(computation->root_instruction()->Accept(
-        [&live_instructions](HloInstruction* instruction) {
-          live_instructions.insert(instruction);
-          return Status::OK();
-        }));
-
-    // Remove any dead roots and their dead transitive operands. Collect them
-    // into a separate list first to avoid problems with iterating through the
-    // computation's instruction while simultaneously removing instructions.
-    std::vector<HloInstruction*> dead_roots;
-    for (auto* instruction : computation->instructions()) {
-      if (instruction->user_count() == 0 &&
-          live_instructions.count(instruction) == 0 &&
-          computation->IsRemovable(instruction) &&
-          !instruction->HasSideEffect()) {
-        dead_roots.push_back(instruction);
-      }
+  std::unordered_set<HloInstruction*> live_instructions;
+  TF_RETURN_IF_ERROR(computation->root_instruction()->Accept(
+      [&live_instructions](HloInstruction* instruction) {
+        live_instructions.insert(instruction);
+        return Status::OK();
+      }));
+
+  // Remove any dead roots and their dead transitive operands. Collect them
+  // into a separate list first to avoid problems with iterating through the
+  // computation's instruction while simultaneously removing instructions.
+  std::vector<HloInstruction*> dead_roots;
+  for (auto* instruction : computation->instructions()) {
+    if (instruction->user_count() == 0 &&
+        live_instructions.count(instruction) == 0 &&
+        computation->IsRemovable(instruction) &&
+        !instruction->HasSideEffect()) {
+      dead_roots.push_back(instruction);
     }
+  }
 
-    for (HloInstruction* dead_root : dead_roots) {
-      VLOG(1) << "Removing dead root " << dead_root->ToString()
-              << " and it's unused operands";
-      TF_RETURN_IF_ERROR(
-          computation->RemoveInstructionAndUnusedOperands(dead_root));
-      changed = true;
-    }
+  for (HloInstruction* dead_root : dead_roots) {
+    VLOG(1) << "Removing dead root " << dead_root->ToString()
+            << " and it's unused operands";
+    TF_RETURN_IF_ERROR(
+        computation->RemoveInstructionAndUnusedOperands(dead_root));
+    changed = true;
   }
+  return changed;
+}
+
+StatusOr<bool> HloDCE::RunOnModule(HloModule* module) {
+  bool changed = false;
 
   // Now DCE HloComputations.  First, collect the computations that are
   // referenced by some remaining instruction.
@@ -104,9 +104,6 @@ StatusOr<bool> HloDCE::Run(HloModule* module) {
     }
   }
 
-  VLOG(2) << "After dce:";
-  XLA_VLOG_LINES(2, module->ToString());
-
   return changed;
 }
 
@@ -19,9 +19,9 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_DCE_H_
 
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_computation_pass.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
-#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 #include "tensorflow/compiler/xla/statusor.h"
 
 namespace xla {
@@ -36,7 +36,7 @@ namespace xla {
  * > This pass does not remove dead parameter instructions, as parameter
  * > instructions cannot be deleted.
 */
-class HloDCE : public HloPassInterface {
+class HloDCE : public HloComputationPass {
  public:
   ~HloDCE() override {}
   /**
@@ -44,9 +44,15 @@ class HloDCE : public HloPassInterface {
    */
   tensorflow::StringPiece name() const override { return "dce"; }
 
-  // Run the pass on the given module. Returns whether the module was changed
-  // (instructions were removed).
-  StatusOr<bool> Run(HloModule* module) override;
+  // Removes dead instructions from the given computation. Returns whether the
+  // computation was changed (instructions were removed).
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
+
+  // Removes the computations no longer reachable from the entry computation.
+  // Returns whether the module was changed (computations were removed).
+  StatusOr<bool> RunOnModule(HloModule* module) override;
+
+  bool VisitsFusionComputations() const override { return true; }
 };
 
 }  // namespace xla
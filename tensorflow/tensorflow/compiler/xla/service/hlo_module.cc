@@ -54,6 +54,7 @@ HloModule::HloModule(const string& name, const HloModuleConfig& config)
 HloComputation* HloModule::AddComputationInternal(
     std::unique_ptr<HloComputation> computation, bool is_entry,
     bool uniquify_names) {
+  tensorflow::mutex_lock lock(uniquing_mutex_);
   if (is_entry) {
     CHECK_EQ(nullptr, entry_computation_);
     entry_computation_ = computation.get();
@@ -83,7 +84,7 @@ HloComputation* HloModule::AddComputationInternal(
 
   // Pick unique IDs for each instruction.
   for (auto* instruction : computation->instructions()) {
-    instruction->SetUniqueId(NewUniqueInstructionId());
+    instruction->SetUniqueId(next_unique_id_++);
   }
   // Set unique id to this computation.
   CHECK_NE(computation->root_instruction()->unique_id(), -1)
@@ -95,6 +96,12 @@ HloComputation* HloModule::AddComputationInternal(
   return computations_.back().get();
 }
 
+void HloModule::UniquifyInstruction(HloInstruction* instruction) {
+  tensorflow::mutex_lock lock(uniquing_mutex_);
+  instruction->UniquifyName(&instruction_name_uniquer_);
+  instruction->SetUniqueId(next_unique_id_++);
+}
+
 HloComputation* HloModule::AddEntryComputation(
     std::unique_ptr<HloComputation> computation) {
   return AddComputationInternal(std::move(computation), /*is_entry=*/true,
@@ -186,15 +186,23 @@ class HloModule {
   uint64 RandomNew64() const;
 
   // Returns the NameUniquer for uniquing instruction names in this module.
+  // Not thread-safe; see UniquifyInstruction.
   NameUniquer& instruction_name_uniquer() { return instruction_name_uniquer_; }
 
   // Assign a new unique dense id for an instruction
   int NewUniqueInstructionId() {
-    int result = next_unique_id_;
-    next_unique_id_++;
-    return result;
+    tensorflow::mutex_lock lock(uniquing_mutex_);
+    return next_unique_id_++;
   }
 
+  // Gives 'instruction' a name that is unique within this module and a new
+  // unique id. Unlike using instruction_name_uniquer() and
+  // NewUniqueInstructionId() separately this is thread-safe, so that
+  // computation-local passes (see HloComputationPass) may add instructions to
+  // different computations of the module concurrently. The names and ids
+  // handed out then depend on the order in which the threads get here.
+  void UniquifyInstruction(HloInstruction* instruction);
+
   // Returns the number of unique intruction ids given out.  All ids up to
   // this point are guaranteed to be in the range [0..NumUniqueInstructionIds())
   int NumUniqueInstructionIds() const { return next_unique_id_; }
@@ -230,6 +238,10 @@ class HloModule {
   NameUniquer instruction_name_uniquer_{/*separator=*/"."};
   int next_unique_id_ = 0;
 
+  // Guards the uniquers and next_unique_id_ (and computations_ while
+  // computations are added) against concurrent computation-local passes.
+  tensorflow::mutex uniquing_mutex_;
+
   // Used to keep track of the next unique module id that should be assigned.
   static std::atomic<int> next_unique_module_id_;
   // A unique id to label modules with.
@@ -14,14 +14,20 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_PASS_FIX_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_PASS_FIX_H_
 #include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_metrics.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/macros.h"
 namespace xla {
 /**
  * Google docs:
  * > Do an HLO pass to a fix point.
+ *
+ * When pass metrics are being recorded, each iteration is recorded as a nested
+ * `xla::HloPassMetricsScope`, and the iteration count is set on the enclosing
+ * one.
  */
 template <typename Pass>
 class HloPassFix : public Pass {
@@ -31,9 +37,17 @@ class HloPassFix : public Pass {
   StatusOr<bool> Run(HloModule* module) override {
     bool changed = false;
     bool changed_this_iteration = true;
+    int64 iterations = 0;
     while (changed_this_iteration) {
+      HloPassMetricsScope iteration_metrics(
+          tensorflow::strings::StrCat("iteration ", iterations), *module);
       TF_ASSIGN_OR_RETURN(changed_this_iteration, Pass::Run(module));
+      iteration_metrics.Finish(*module, changed_this_iteration);
       changed |= changed_this_iteration;
+      ++iterations;
+    }
+    if (HloPassMetrics* metrics = HloPassMetricsScope::Current()) {
+      metrics->set_iterations(iterations);
     }
     return changed;
   }
@@ -0,0 +1,93 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/compiler/xla/service/hlo_pass_metrics.h"
+#include "tensorflow/compiler/xla/ptr_util.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/protobuf.h"
+namespace xla {
+namespace {
+// The node of the innermost active HloPassMetricsScope on this thread.
+thread_local HloPassMetrics* current_metrics = nullptr;
+}  // namespace
+HloPassMetricsScope::HloPassMetricsScope(tensorflow::StringPiece name,
+                                         const HloModule& module,
+                                         bool start_report)
+    : enclosing_(current_metrics) {
+  if (enclosing_ != nullptr) {
+    metrics_ = enclosing_->add_passes();
+  } else if (start_report) {
+    root_ = MakeUnique<HloPassMetrics>();
+    metrics_ = root_.get();
+  } else {
+    return;
+  }
+  metrics_->set_name(name.ToString());
+  metrics_->set_computations_before(module.computation_count());
+  metrics_->set_instructions_before(module.instruction_count());
+  current_metrics = metrics_;
+  start_micros_ = tensorflow::Env::Default()->NowMicros();
+}
+HloPassMetricsScope::~HloPassMetricsScope() {
+  if (metrics_ != nullptr) {
+    DCHECK_EQ(current_metrics, metrics_);
+    current_metrics = enclosing_;
+  }
+}
+void HloPassMetricsScope::Finish(const HloModule& module, bool changed) {
+  if (metrics_ == nullptr) {
+    return;
+  }
+  metrics_->set_wall_time_us(tensorflow::Env::Default()->NowMicros() -
+                             start_micros_);
+  metrics_->set_changed(changed);
+  metrics_->set_computations_after(module.computation_count());
+  metrics_->set_instructions_after(module.instruction_count());
+}
+HloPassReport HloPassMetricsScope::MakeReport(const HloModule& module) const {
+  CHECK(is_report_root());
+  HloPassReport report;
+  report.set_module_name(module.name());
+  report.set_module_id(module.unique_id());
+  *report.mutable_pipeline() = *root_;
+  return report;
+}
+/* static */ HloPassMetrics* HloPassMetricsScope::Current() {
+  return current_metrics;
+}
+Status DumpHloPassReport(const HloPassReport& report, const string& directory) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory));
+  string json;
+  tensorflow::protobuf::util::JsonPrintOptions options;
+  options.add_whitespace = true;
+  options.always_print_primitive_fields = true;
+  const auto status =
+      tensorflow::protobuf::util::MessageToJsonString(report, &json, options);
+  if (!status.ok()) {
+    return InternalError("failed to convert HLO pass report to JSON: %s",
+                         status.ToString().c_str());
+  }
+  const string filename = SanitizeFileName(tensorflow::strings::Printf(
+      "module_%04lld.%s.%s.pass_metrics.json",
+      static_cast<long long>(report.module_id()),  // NOLINT
+      report.module_name().c_str(), report.pipeline().name().c_str()));
+  const string path = tensorflow::io::JoinPath(directory, filename);
+  VLOG(1) << "Writing HLO pass metrics to " << path;
+  return tensorflow::WriteStringToFile(env, path, json);
+}
+}  // namespace xla
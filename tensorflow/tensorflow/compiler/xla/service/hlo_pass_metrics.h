@@ -0,0 +1,64 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_PASS_METRICS_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_PASS_METRICS_H_
+#include <memory>
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_metrics.pb.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+namespace xla {
+/**
+ * Records the `HloPassMetrics` of one pass invocation for as long as it is in
+ * scope.
+ *
+ * Metrics are recorded into a tree with one tree per thread.  A scope
+ * constructed while another scope is active on the same thread appends its
+ * node to the active node and becomes the active scope itself, so nested
+ * pipelines and `HloPassFix` iterations show up under the pass that ran them.
+ * If no scope is active, a scope does nothing unless it is constructed with
+ * `start_report`, in which case it becomes the root of a new report.
+ * Inactive scopes cost nothing beyond a thread-local read.
+ *
+ * Scopes must be destroyed in the reverse order of their construction.
+ */
+class HloPassMetricsScope {
+ public:
+  HloPassMetricsScope(tensorflow::StringPiece name, const HloModule& module,
+                      bool start_report = false);
+  ~HloPassMetricsScope();
+  // Records the time since construction, the module's size and 'changed'.
+  // Invocations that fail are left without these.
+  void Finish(const HloModule& module, bool changed);
+  // Whether this scope started a report, i.e. has no enclosing scope.
+  bool is_report_root() const { return root_ != nullptr; }
+  // Returns the report rooted at this scope.  Requires is_report_root().
+  HloPassReport MakeReport(const HloModule& module) const;
+  // Returns the node of the innermost active scope on this thread, or null if
+  // metrics are not being recorded.
+  static HloPassMetrics* Current();
+ private:
+  std::unique_ptr<HloPassMetrics> root_;
+  HloPassMetrics* metrics_ = nullptr;
+  HloPassMetrics* enclosing_ = nullptr;
+  uint64 start_micros_ = 0;
+  TF_DISALLOW_COPY_AND_ASSIGN(HloPassMetricsScope);
+};
+// Writes 'report' as JSON into 'directory', in a file named after the module
+// and pipeline.
+Status DumpHloPassReport(const HloPassReport& report, const string& directory);
+}  // namespace xla
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_HLO_PASS_METRICS_H_
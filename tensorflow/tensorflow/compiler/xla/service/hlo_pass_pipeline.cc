@@ -14,6 +14,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_pass_pipeline.h"
 #include <functional>
 #include "tensorflow/compiler/xla/service/hlo_graph_dumper.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_metrics.h"
 #include "tensorflow/compiler/xla/service/hlo_proto_util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -21,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/flatset.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 using ::tensorflow::strings::StrAppend;
 using ::tensorflow::strings::StrCat;
@@ -52,9 +54,14 @@ void DumpModuleProto(const HloModule& module, const string& dump_to,
  * 3. If dump options is set then run `xla::anonymous_namespace{hlo_pass_pipeline.cc}::DumpModuleProto` to save module to file.
  * 4. For each pass
  *   1. `xla::anonymous_namespace{hlo_pass_pipeline.cc}::DumpModuleGraph`
- *   2. Run the pass
+ *   2. Run the pass, on the pipeline's thread pool if it is an
+ *      `xla::HloComputationPass` and `--xla_hlo_pass_threads` is above 1
  *   3. `xla::anonymous_namespace{hlo_pass_pipeline.cc}::DumpModuleProto` if dump proto per pass is set
  * 5. `xla::anonymous_namespace{hlo_pass_pipeline.cc}::DumpModuleGraph`
+ *
+ * Each pass is run inside an `xla::HloPassMetricsScope`.  If this is the
+ * outermost pipeline and `--xla_dump_hlo_pass_metrics_to` is set, the metrics
+ * of the whole run are written there as an `xla::HloPassReport`.
  */
 StatusOr<bool> HloPassPipeline::Run(HloModule* module) {
   run_called_ = true;
@@ -92,11 +99,31 @@ StatusOr<bool> HloPassPipeline::Run(HloModule* module) {
       run_invariant_checkers(StrCat("before running pipeline: ", name())));
   const string xla_dump_per_pass_hlo_proto_to =
       module->config().debug_options().xla_dump_per_pass_hlo_proto_to();
+  const int64 hlo_pass_threads =
+      module->config().debug_options().xla_hlo_pass_threads();
+  if (hlo_pass_threads > 1 &&
+      (thread_pool_ == nullptr ||
+       thread_pool_->NumThreads() != hlo_pass_threads)) {
+    thread_pool_ = MakeUnique<tensorflow::thread::ThreadPool>(
+        tensorflow::Env::Default(), "hlo_pass_pipeline", hlo_pass_threads);
+  }
+  tensorflow::thread::ThreadPool* thread_pool =
+      hlo_pass_threads > 1 ? thread_pool_.get() : nullptr;
   if (!xla_dump_per_pass_hlo_proto_to.empty()) {
     DumpModuleProto(*module, xla_dump_per_pass_hlo_proto_to, name().ToString(),
                     "pipeline_start");
   }
-  for (auto& pass : passes_) {
+  // A nested pipeline records into the scope its caller opened for it.
+  const string& xla_dump_hlo_pass_metrics_to =
+      module->config().debug_options().xla_dump_hlo_pass_metrics_to();
+  std::unique_ptr<HloPassMetricsScope> report_metrics;
+  if (!xla_dump_hlo_pass_metrics_to.empty() &&
+      HloPassMetricsScope::Current() == nullptr) {
+    report_metrics = MakeUnique<HloPassMetricsScope>(name(), *module,
+                                                     /*start_report=*/true);
+  }
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    HloPassInterface* pass = passes_[i].get();
     if (disabled_passes.count(pass->name().ToString()) > 0) {
       VLOG(1) << "  Skipping HLO pass " << pass->name()
               << ", disabled by --xla_disable_hlo_passes";
@@ -107,7 +134,12 @@ StatusOr<bool> HloPassPipeline::Run(HloModule* module) {
     message.clear();
     StrAppend(&message, prefix, ", before ", pass->name());
     DumpModuleGraph(*module, message);
+    if (computation_passes_[i] != nullptr) {
+      computation_passes_[i]->set_thread_pool(thread_pool);
+    }
+    HloPassMetricsScope pass_metrics(pass->name(), *module);
     TF_ASSIGN_OR_RETURN(bool changed_this_pass, pass->Run(module));
+    pass_metrics.Finish(*module, changed_this_pass);
     TF_RETURN_IF_ERROR(
         run_invariant_checkers(StrCat("after running pass: ", pass->name())));
     if (!xla_dump_per_pass_hlo_proto_to.empty()) {
@@ -119,6 +151,15 @@ StatusOr<bool> HloPassPipeline::Run(HloModule* module) {
     StrAppend(&prefix, name(), ": after ", pass->name());
   }
   DumpModuleGraph(*module, prefix + ", pipeline end");
+  if (report_metrics != nullptr) {
+    report_metrics->Finish(*module, changed);
+    Status status = DumpHloPassReport(report_metrics->MakeReport(*module),
+                                      xla_dump_hlo_pass_metrics_to);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to write HLO pass metrics of pipeline "
+                   << name() << ": " << status;
+    }
+  }
   return changed;
 }
 }  // namespace xla
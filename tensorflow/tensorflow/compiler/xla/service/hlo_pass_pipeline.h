@@ -18,10 +18,12 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include "tensorflow/compiler/xla/ptr_util.h"
+#include "tensorflow/compiler/xla/service/hlo_computation_pass.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 namespace xla {
 /**
@@ -45,6 +47,7 @@ class HloPassPipeline : public HloPassInterface {
     CHECK(!run_called_) << "AddPass cannot be called after Run";
     auto pass = new T(std::forward<Args>(args)...);
     passes_.push_back(std::unique_ptr<T>(pass));
+    computation_passes_.push_back(AsComputationPass(pass));
     return *pass;
   }
 	/**
@@ -61,10 +64,26 @@ class HloPassPipeline : public HloPassInterface {
     return *pass;
   }
   // Run all passes on the given HLO module.
+  //
+  // If the module's `xla_hlo_pass_threads` debug option is greater than 1,
+  // computation-local passes (subclasses of `xla::HloComputationPass`) visit
+  // independent computations concurrently on that many threads.
   StatusOr<bool> Run(HloModule* module) override;
  private:
+  // Returns 'pass' if it is computation-local, and null otherwise.
+  static HloComputationPass* AsComputationPass(HloComputationPass* pass) {
+    return pass;
+  }
+  static HloComputationPass* AsComputationPass(HloPassInterface* pass) {
+    return nullptr;
+  }
   const string name_;
   std::vector<std::unique_ptr<HloPassInterface>> passes_;
+  // Parallel to passes_: the computation-local view of each pass, or null.
+  std::vector<HloComputationPass*> computation_passes_;
+  // Threads for computation-local passes, created by the first Run that asks
+  // for them and reused by later runs (e.g. under HloPassFix).
+  std::unique_ptr<tensorflow::thread::ThreadPool> thread_pool_;
   std::vector<std::unique_ptr<HloPassInterface>> invariant_checkers_;
   bool run_called_ = false;
   TF_DISALLOW_COPY_AND_ASSIGN(HloPassPipeline);
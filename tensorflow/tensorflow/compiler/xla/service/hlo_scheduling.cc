@@ -17,7 +17,11 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_scheduling.h"
 
+#include <algorithm>
+#include <deque>
 #include <map>
+#include <set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -61,6 +65,28 @@ StatusOr<int64> MinimumMemoryForSequence(
   return result.heap_size;
 }
 
+StatusOr<int64> PackedMemoryForSequence(
+    const SequentialHloOrdering::HloModuleSequence& module_sequence,
+    const LogicalBuffer::SizeFunction& size_function, int64 alignment) {
+  if (module_sequence.empty()) {
+    return 0;
+  }
+
+  const HloModule* module = module_sequence.begin()->first->parent();
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<TuplePointsToAnalysis> points_to_analysis,
+                      TuplePointsToAnalysis::Run(module));
+
+  // Pack the buffers the way buffer assignment does, so that the result is
+  // the size of the temporary allocation this sequence would actually need.
+  TF_ASSIGN_OR_RETURN(
+      HeapSimulator::Result result,
+      HeapSimulator::Run(MakeUnique<DecreasingSizeRunsHeap>(
+                             MakeUnique<LazyBestFitHeap>(alignment)),
+                         *module, module_sequence, *points_to_analysis,
+                         size_function));
+  return result.heap_size;
+}
+
 namespace {
 
 // Class implementing a list scheduler of HLO instructions which produces a
@@ -332,6 +358,314 @@ class ListScheduler {
   tensorflow::gtl::FlatSet<const HloInstruction*> scheduled_instructions_;
 };
 
+// A model of a single heap managed by a best-fit allocator, used by
+// PackedPeakScheduler to track where each live buffer would be placed.  Sizes
+// are rounded up to the alignment, so every offset stays aligned.  Freed
+// chunks are coalesced with their neighbors, and a free chunk at the end of
+// the heap is extended rather than left behind when nothing else fits.
+class BestFitHeapModel {
+ public:
+  explicit BestFitHeapModel(int64 alignment) : alignment_(alignment) {}
+
+  // Returns the size of the heap, i.e. its high-water mark so far.
+  int64 heap_size() const { return heap_size_; }
+
+  // Returns what the size of the heap would be after allocating 'size' bytes.
+  int64 HeapSizeIfAllocated(int64 size) const {
+    size = RoundUpToNearest(size, alignment_);
+    if (size == 0 || chunks_by_size_.lower_bound({size, 0}) !=
+                         chunks_by_size_.end()) {
+      return heap_size_;
+    }
+    return heap_size_ + size - TrailingFreeBytes();
+  }
+
+  // Allocates 'size' bytes and returns their offset in the heap.
+  int64 Allocate(int64 size) {
+    size = RoundUpToNearest(size, alignment_);
+    if (size == 0) {
+      return 0;
+    }
+    auto best_it = chunks_by_size_.lower_bound({size, 0});
+    if (best_it != chunks_by_size_.end()) {
+      const int64 chunk_size = best_it->first;
+      const int64 offset = best_it->second;
+      RemoveFreeChunk(offset, chunk_size);
+      if (chunk_size > size) {
+        AddFreeChunk(offset + size, chunk_size - size);
+      }
+      return offset;
+    }
+    const int64 trailing_free_bytes = TrailingFreeBytes();
+    const int64 offset = heap_size_ - trailing_free_bytes;
+    if (trailing_free_bytes > 0) {
+      RemoveFreeChunk(offset, trailing_free_bytes);
+    }
+    heap_size_ = offset + size;
+    return offset;
+  }
+
+  // Frees the 'size' bytes allocated at 'offset'.
+  void Free(int64 offset, int64 size) {
+    size = RoundUpToNearest(size, alignment_);
+    if (size == 0) {
+      return;
+    }
+    auto next_it = free_chunks_.find(offset + size);
+    if (next_it != free_chunks_.end()) {
+      const int64 next_size = next_it->second;
+      RemoveFreeChunk(offset + size, next_size);
+      size += next_size;
+    }
+    auto prev_it = free_chunks_.lower_bound(offset);
+    if (prev_it != free_chunks_.begin()) {
+      --prev_it;
+      const int64 prev_offset = prev_it->first;
+      const int64 prev_size = prev_it->second;
+      if (prev_offset + prev_size == offset) {
+        RemoveFreeChunk(prev_offset, prev_size);
+        offset = prev_offset;
+        size += prev_size;
+      }
+    }
+    AddFreeChunk(offset, size);
+  }
+
+ private:
+  // Returns the size of the free chunk at the end of the heap, if any.
+  int64 TrailingFreeBytes() const {
+    if (free_chunks_.empty()) {
+      return 0;
+    }
+    auto last_it = free_chunks_.rbegin();
+    return last_it->first + last_it->second == heap_size_ ? last_it->second : 0;
+  }
+
+  void AddFreeChunk(int64 offset, int64 size) {
+    free_chunks_.emplace(offset, size);
+    chunks_by_size_.emplace(size, offset);
+  }
+
+  void RemoveFreeChunk(int64 offset, int64 size) {
+    free_chunks_.erase(offset);
+    chunks_by_size_.erase({size, offset});
+  }
+
+  const int64 alignment_;
+  int64 heap_size_ = 0;
+
+  // The free chunks below heap_size_, keyed by offset and by (size, offset).
+  // Best fit takes the smallest chunk that is large enough, and the lowest
+  // such chunk among equals.
+  std::map<int64, int64> free_chunks_;
+  std::set<std::pair<int64, int64>> chunks_by_size_;
+};
+
+// Number of ready instructions whose priority PackedPeakScheduler evaluates at
+// each step.
+constexpr size_t kReadyWindow = 64;
+
+// Class implementing a list scheduler whose objective is the peak of a packed
+// heap rather than the sum of live buffer sizes.  Scheduling an instruction
+// allocates its buffers in a BestFitHeapModel while its operands are still
+// live, then frees the buffers that have no unscheduled uses left.
+class PackedPeakScheduler {
+ public:
+  // Construct and return a sequence of the instructions of the given HLO
+  // computation which keeps the packed heap small.
+  static StatusOr<std::vector<const HloInstruction*>> Run(
+      const HloComputation& computation,
+      const TuplePointsToAnalysis& points_to_analysis,
+      const LogicalBuffer::SizeFunction& size_function, int64 alignment) {
+    PackedPeakScheduler scheduler(computation, points_to_analysis,
+                                  size_function, alignment);
+    return scheduler.CreateSchedule();
+  }
+
+ private:
+  // The scheduling priority of an instruction is first how little scheduling
+  // it grows the heap (the negated growth), then the bytes freed net of the
+  // bytes defined, then the number of users.
+  using Priority = std::tuple<int64, int64, int64>;
+
+  PackedPeakScheduler(const HloComputation& computation,
+                      const TuplePointsToAnalysis& points_to_analysis,
+                      const LogicalBuffer::SizeFunction& size_function,
+                      int64 alignment)
+      : computation_(computation),
+        points_to_analysis_(points_to_analysis),
+        size_function_(size_function),
+        heap_(alignment) {
+    // Buffer uses and unscheduled use counts are computed as in
+    // ListScheduler, including the implicit use of live-out buffers.
+    for (auto* instruction : computation.instructions()) {
+      tensorflow::gtl::FlatSet<const LogicalBuffer*> instr_uses;
+      for (auto* operand : instruction->operands()) {
+        points_to_analysis.GetPointsToSet(operand).ForEachElement(
+            [&](const ShapeIndex& /*index*/,
+                const PointsToSet::BufferList& buffers) {
+              instr_uses.insert(buffers.begin(), buffers.end());
+            });
+      }
+      buffer_uses_[instruction] = std::vector<const LogicalBuffer*>(
+          instr_uses.begin(), instr_uses.end());
+      for (auto* buffer :
+           points_to_analysis.GetBuffersDefinedByInstruction(instruction)) {
+        unscheduled_use_count_[buffer] = 0;
+      }
+    }
+    for (auto* instruction : computation.instructions()) {
+      for (const LogicalBuffer* buffer : buffer_uses_.at(instruction)) {
+        ++unscheduled_use_count_[buffer];
+      }
+    }
+    for (const LogicalBuffer* live_out_buffer :
+         points_to_analysis.GetPointsToSet(computation.root_instruction())
+             .CreateFlattenedSet()) {
+      ++unscheduled_use_count_[live_out_buffer];
+    }
+  }
+
+  static bool IgnoreBuffer(const LogicalBuffer& buffer) {
+    return ListScheduler::IgnoreInstruction(*buffer.instruction());
+  }
+
+  // Constructs the scheduling priority of the given instruction.  The growth
+  // of the heap is estimated by placing all of its buffers as one chunk.
+  Priority GetPriority(const HloInstruction* instruction) {
+    int64 bytes_defined = 0;
+    for (auto* buffer :
+         points_to_analysis_.GetBuffersDefinedByInstruction(instruction)) {
+      if (!IgnoreBuffer(*buffer)) {
+        bytes_defined += size_function_(*buffer);
+      }
+    }
+    int64 bytes_freed = 0;
+    for (const LogicalBuffer* buffer : buffer_uses_.at(instruction)) {
+      if (!IgnoreBuffer(*buffer) && unscheduled_use_count_.at(buffer) == 1) {
+        bytes_freed += size_function_(*buffer);
+      }
+    }
+    const int64 heap_growth =
+        heap_.HeapSizeIfAllocated(bytes_defined) - heap_.heap_size();
+    return Priority(-heap_growth, bytes_freed - bytes_defined,
+                    instruction->user_count());
+  }
+
+  // Releases the heap space of 'buffer', if it was allocated.
+  void Release(const LogicalBuffer* buffer) {
+    auto it = offsets_.find(buffer);
+    if (it == offsets_.end()) {
+      return;
+    }
+    heap_.Free(it->second, size_function_(*buffer));
+    offsets_.erase(it);
+  }
+
+  // Updates the heap and the unscheduled use counts for 'instruction'.
+  void ScheduleInstruction(const HloInstruction* instruction) {
+    const auto& defined_buffers =
+        points_to_analysis_.GetBuffersDefinedByInstruction(instruction);
+    for (const LogicalBuffer* buffer : defined_buffers) {
+      if (!IgnoreBuffer(*buffer)) {
+        offsets_[buffer] = heap_.Allocate(size_function_(*buffer));
+      }
+    }
+    for (const LogicalBuffer* buffer : defined_buffers) {
+      if (unscheduled_use_count_.at(buffer) == 0) {
+        Release(buffer);
+      }
+    }
+    for (const LogicalBuffer* buffer : buffer_uses_.at(instruction)) {
+      int64& count = unscheduled_use_count_[buffer];
+      CHECK_GT(count, 0);
+      if (--count == 0) {
+        Release(buffer);
+      }
+    }
+  }
+
+  std::vector<const HloInstruction*> CreateSchedule() {
+    std::vector<const HloInstruction*> schedule;
+
+    tensorflow::gtl::FlatMap<const HloInstruction*, int64>
+        unscheduled_pred_count;
+    for (auto* instruction : computation_.instructions()) {
+      for (const HloInstruction* user : instruction->users()) {
+        unscheduled_pred_count[user]++;
+      }
+      for (const HloInstruction* succ : instruction->control_successors()) {
+        unscheduled_pred_count[succ]++;
+      }
+    }
+
+    // The heap changes with every scheduled instruction, so priorities are
+    // recomputed at each step rather than kept in a sorted queue.  To keep
+    // wide graphs linear, only the kReadyWindow instructions that became ready
+    // first are considered; the others wait their turn in FIFO order.  Ties go
+    // to the instruction that became ready first.
+    std::deque<const HloInstruction*> ready;
+    for (auto* instruction : computation_.instructions()) {
+      if (unscheduled_pred_count.count(instruction) == 0) {
+        ready.push_back(instruction);
+      }
+    }
+
+    while (!ready.empty()) {
+      size_t best_index = 0;
+      Priority best_priority = GetPriority(ready[0]);
+      const size_t window = std::min(ready.size(), kReadyWindow);
+      for (size_t i = 1; i < window; ++i) {
+        Priority priority = GetPriority(ready[i]);
+        if (priority > best_priority) {
+          best_index = i;
+          best_priority = priority;
+        }
+      }
+      const HloInstruction* best = ready[best_index];
+      ready.erase(ready.begin() + best_index);
+      schedule.push_back(best);
+      ScheduleInstruction(best);
+
+      auto update_pred_count = [&](const HloInstruction* inst) {
+        int64 pred_count = --unscheduled_pred_count.at(inst);
+        CHECK_GE(pred_count, 0);
+        if (pred_count == 0) {
+          ready.push_back(inst);
+        }
+      };
+      for (const HloInstruction* user : best->users()) {
+        update_pred_count(user);
+      }
+      for (const HloInstruction* succ : best->control_successors()) {
+        update_pred_count(succ);
+      }
+    }
+    CHECK_EQ(schedule.size(), computation_.instruction_count());
+    VLOG(2) << "Packed-peak scheduler heap: "
+            << HumanReadableNumBytes(heap_.heap_size());
+
+    return schedule;
+  }
+
+  const HloComputation& computation_;
+  const TuplePointsToAnalysis& points_to_analysis_;
+  const LogicalBuffer::SizeFunction& size_function_;
+
+  // A map containing the LogicalBuffers that each instruction uses.
+  tensorflow::gtl::FlatMap<const HloInstruction*,
+                           std::vector<const LogicalBuffer*>>
+      buffer_uses_;
+
+  // A map containing the count of unscheduled HLOs which use a particular
+  // LogicalBuffer.
+  std::unordered_map<const LogicalBuffer*, int64> unscheduled_use_count_;
+
+  // The simulated heap, and the offset in it of each live buffer.
+  BestFitHeapModel heap_;
+  tensorflow::gtl::FlatMap<const LogicalBuffer*, int64> offsets_;
+};
+
 int64 SumLogicalBufferSizes(
     const TuplePointsToAnalysis::BufferDefinitionVector& buffers,
     const LogicalBuffer::SizeFunction& size_function) {
@@ -354,6 +688,20 @@ StatusOr<int64> MinimumMemoryForComputation(
   return result.heap_size;
 }
 
+StatusOr<int64> PackedMemoryForComputation(
+    const HloComputation& computation,
+    const std::vector<const HloInstruction*>& sequence,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const LogicalBuffer::SizeFunction& size_function, int64 alignment) {
+  TF_ASSIGN_OR_RETURN(
+      HeapSimulator::Result result,
+      HeapSimulator::Run(MakeUnique<DecreasingSizeRunsHeap>(
+                             MakeUnique<LazyBestFitHeap>(alignment)),
+                         computation, sequence, points_to_analysis,
+                         size_function));
+  return result.heap_size;
+}
+
 /**
  * 1. Run specified algorithm
  * 2. Run xla::DefaultMemoryScheduler
@@ -436,6 +784,14 @@ StatusOr<std::vector<const HloInstruction*>> ListMemoryScheduler(
   return ListScheduler::Run(computation, points_to_analysis, size_function);
 }
 
+StatusOr<std::vector<const HloInstruction*>> PackedPeakMemoryScheduler(
+    const HloComputation& computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const LogicalBuffer::SizeFunction& size_function, int64 alignment) {
+  return PackedPeakScheduler::Run(computation, points_to_analysis,
+                                  size_function, alignment);
+}
+
 /**
  * Try list-scheduler based ordering and DFS based ordering choose the one requires less memory and ignore framentation.
  */
@@ -479,6 +835,53 @@ StatusOr<std::vector<const HloInstruction*>> DefaultMemoryScheduler(
   }
 }
 
+/**
+ * Try the list, DFS and packed-peak schedulers, and choose the sequence whose
+ * buffers pack into the smallest aligned heap.
+ */
+MemorySchedulerAlgorithm FragmentationAwareMemoryScheduler(int64 alignment) {
+  return [alignment](const HloComputation& computation,
+                     const TuplePointsToAnalysis& points_to_analysis,
+                     const LogicalBuffer::SizeFunction& size_function)
+             -> StatusOr<std::vector<const HloInstruction*>> {
+    // As in DefaultMemoryScheduler, each computation is measured on its own,
+    // outside its callers' context.  Ties go to the earlier candidate.
+    const std::pair<const char*, MemorySchedulerAlgorithm> candidates[] = {
+        {"list", ListMemoryScheduler},
+        {"dfs", DFSMemoryScheduler},
+        {"packed-peak",
+         [alignment](const HloComputation& computation,
+                     const TuplePointsToAnalysis& points_to_analysis,
+                     const LogicalBuffer::SizeFunction& size_function) {
+           return PackedPeakMemoryScheduler(computation, points_to_analysis,
+                                            size_function, alignment);
+         }},
+    };
+    std::vector<const HloInstruction*> best_sequence;
+    const char* best_name = nullptr;
+    int64 best_memory = -1;
+    for (const auto& candidate : candidates) {
+      TF_ASSIGN_OR_RETURN(
+          std::vector<const HloInstruction*> sequence,
+          candidate.second(computation, points_to_analysis, size_function));
+      TF_ASSIGN_OR_RETURN(
+          const int64 memory,
+          PackedMemoryForComputation(computation, sequence, points_to_analysis,
+                                     size_function, alignment));
+      VLOG(2) << "Packed-memory " << candidate.first
+              << " sequence: " << HumanReadableNumBytes(memory);
+      if (best_name == nullptr || memory < best_memory) {
+        best_sequence = std::move(sequence);
+        best_name = candidate.first;
+        best_memory = memory;
+      }
+    }
+    VLOG(2) << "Chose packed-memory " << best_name
+            << " sequence: " << HumanReadableNumBytes(best_memory);
+    return best_sequence;
+  };
+}
+
 /**
  * 1. `xla::TuplePointsToAnalysis::Run`
  * 2. For each computation from created from `xla::HloModule::MakeNonfusionComputations`
@@ -36,6 +36,14 @@ StatusOr<int64> MinimumMemoryForSequence(
     const SequentialHloOrdering::HloModuleSequence& module_sequence,
     const LogicalBuffer::SizeFunction& size_function);
 
+// Returns the memory required to compute the given module sequence when its
+// buffers are packed into one heap by a best-fit allocator, with every offset
+// a multiple of 'alignment'.  Unlike MinimumMemoryForSequence this includes
+// fragmentation, and matches how buffer assignment packs temporary buffers.
+StatusOr<int64> PackedMemoryForSequence(
+    const SequentialHloOrdering::HloModuleSequence& module_sequence,
+    const LogicalBuffer::SizeFunction& size_function, int64 alignment);
+
 // A memory scheduler computes an execution sequence for the HLO instructions in
 // 'computation' that minimizes peak memory, given a points-to analysis result
 // that describes buffer aliasing, together with a target-specific size function
@@ -65,6 +73,24 @@ StatusOr<std::vector<const HloInstruction*>> DefaultMemoryScheduler(
     const TuplePointsToAnalysis& points_to_analysis,
     const LogicalBuffer::SizeFunction& size_function);
 
+// Packed-peak scheduler.  A list scheduler which places each buffer in a
+// simulated best-fit heap (honoring 'alignment') as it goes, and at each step
+// schedules the ready instruction that grows that heap the least, rather than
+// the one that minimizes the sum of live buffer sizes.  Only a bounded window
+// of the earliest ready instructions is compared at each step, so the cost
+// stays linear in the number of instructions for wide graphs.
+StatusOr<std::vector<const HloInstruction*>> PackedPeakMemoryScheduler(
+    const HloComputation& computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const LogicalBuffer::SizeFunction& size_function, int64 alignment);
+
+// Returns a scheduling algorithm which, like DefaultMemoryScheduler, runs the
+// list and DFS schedulers, and additionally the packed-peak scheduler.  The
+// candidates are compared by the size of their heap once packed with
+// 'alignment', so fragmentation is accounted for.  Backends whose buffer
+// assignment packs temporaries into one allocation should use this.
+MemorySchedulerAlgorithm FragmentationAwareMemoryScheduler(int64 alignment);
+
 /**
  * Google Docs:
  *
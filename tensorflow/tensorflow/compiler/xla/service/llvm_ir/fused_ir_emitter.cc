@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/llvm_ir/fused_ir_emitter.h"
 
 #include <functional>
+#include <utility>
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Value.h"
@@ -38,8 +39,12 @@ using llvm_ir::IrArray;
  * * Default instruction handler in FusedIrEmitter.
  * * Check whether the desired value can be found in `generated_value_cache_`.
  * * If not, call `MakeElementGenerator` to get a *IR generator* from the help of `elemental_emitter_`. Then call it with given `index` and finally fill the entry in `generated_value_cache_`.
+ * * Instructions bound by `BindGenerator` keep the generator they were bound to.
  */
 Status FusedIrEmitter::DefaultAction(HloInstruction* hlo) {
+  if (bound_instructions_.count(hlo) > 0) {
+    return Status::OK();
+  }
   generators_[hlo] =
       [=](const IrArray::Index& index) -> StatusOr<llvm::Value*> {
     if (generated_value_cache_[hlo].count(index.multidim()) > 0) {
@@ -79,6 +84,12 @@ Status FusedIrEmitter::DefaultAction(HloInstruction* hlo) {
   return Status::OK();
 }
 
+void FusedIrEmitter::BindGenerator(const HloInstruction* instruction,
+                                   Generator generator) {
+  bound_instructions_.insert(instruction);
+  generators_[instruction] = std::move(generator);
+}
+
 Status FusedIrEmitter::HandleConstant(HloInstruction* constant) {
   const Literal& literal = constant->literal();
   llvm::Constant* initializer =
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Value.h"
@@ -84,6 +85,13 @@ class FusedIrEmitter : public DfsHloVisitorWithDefault {
   // Returns the generator function for the given instruction.
   Generator GetGenerator(const HloInstruction* instruction) const;
 
+  // Makes 'generator' the generator function of 'instruction', which is then
+  // not emitted elementally when visited.  This lets a caller emit part of the
+  // fused computation by other means (e.g. the dot of an output fusion, which
+  // is written to a buffer first) and fuse the rest around it.  Must be called
+  // before the fused computation is visited.
+  void BindGenerator(const HloInstruction* instruction, Generator generator);
+
   // Returns the ir value for instruction 'hlo'.
   llvm::Value* GetIrValueForGTE(const HloInstruction* hlo) const {
     auto it = gte_values_.find(hlo);
@@ -108,6 +116,9 @@ class FusedIrEmitter : public DfsHloVisitorWithDefault {
   // outputs
   std::unordered_map<const HloInstruction*, Generator> generators_;
 
+  // Instructions whose generator was set by BindGenerator.
+  std::unordered_set<const HloInstruction*> bound_instructions_;
+
   // Cache of generated values, lest we regenerate an element of a node with
   // multiple outgoing edges
   std::unordered_map<const HloInstruction*,
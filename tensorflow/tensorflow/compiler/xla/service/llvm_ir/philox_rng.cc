@@ -0,0 +1,236 @@
+/** \file
+*/
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/llvm_ir/philox_rng.h"
+
+#include <cmath>
+#include <utility>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/llvm_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace xla {
+namespace llvm_ir {
+
+namespace {
+
+// The multipliers and key increments of Philox-4x32, as in the paper.
+constexpr uint32 kPhiloxM0 = 0xD2511F53;
+constexpr uint32 kPhiloxM1 = 0xCD9E8D57;
+constexpr uint32 kPhiloxW0 = 0x9E3779B9;
+constexpr uint32 kPhiloxW1 = 0xBB67AE85;
+constexpr int kPhiloxRounds = 10;
+
+// Returns the high and low halves of the 64-bit product of 'a' and the i32
+// 'b'.
+std::pair<llvm::Value*, llvm::Value*> MultiplyHighLow(
+    uint32 a, llvm::Value* b, llvm::IRBuilder<>* ir_builder) {
+  llvm::Value* product = ir_builder->CreateMul(
+      ir_builder->getInt64(a),
+      ir_builder->CreateZExt(b, ir_builder->getInt64Ty()));
+  return {ir_builder->CreateTrunc(ir_builder->CreateLShr(product, 32),
+                                  ir_builder->getInt32Ty()),
+          ir_builder->CreateTrunc(product, ir_builder->getInt32Ty())};
+}
+
+// Splits the i64 'value' into its low and high i32 halves.
+std::array<llvm::Value*, 2> SplitInt64(llvm::Value* value,
+                                       llvm::IRBuilder<>* ir_builder) {
+  return {ir_builder->CreateTrunc(value, ir_builder->getInt32Ty()),
+          ir_builder->CreateTrunc(ir_builder->CreateLShr(value, 32),
+                                  ir_builder->getInt32Ty())};
+}
+
+// Joins the i32 halves 'low' and 'high' into an i64.
+llvm::Value* JoinInt64(llvm::Value* low, llvm::Value* high,
+                       llvm::IRBuilder<>* ir_builder) {
+  return ir_builder->CreateOr(
+      ir_builder->CreateShl(
+          ir_builder->CreateZExt(high, ir_builder->getInt64Ty()), 32),
+      ir_builder->CreateZExt(low, ir_builder->getInt64Ty()));
+}
+
+// Returns a float or double in [0, 1) built from random i32 words: the
+// random bits fill the mantissa of a number in [1, 2), from which 1 is
+// subtracted.  A float only uses 'high'.
+llvm::Value* EmitUniformUnitInterval(llvm::Type* type, llvm::Value* low,
+                                     llvm::Value* high,
+                                     llvm::IRBuilder<>* ir_builder) {
+  llvm::Value* one_to_two;
+  if (type->isFloatTy()) {
+    one_to_two = ir_builder->CreateBitCast(
+        ir_builder->CreateOr(ir_builder->CreateLShr(high, 9),
+                             ir_builder->getInt32(0x3f800000)),
+        type);
+  } else {
+    CHECK(type->isDoubleTy());
+    one_to_two = ir_builder->CreateBitCast(
+        ir_builder->CreateOr(
+            ir_builder->CreateLShr(JoinInt64(low, high, ir_builder), 12),
+            ir_builder->getInt64(0x3ff0000000000000ULL)),
+        type);
+  }
+  return ir_builder->CreateFSub(one_to_two, llvm::ConstantFP::get(type, 1.0));
+}
+
+}  // namespace
+
+std::array<llvm::Value*, 4> EmitPhilox4x32(
+    const std::array<llvm::Value*, 4>& counter,
+    const std::array<llvm::Value*, 2>& key, llvm::IRBuilder<>* ir_builder) {
+  std::array<llvm::Value*, 4> state = counter;
+  std::array<llvm::Value*, 2> round_key = key;
+  for (int round = 0; round < kPhiloxRounds; ++round) {
+    if (round > 0) {
+      round_key[0] =
+          ir_builder->CreateAdd(round_key[0], ir_builder->getInt32(kPhiloxW0));
+      round_key[1] =
+          ir_builder->CreateAdd(round_key[1], ir_builder->getInt32(kPhiloxW1));
+    }
+    auto product0 = MultiplyHighLow(kPhiloxM0, state[0], ir_builder);
+    auto product1 = MultiplyHighLow(kPhiloxM1, state[2], ir_builder);
+    state = {ir_builder->CreateXor(
+                 ir_builder->CreateXor(product1.first, state[1]),
+                 round_key[0]),
+             product1.second,
+             ir_builder->CreateXor(
+                 ir_builder->CreateXor(product0.first, state[3]),
+                 round_key[1]),
+             product0.second};
+  }
+  return state;
+}
+
+ElementGenerator MakePhiloxRngElementGenerator(
+    const HloInstruction* rng, llvm::Value* key, llvm::Value* invocation,
+    const ElementGenerator& param0_generator,
+    const ElementGenerator& param1_generator, llvm::IRBuilder<>* ir_builder,
+    llvm::Module* module) {
+  return [=](const IrArray::Index& index) -> StatusOr<llvm::Value*> {
+    const Shape& shape = rng->shape();
+    const PrimitiveType element_type = shape.element_type();
+
+    // The counter is the element's row-major linear index together with the
+    // invocation number.
+    llvm::Value* linear_index = ir_builder->getInt64(0);
+    for (size_t i = 0; i < index.size(); ++i) {
+      linear_index = ir_builder->CreateAdd(
+          ir_builder->CreateMul(linear_index,
+                                ir_builder->getInt64(shape.dimensions(i))),
+          index[i]);
+    }
+    const std::array<llvm::Value*, 2> index_words =
+        SplitInt64(linear_index, ir_builder);
+    const std::array<llvm::Value*, 2> invocation_words =
+        SplitInt64(invocation, ir_builder);
+    const std::array<llvm::Value*, 4> bits = EmitPhilox4x32(
+        {index_words[0], index_words[1], invocation_words[0],
+         invocation_words[1]},
+        SplitInt64(key, ir_builder), ir_builder);
+
+    TF_ASSIGN_OR_RETURN(llvm::Value * param0,
+                        param0_generator(IrArray::Index()));
+    TF_ASSIGN_OR_RETURN(llvm::Value * param1,
+                        param1_generator(IrArray::Index()));
+
+    if (ShapeUtil::ElementIsFloating(shape)) {
+      // Half-precision values are drawn in single precision.
+      llvm::Type* result_type = PrimitiveTypeToIrType(element_type, module);
+      llvm::Type* compute_type =
+          element_type == F64 ? result_type
+                              : PrimitiveTypeToIrType(F32, module);
+      if (element_type != F16 && element_type != F32 && element_type != F64) {
+        return Unimplemented("kRng of %s is not implemented",
+                             PrimitiveType_Name(element_type).c_str());
+      }
+      param0 = ir_builder->CreateFPExt(param0, compute_type);
+      param1 = ir_builder->CreateFPExt(param1, compute_type);
+      llvm::Value* result;
+      switch (rng->random_distribution()) {
+        case RNG_UNIFORM: {
+          llvm::Value* unit = EmitUniformUnitInterval(compute_type, bits[0],
+                                                      bits[1], ir_builder);
+          result = ir_builder->CreateFAdd(
+              param0, ir_builder->CreateFMul(
+                          ir_builder->CreateFSub(param1, param0), unit));
+          break;
+        }
+        case RNG_NORMAL: {
+          // Box-Muller transform of two independent uniform values; the
+          // first is taken from (0, 1] so that its logarithm is finite.
+          llvm::Value* one = llvm::ConstantFP::get(compute_type, 1.0);
+          llvm::Value* u1 = ir_builder->CreateFSub(
+              one, EmitUniformUnitInterval(compute_type, bits[0], bits[1],
+                                           ir_builder));
+          llvm::Value* u2 = EmitUniformUnitInterval(compute_type, bits[2],
+                                                    bits[3], ir_builder);
+          llvm::Value* radius = EmitCallToIntrinsic(
+              llvm::Intrinsic::sqrt,
+              {ir_builder->CreateFMul(
+                  llvm::ConstantFP::get(compute_type, -2.0),
+                  EmitCallToIntrinsic(llvm::Intrinsic::log, {u1},
+                                      {compute_type}, ir_builder))},
+              {compute_type}, ir_builder);
+          llvm::Value* angle = ir_builder->CreateFMul(
+              llvm::ConstantFP::get(compute_type, 2.0 * M_PI), u2);
+          llvm::Value* normal = ir_builder->CreateFMul(
+              radius, EmitCallToIntrinsic(llvm::Intrinsic::cos, {angle},
+                                          {compute_type}, ir_builder));
+          result = ir_builder->CreateFAdd(
+              param0, ir_builder->CreateFMul(param1, normal));
+          break;
+        }
+        default:
+          return InvalidArgument(
+              "unhandled distribution %s",
+              RandomDistribution_Name(rng->random_distribution()).c_str());
+      }
+      return ir_builder->CreateFPTrunc(result, result_type);
+    }
+
+    if (ShapeUtil::ElementIsIntegral(shape) &&
+        rng->random_distribution() == RNG_UNIFORM) {
+      // Reduce 64 random bits modulo the width of [param0, param1).  The
+      // bias is negligible for ranges much smaller than 2^64.
+      llvm::Type* element_ir_type = param0->getType();
+      llvm::Value* range = ir_builder->CreateSub(param1, param0);
+      if (element_ir_type != ir_builder->getInt64Ty()) {
+        range = ir_builder->CreateZExt(range, ir_builder->getInt64Ty());
+      }
+      range = ir_builder->CreateSelect(
+          ir_builder->CreateICmpEQ(range, ir_builder->getInt64(0)),
+          ir_builder->getInt64(1), range);
+      llvm::Value* offset = ir_builder->CreateURem(
+          JoinInt64(bits[0], bits[1], ir_builder), range);
+      return ir_builder->CreateAdd(
+          param0, ir_builder->CreateTrunc(offset, element_ir_type));
+    }
+
+    return Unimplemented(
+        "kRng of %s with distribution %s is not implemented",
+        PrimitiveType_Name(element_type).c_str(),
+        RandomDistribution_Name(rng->random_distribution()).c_str());
+  };
+}
+
+}  // namespace llvm_ir
+}  // namespace xla
@@ -0,0 +1,58 @@
+/** \file
+*/
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_LLVM_IR_PHILOX_RNG_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_LLVM_IR_PHILOX_RNG_H_
+
+#include <array>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/loop_emitter.h"
+
+namespace xla {
+namespace llvm_ir {
+
+// Emits the Philox-4x32-10 bijection (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", SC'11), which maps the 128-bit 'counter' to
+// 128 random bits under the 64-bit 'key'.  All values are i32.
+std::array<llvm::Value*, 4> EmitPhilox4x32(
+    const std::array<llvm::Value*, 4>& counter,
+    const std::array<llvm::Value*, 2>& key, llvm::IRBuilder<>* ir_builder);
+
+// Returns a generator for the elements of the kRng 'rng' in which every
+// element depends only on the i64 values 'key' and 'invocation' and on its
+// own index: the index and 'invocation' form the Philox counter.  Elements can
+// therefore be generated in any order, by any number of threads, without
+// shared state.
+//
+// 'invocation' must differ between executions of 'rng' that should produce
+// different values.  'param0_generator' and 'param1_generator' produce the
+// scalar operands of 'rng' (the bounds of a uniform distribution, or the mean
+// and standard deviation of a normal one).
+ElementGenerator MakePhiloxRngElementGenerator(
+    const HloInstruction* rng, llvm::Value* key, llvm::Value* invocation,
+    const ElementGenerator& param0_generator,
+    const ElementGenerator& param1_generator, llvm::IRBuilder<>* ir_builder,
+    llvm::Module* module);
+
+}  // namespace llvm_ir
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_LLVM_IR_PHILOX_RNG_H_
@@ -0,0 +1,366 @@
+/** \file
+*/
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/llvm_ir/tiled_loop_emitter.h"
+
+#include <memory>
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/llvm_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace llvm_ir {
+
+namespace {
+
+// Returns the source index of the element at target index 'index', see the
+// TiledLoopEmitter constructor.
+IrArray::Index PermuteIndex(const IrArray::Index& index,
+                            tensorflow::gtl::ArraySlice<int64> permutation) {
+  IrArray::Index source_index(permutation.size());
+  for (size_t i = 0; i < permutation.size(); ++i) {
+    source_index[permutation[i]] = index[i];
+  }
+  return source_index;
+}
+
+// Returns a body emitter which copies the source element at the permuted index
+// to the target element.
+LoopEmitter::BodyEmitter MakeCopyBodyEmitter(
+    const IrArray& source_array, tensorflow::gtl::ArraySlice<int64> permutation,
+    const IrArray& target_array, llvm::IRBuilder<>* ir_builder) {
+  // The permutation is copied; the slice need not outlive the emitter.
+  std::vector<int64> permutation_copy(permutation.begin(), permutation.end());
+  return [=](const IrArray::Index& index) -> tensorflow::Status {
+    target_array.EmitWriteArrayElement(
+        index,
+        source_array.EmitReadArrayElement(
+            PermuteIndex(index, permutation_copy), ir_builder),
+        ir_builder);
+    return tensorflow::Status::OK();
+  };
+}
+
+}  // namespace
+
+TiledLoopEmitter::TiledLoopEmitter(
+    const ElementGenerator& target_element_generator,
+    const IrArray& target_array, int64 source_minor_dimension,
+    int64 tile_size, llvm::IRBuilder<>* ir_builder)
+    : LoopEmitter(target_element_generator, target_array, ir_builder),
+      source_minor_dimension_(source_minor_dimension),
+      target_minor_dimension_(
+          ShapeUtil::Rank(target_array.GetShape()) > 0
+              ? LayoutUtil::Minor(target_array.GetShape().layout(), 0)
+              : 0),
+      tile_size_(tile_size),
+      target_array_(target_array) {}
+
+TiledLoopEmitter::TiledLoopEmitter(
+    const IrArray& source_array,
+    tensorflow::gtl::ArraySlice<int64> permutation,
+    const IrArray& target_array, int64 tile_size, int64 vector_size,
+    llvm::IRBuilder<>* ir_builder,
+    const std::vector<std::pair<llvm::Value*, llvm::Value*>>&
+        dynamic_loop_bounds)
+    : LoopEmitter(MakeCopyBodyEmitter(source_array, permutation, target_array,
+                                      ir_builder),
+                  target_array.GetShape(), ir_builder),
+      source_minor_dimension_(
+          SourceMinorDimension(source_array.GetShape(), permutation)),
+      target_minor_dimension_(
+          ShapeUtil::Rank(target_array.GetShape()) > 0
+              ? LayoutUtil::Minor(target_array.GetShape().layout(), 0)
+              : 0),
+      tile_size_(tile_size),
+      source_array_(source_array),
+      permutation_(permutation.begin(), permutation.end()),
+      target_array_(target_array),
+      dynamic_loop_bounds_(dynamic_loop_bounds) {
+  CHECK_EQ(permutation_.size(), ShapeUtil::Rank(target_array.GetShape()));
+  // An untiled emitter is a plain LoopEmitter, which visits every element.
+  CHECK(dynamic_loop_bounds_.empty() || !IsUntiled());
+  // Blocks are transposed by a tree of shuffles, which needs a power of two.
+  if (vector_size > 1 && tile_size % vector_size == 0 &&
+      (vector_size & (vector_size - 1)) == 0) {
+    vector_size_ = vector_size;
+  }
+}
+
+/* static */ int64 TiledLoopEmitter::SourceMinorDimension(
+    const Shape& source_shape,
+    tensorflow::gtl::ArraySlice<int64> permutation) {
+  if (ShapeUtil::Rank(source_shape) == 0) {
+    return 0;
+  }
+  const int64 source_minor = LayoutUtil::Minor(source_shape.layout(), 0);
+  for (size_t i = 0; i < permutation.size(); ++i) {
+    if (permutation[i] == source_minor) {
+      return i;
+    }
+  }
+  LOG(FATAL) << "permutation does not contain dimension " << source_minor;
+}
+
+bool TiledLoopEmitter::IsUntiled() const {
+  return ShapeUtil::Rank(shape_) < 2 ||
+         source_minor_dimension_ == target_minor_dimension_ ||
+         tile_size_ <= 1;
+}
+
+llvm::Value* TiledLoopEmitter::DimensionStart(int64 dimension) const {
+  for (size_t i = 0; i < dynamic_loop_bounds_.size(); ++i) {
+    if (LayoutUtil::Major(shape_.layout(), i) == dimension) {
+      return dynamic_loop_bounds_[i].first;
+    }
+  }
+  return ir_builder_->getInt64(0);
+}
+
+llvm::Value* TiledLoopEmitter::DimensionEnd(int64 dimension) const {
+  for (size_t i = 0; i < dynamic_loop_bounds_.size(); ++i) {
+    if (LayoutUtil::Major(shape_.layout(), i) == dimension) {
+      return dynamic_loop_bounds_[i].second;
+    }
+  }
+  return ir_builder_->getInt64(shape_.dimensions(dimension));
+}
+
+IrArray::Index TiledLoopEmitter::EmitTileLoops(ForLoopNest* loop_nest) {
+  // The tile loops count the tiles from the start of each (partitioned)
+  // dimension.  Their trip counts are computed before the loop nest, which
+  // they must dominate.
+  auto tile_count = [&](int64 dimension) {
+    return ir_builder_->CreateUDiv(
+        ir_builder_->CreateNSWAdd(
+            ir_builder_->CreateNSWSub(DimensionEnd(dimension),
+                                      DimensionStart(dimension)),
+            ir_builder_->getInt64(tile_size_ - 1)),
+        ir_builder_->getInt64(tile_size_));
+  };
+  llvm::Value* source_minor_tiles = tile_count(source_minor_dimension_);
+  llvm::Value* target_minor_tiles = tile_count(target_minor_dimension_);
+
+  IrArray::Index tile_index(shape_.dimensions_size());
+  for (int64 i = 0; i < ShapeUtil::Rank(shape_); ++i) {
+    int64 dimension = LayoutUtil::Major(shape_.layout(), i);
+    if (dimension == source_minor_dimension_ ||
+        dimension == target_minor_dimension_) {
+      continue;
+    }
+    std::unique_ptr<ForLoop> loop = loop_nest->AddLoop(
+        /*suffix=*/tensorflow::strings::Printf("dim.%lld", dimension),
+        /*start_index=*/DimensionStart(dimension),
+        /*end_index=*/DimensionEnd(dimension));
+    tile_index[dimension] = loop->GetIndVarValue();
+  }
+  // Tiles are visited with the target's minor-most dimension innermost, so
+  // that consecutive tiles continue the same target rows.
+  std::unique_ptr<ForLoop> source_minor_loop = loop_nest->AddLoop(
+      "tile.source_minor", ir_builder_->getInt64(0), source_minor_tiles);
+  std::unique_ptr<ForLoop> target_minor_loop = loop_nest->AddLoop(
+      "tile.target_minor", ir_builder_->getInt64(0), target_minor_tiles);
+  SetToFirstInsertPoint(loop_nest->GetInnerLoopBodyBasicBlock(), ir_builder_);
+  auto tile_origin = [&](int64 dimension, ForLoop* loop) {
+    return ir_builder_->CreateNSWAdd(
+        DimensionStart(dimension),
+        ir_builder_->CreateNSWMul(loop->GetIndVarValue(),
+                                  ir_builder_->getInt64(tile_size_)));
+  };
+  tile_index[source_minor_dimension_] =
+      tile_origin(source_minor_dimension_, source_minor_loop.get());
+  tile_index[target_minor_dimension_] =
+      tile_origin(target_minor_dimension_, target_minor_loop.get());
+  return tile_index;
+}
+
+IrArray::Index TiledLoopEmitter::EmitElementLoops(
+    const IrArray::Index& tile_index, tensorflow::StringPiece loop_name) {
+  // Both bounds are computed before either loop is emitted, so that they
+  // dominate the loops.
+  auto tile_end = [&](int64 dimension) {
+    llvm::Value* end = ir_builder_->CreateNSWAdd(
+        tile_index[dimension], ir_builder_->getInt64(tile_size_));
+    llvm::Value* size = DimensionEnd(dimension);
+    return ir_builder_->CreateSelect(ir_builder_->CreateICmpULT(end, size),
+                                     end, size);
+  };
+  llvm::Value* source_minor_end = tile_end(source_minor_dimension_);
+  llvm::Value* target_minor_end = tile_end(target_minor_dimension_);
+
+  ForLoopNest loop_nest(loop_name, ir_builder_);
+  IrArray::Index index = tile_index;
+  std::unique_ptr<ForLoop> source_minor_loop =
+      loop_nest.AddLoop("source_minor", tile_index[source_minor_dimension_],
+                        source_minor_end);
+  index[source_minor_dimension_] = source_minor_loop->GetIndVarValue();
+  std::unique_ptr<ForLoop> target_minor_loop =
+      loop_nest.AddLoop("target_minor", tile_index[target_minor_dimension_],
+                        target_minor_end);
+  index[target_minor_dimension_] = target_minor_loop->GetIndVarValue();
+  SetToFirstInsertPoint(loop_nest.GetInnerLoopBodyBasicBlock(), ir_builder_);
+  return index;
+}
+
+IrArray::Index TiledLoopEmitter::OffsetIndex(
+    const IrArray::Index& index, llvm::Value* source_minor_offset,
+    llvm::Value* target_minor_offset) const {
+  IrArray::Index offset_index(index.size());
+  for (size_t i = 0; i < index.size(); ++i) {
+    offset_index[i] = index[i];
+  }
+  offset_index[source_minor_dimension_] = ir_builder_->CreateNSWAdd(
+      index[source_minor_dimension_], source_minor_offset);
+  offset_index[target_minor_dimension_] = ir_builder_->CreateNSWAdd(
+      index[target_minor_dimension_], target_minor_offset);
+  return offset_index;
+}
+
+/**
+ * Row r of a block holds the elements at target-minor offset r, which are
+ * contiguous in the source, and column c the elements at source-minor offset
+ * c, which are contiguous in the target.  The rows are loaded as vectors and
+ * concatenated into one vector of vector_size * vector_size elements by a tree
+ * of shuffles; each column is then one more shuffle out of it, which LLVM
+ * lowers to the target's unpack and permute instructions.
+ */
+void TiledLoopEmitter::EmitVectorizedTile(const IrArray::Index& tile_index) {
+  ForLoopNest block_loops("vector_block", ir_builder_);
+  std::unique_ptr<ForLoop> source_minor_loop = block_loops.AddLoop(
+      /*start_index=*/0, /*end_index=*/tile_size_, /*stride=*/vector_size_,
+      /*suffix=*/"source_minor");
+  std::unique_ptr<ForLoop> target_minor_loop = block_loops.AddLoop(
+      /*start_index=*/0, /*end_index=*/tile_size_, /*stride=*/vector_size_,
+      /*suffix=*/"target_minor");
+  SetToFirstInsertPoint(block_loops.GetInnerLoopBodyBasicBlock(), ir_builder_);
+  const IrArray::Index block_index =
+      OffsetIndex(tile_index, source_minor_loop->GetIndVarValue(),
+                  target_minor_loop->GetIndVarValue());
+
+  llvm::Module* module = ir_builder_->GetInsertBlock()->getModule();
+  llvm::Type* element_type =
+      PrimitiveTypeToIrType(shape_.element_type(), module);
+  llvm::Type* vector_pointer_type =
+      llvm::VectorType::get(element_type, vector_size_)->getPointerTo();
+  const int element_alignment =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape_.element_type());
+
+  std::vector<llvm::Value*> parts;
+  for (int64 row = 0; row < vector_size_; ++row) {
+    llvm::Value* address = source_array_.EmitArrayElementAddress(
+        PermuteIndex(OffsetIndex(block_index, ir_builder_->getInt64(0),
+                                 ir_builder_->getInt64(row)),
+                     permutation_),
+        ir_builder_);
+    llvm::LoadInst* load = ir_builder_->CreateAlignedLoad(
+        ir_builder_->CreateBitCast(address, vector_pointer_type),
+        element_alignment);
+    source_array_.AnnotateLoadStoreInstructionWithMetadata(load);
+    parts.push_back(load);
+  }
+  for (int64 width = vector_size_; parts.size() > 1; width *= 2) {
+    std::vector<uint32_t> concatenation(2 * width);
+    for (int64 i = 0; i < 2 * width; ++i) {
+      concatenation[i] = i;
+    }
+    std::vector<llvm::Value*> concatenated_parts;
+    for (size_t i = 0; i < parts.size(); i += 2) {
+      concatenated_parts.push_back(ir_builder_->CreateShuffleVector(
+          parts[i], parts[i + 1], concatenation));
+    }
+    parts = std::move(concatenated_parts);
+  }
+  llvm::Value* block = parts[0];
+
+  for (int64 column = 0; column < vector_size_; ++column) {
+    std::vector<uint32_t> selection(vector_size_);
+    for (int64 row = 0; row < vector_size_; ++row) {
+      selection[row] = row * vector_size_ + column;
+    }
+    llvm::Value* column_vector = ir_builder_->CreateShuffleVector(
+        block, llvm::UndefValue::get(block->getType()), selection);
+    llvm::Value* address = target_array_.EmitArrayElementAddress(
+        OffsetIndex(block_index, ir_builder_->getInt64(column),
+                    ir_builder_->getInt64(0)),
+        ir_builder_);
+    llvm::StoreInst* store = ir_builder_->CreateAlignedStore(
+        column_vector, ir_builder_->CreateBitCast(address, vector_pointer_type),
+        element_alignment);
+    target_array_.AnnotateLoadStoreInstructionWithMetadata(store);
+  }
+  SetToFirstInsertPoint(block_loops.GetOuterLoopExitBasicBlock(), ir_builder_);
+}
+
+IrArray::Index TiledLoopEmitter::EmitIndexAndSetExitBasicBlock(
+    tensorflow::StringPiece loop_name) {
+  if (IsUntiled()) {
+    return LoopEmitter::EmitIndexAndSetExitBasicBlock(loop_name);
+  }
+  ForLoopNest loop_nest(loop_name, ir_builder_);
+  const IrArray::Index tile_index = EmitTileLoops(&loop_nest);
+  exit_bb_ = loop_nest.GetOuterLoopExitBasicBlock();
+  return EmitElementLoops(tile_index,
+                          tensorflow::strings::StrCat(loop_name, ".tile"));
+}
+
+/**
+ * * Without vector blocks, emit the loop nest of
+ *   `EmitIndexAndSetExitBasicBlock` with the body emitter in its innermost
+ *   loop.
+ * * Otherwise, in the body of the tile loops, branch on whether the tile is
+ *   full: full tiles are copied by `EmitVectorizedTile`, partial tiles element
+ *   by element.
+ */
+tensorflow::Status TiledLoopEmitter::EmitLoop(
+    tensorflow::StringPiece loop_name) {
+  if (IsUntiled() || vector_size_ <= 1) {
+    return LoopEmitter::EmitLoop(loop_name);
+  }
+  ForLoopNest loop_nest(loop_name, ir_builder_);
+  const IrArray::Index tile_index = EmitTileLoops(&loop_nest);
+  exit_bb_ = loop_nest.GetOuterLoopExitBasicBlock();
+
+  auto tile_is_full = [&](int64 dimension) {
+    return ir_builder_->CreateICmpULE(
+        ir_builder_->CreateNSWAdd(tile_index[dimension],
+                                  ir_builder_->getInt64(tile_size_)),
+        DimensionEnd(dimension));
+  };
+  LlvmIfData if_full = EmitIfThenElse(
+      ir_builder_->CreateAnd(tile_is_full(source_minor_dimension_),
+                             tile_is_full(target_minor_dimension_)),
+      "full_tile", ir_builder_);
+  SetToFirstInsertPoint(if_full.true_block, ir_builder_);
+  EmitVectorizedTile(tile_index);
+  SetToFirstInsertPoint(if_full.false_block, ir_builder_);
+  const IrArray::Index index = EmitElementLoops(
+      tile_index, tensorflow::strings::StrCat(loop_name, ".partial_tile"));
+  TF_RETURN_IF_ERROR(body_emitter_(index));
+
+  ir_builder_->SetInsertPoint(exit_bb_);
+  return tensorflow::Status::OK();
+}
+
+}  // namespace llvm_ir
+}  // namespace xla
@@ -0,0 +1,144 @@
+/** \file
+*/
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_LLVM_IR_TILED_LOOP_EMITTER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_LLVM_IR_TILED_LOOP_EMITTER_H_
+
+#include <utility>
+#include <vector>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Value.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/ir_array.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/llvm_loop.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/loop_emitter.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
+
+namespace xla {
+namespace llvm_ir {
+
+// Emits a loop over every element of an array which is read from a source
+// whose minor-most dimension differs from the target's, as in a transpose or a
+// layout-changing copy.
+//
+// A plain loop nest walks one of the two contiguously and the other with a
+// large stride, touching a new cache line on every element.  This emitter
+// instead visits the source's minor-most dimension and the target's minor-most
+// dimension in square tiles of tile_size x tile_size elements, so that the
+// cache lines of both sides are reused while a tile is being visited.  All
+// other dimensions are looped over as usual, outside the tiles.
+//
+// When constructed from a source array, it additionally copies each full tile
+// in blocks of vector_size x vector_size elements: vector_size vector loads
+// along the source's minor-most dimension, a transpose in registers, and
+// vector_size vector stores along the target's.  Partial tiles at the edges
+// are copied element by element.
+/**
+ * class TiledLoopEmitter
+ */
+class TiledLoopEmitter : public LoopEmitter {
+ public:
+  // Constructs a TiledLoopEmitter which generates each element of
+  // 'target_array' with 'target_element_generator'.  The generator reads its
+  // source contiguously along dimension 'source_minor_dimension' of the
+  // target.
+  TiledLoopEmitter(const ElementGenerator& target_element_generator,
+                   const IrArray& target_array, int64 source_minor_dimension,
+                   int64 tile_size, llvm::IRBuilder<>* ir_builder);
+
+  // Constructs a TiledLoopEmitter which copies 'source_array' into
+  // 'target_array': the target element at index I is the source element at
+  // index J, where J[permutation[i]] = I[i].  The identity permutation copies
+  // between layouts, and a transpose's dimensions transpose.  Full tiles are
+  // copied in blocks of vector_size x vector_size elements if vector_size > 1
+  // and divides tile_size.
+  //
+  // If 'dynamic_loop_bounds' is not empty, only the partition of the target
+  // within them is visited, as with ParallelLoopEmitter: the i-th pair bounds
+  // the i-th most-major dimension.  Tiles are cut within the partition, so a
+  // partitioned tiled dimension only ends in a partial tile at the partition's
+  // end.
+  TiledLoopEmitter(
+      const IrArray& source_array,
+      tensorflow::gtl::ArraySlice<int64> permutation,
+      const IrArray& target_array, int64 tile_size, int64 vector_size,
+      llvm::IRBuilder<>* ir_builder,
+      const std::vector<std::pair<llvm::Value*, llvm::Value*>>&
+          dynamic_loop_bounds = {});
+
+  // Returns the dimension of a target index, for the given 'permutation' (as
+  // above), along which 'source_shape' is contiguous.
+  static int64 SourceMinorDimension(
+      const Shape& source_shape,
+      tensorflow::gtl::ArraySlice<int64> permutation);
+
+  using LoopEmitter::EmitIndexAndSetExitBasicBlock;
+
+  // Emits the tiled loop nest, with every element visited in the innermost
+  // loop body.  Full tiles are not moved in vector blocks.
+  IrArray::Index EmitIndexAndSetExitBasicBlock(
+      tensorflow::StringPiece loop_name) override;
+
+  tensorflow::Status EmitLoop(tensorflow::StringPiece loop_name = "") override;
+
+ private:
+  // Whether the tiles would be degenerate, in which case the emitter behaves
+  // like a plain LoopEmitter.
+  bool IsUntiled() const;
+
+  // Adds the loops over the untiled dimensions and over the tiles to
+  // 'loop_nest', and returns the index of the first element of the tile with
+  // the tiled dimensions set to the tile's origin.  Leaves the insert point
+  // in the innermost loop body, after the computation of the origin.
+  IrArray::Index EmitTileLoops(ForLoopNest* loop_nest);
+
+  // Emits the loops over the elements of the tile at 'tile_index', sets the
+  // insert point to the innermost loop body, and returns the element index.
+  IrArray::Index EmitElementLoops(const IrArray::Index& tile_index,
+                                  tensorflow::StringPiece loop_name);
+
+  // Emits the copy of the full tile at 'tile_index' in vector blocks.
+  void EmitVectorizedTile(const IrArray::Index& tile_index);
+
+  // Return the first and one past the last index of 'dimension' to visit.
+  llvm::Value* DimensionStart(int64 dimension) const;
+  llvm::Value* DimensionEnd(int64 dimension) const;
+
+  // Returns 'index' with the tiled dimensions offset by the given amounts.
+  IrArray::Index OffsetIndex(const IrArray::Index& index,
+                             llvm::Value* source_minor_offset,
+                             llvm::Value* target_minor_offset) const;
+
+  int64 source_minor_dimension_;
+  int64 target_minor_dimension_;
+  int64 tile_size_;
+
+  // Only set by the copy constructor form.
+  IrArray source_array_;
+  std::vector<int64> permutation_;
+  IrArray target_array_;
+  int64 vector_size_ = 1;
+
+  // Bounds of the partition of the most-major dimensions, or empty.
+  std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds_;
+};
+
+}  // namespace llvm_ir
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_LLVM_IR_TILED_LOOP_EMITTER_H_
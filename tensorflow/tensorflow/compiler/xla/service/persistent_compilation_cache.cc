@@ -0,0 +1,147 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/compiler/xla/service/persistent_compilation_cache.h"
+#include <utility>
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/protobuf.h"
+namespace xla {
+namespace {
+// Bump whenever the key material or the entry layout below changes, so that
+// entries written by older binaries are never read back.
+constexpr char kEntryMagic[] = "XLAPCC01";
+constexpr size_t kEntryMagicSize = sizeof(kEntryMagic) - 1;
+constexpr size_t kChecksumSize = 16;
+constexpr char kEntrySuffix[] = ".xla_executable";
+// Serializes 'message' with a field order that does not depend on how it was
+// built, so that equal messages always fingerprint equally.
+string SerializeDeterministically(
+    const tensorflow::protobuf::Message& message) {
+  string serialized;
+  {
+    tensorflow::protobuf::io::StringOutputStream string_stream(&serialized);
+    tensorflow::protobuf::io::CodedOutputStream output(&string_stream);
+    output.SetSerializationDeterministic(true);
+    message.SerializeToCodedStream(&output);
+  }
+  return serialized;
+}
+// Appends 'part' to 'material' with a length prefix so that adjacent parts
+// cannot run into each other.
+void AppendKeyPart(tensorflow::StringPiece part, string* material) {
+  tensorflow::strings::StrAppend(material, part.size(), ":", part, ";");
+}
+string Checksum(tensorflow::StringPiece payload) {
+  return tensorflow::strings::Printf(
+      "%016llx", static_cast<unsigned long long>(
+                     tensorflow::Fingerprint64(payload)));  // NOLINT
+}
+}  // namespace
+PersistentCompilationCache::PersistentCompilationCache(string directory)
+    : directory_(std::move(directory)) {}
+/* static */ StatusOr<string> PersistentCompilationCache::ComputeKey(
+    const HloModule& module, const Compiler& compiler,
+    perftools::gputools::StreamExecutor* executor) {
+  const HloModuleConfig& config = module.config();
+  TF_ASSIGN_OR_RETURN(string target_fingerprint,
+                      compiler.TargetFingerprint(config, executor));
+  string material;
+  AppendKeyPart(kEntryMagic, &material);
+  AppendKeyPart(executor->platform()->Name(), &material);
+  AppendKeyPart(target_fingerprint, &material);
+  AppendKeyPart(SerializeDeterministically(module.ToProto()), &material);
+  // The cache location itself does not influence code generation.
+  DebugOptions debug_options = config.debug_options();
+  debug_options.clear_xla_persistent_compilation_cache_dir();
+  AppendKeyPart(SerializeDeterministically(debug_options), &material);
+  AppendKeyPart(config.entry_computation_layout().ToString(), &material);
+  AppendKeyPart(tensorflow::strings::StrCat(
+                    config.hlo_profiling_enabled(), ",", config.seed(), ",",
+                    config.replica_count()),
+                &material);
+  const tensorflow::Fprint128 fingerprint =
+      tensorflow::Fingerprint128(material);
+  return tensorflow::strings::Printf(
+      "%016llx%016llx",
+      static_cast<unsigned long long>(fingerprint.high64),  // NOLINT
+      static_cast<unsigned long long>(fingerprint.low64));  // NOLINT
+}
+string PersistentCompilationCache::PathForKey(const string& key) const {
+  return tensorflow::io::JoinPath(
+      directory_, tensorflow::strings::StrCat(key, kEntrySuffix));
+}
+StatusOr<string> PersistentCompilationCache::LookUp(const string& key) const {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  const string path = PathForKey(key);
+  if (!env->FileExists(path).ok()) {
+    return NotFound("no persistent compilation cache entry %s", path.c_str());
+  }
+  string contents;
+  TF_RETURN_IF_ERROR(tensorflow::ReadFileToString(env, path, &contents));
+  tensorflow::StringPiece entry(contents);
+  if (!entry.starts_with(tensorflow::StringPiece(kEntryMagic,
+                                                 kEntryMagicSize))) {
+    return tensorflow::errors::DataLoss(
+        "persistent compilation cache entry ", path,
+        " was written by an incompatible version");
+  }
+  entry.remove_prefix(kEntryMagicSize);
+  if (entry.size() < kChecksumSize) {
+    return tensorflow::errors::DataLoss(
+        "persistent compilation cache entry ", path, " is truncated");
+  }
+  const tensorflow::StringPiece checksum = entry.substr(0, kChecksumSize);
+  entry.remove_prefix(kChecksumSize);
+  if (checksum != Checksum(entry)) {
+    return tensorflow::errors::DataLoss(
+        "persistent compilation cache entry ", path, " is corrupt");
+  }
+  return entry.ToString();
+}
+Status PersistentCompilationCache::Insert(const string& key,
+                                          const string& serialized) const {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory_));
+  const string path = PathForKey(key);
+  // Write under a name unique to this writer, then rename into place: readers
+  // never observe a partially written entry, and concurrent writers of the
+  // same key simply race to install equivalent contents.
+  const string temp_path = tensorflow::strings::Printf(
+      "%s.tmp.%016llx", path.c_str(),
+      static_cast<unsigned long long>(tensorflow::random::New64()));  // NOLINT
+  const string contents = tensorflow::strings::StrCat(
+      tensorflow::StringPiece(kEntryMagic, kEntryMagicSize),
+      Checksum(serialized), serialized);
+  Status status = tensorflow::WriteStringToFile(env, temp_path, contents);
+  if (status.ok()) {
+    status = env->RenameFile(temp_path, path);
+  }
+  if (!status.ok()) {
+    env->DeleteFile(temp_path).IgnoreError();
+    return status;
+  }
+  VLOG(1) << "Stored " << serialized.size()
+          << " bytes in persistent compilation cache entry " << path;
+  return Status::OK();
+}
+}  // namespace xla
@@ -0,0 +1,62 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_PERSISTENT_COMPILATION_CACHE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_PERSISTENT_COMPILATION_CACHE_H_
+#include <string>
+#include "tensorflow/compiler/xla/service/compiler.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/stream_executor_no_cuda.h"
+namespace xla {
+/**
+ * A compilation cache that outlives the process, storing serialized
+ * executables as files in a directory.
+ *
+ * Unlike `xla::CompilationCache`, which is keyed on the computation handle and
+ * is therefore only meaningful within one service instance, entries are keyed
+ * on a fingerprint of the unoptimized HLO module, the parts of its
+ * HloModuleConfig that affect code generation, and the compiler's target
+ * fingerprint (see `Compiler::TargetFingerprint`).  What is stored under a key
+ * is opaque to this class; it is produced by `Compiler::SerializeExecutable`.
+ *
+ * Entries are written to a temporary file and renamed into place, so several
+ * processes may share one directory.  Each entry carries a checksum, and
+ * corrupt entries are reported as DataLoss rather than returned.
+ */
+class PersistentCompilationCache {
+ public:
+  explicit PersistentCompilationCache(string directory);
+  // Computes the key under which an executable built from 'module' by
+  // 'compiler' for 'executor' is stored.  'module' must not have been through
+  // RunHloPasses.  Returns an error if the compiler cannot fingerprint its
+  // target, in which case the computation should not be cached.
+  static StatusOr<string> ComputeKey(
+      const HloModule& module, const Compiler& compiler,
+      perftools::gputools::StreamExecutor* executor);
+  // Returns the serialized executable stored under 'key', or a NotFound error
+  // if there is none.
+  StatusOr<string> LookUp(const string& key) const;
+  // Stores 'serialized' under 'key', replacing any existing entry.
+  Status Insert(const string& key, const string& serialized) const;
+  const string& directory() const { return directory_; }
+ private:
+  // Returns the path of the file holding the entry for 'key'.
+  string PathForKey(const string& key) const;
+  const string directory_;
+  TF_DISALLOW_COPY_AND_ASSIGN(PersistentCompilationCache);
+};
+}  // namespace xla
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_PERSISTENT_COMPILATION_CACHE_H_
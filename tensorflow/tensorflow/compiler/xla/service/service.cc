@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/session.pb.h"
 #include "tensorflow/compiler/xla/service/source_map_util.h"
 #include "tensorflow/compiler/xla/service/transfer_manager.h"
+#include "tensorflow/compiler/xla/service/xfeed_ring.h"
 #include "tensorflow/compiler/xla/shape_layout.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
@@ -464,6 +465,29 @@ StatusOr<std::shared_ptr<Executable>> Service::BuildAndCacheExecutable(
   uint64 start_micros =
       // Avoid reading the clock if we don't want timing info
       (profile != nullptr) ? tensorflow::Env::Default()->NowMicros() : 0;
+  // Executables restored from disk carry no session module, so skip the
+  // persistent cache when executions are being dumped.
+  const DebugOptions& debug_options = module_config->debug_options();
+  std::unique_ptr<PersistentCompilationCache> persistent_cache;
+  string persistent_cache_key;
+  if (!debug_options.xla_persistent_compilation_cache_dir().empty() &&
+      debug_options.xla_dump_executions_to().empty()) {
+    persistent_cache = MakeUnique<PersistentCompilationCache>(
+        debug_options.xla_persistent_compilation_cache_dir());
+    std::unique_ptr<Executable> persisted_executable =
+        LookUpPersistentCompilationCache(*persistent_cache, versioned_handle,
+                                         *module_config, backend, executor,
+                                         &persistent_cache_key);
+    if (persisted_executable != nullptr) {
+      if (profile != nullptr) {
+        uint64 end_micros = tensorflow::Env::Default()->NowMicros();
+        profile->set_compilation_cache_hit(true);
+        profile->set_compile_time_ms((end_micros - start_micros) / 1000);
+      }
+      return compilation_cache_.Insert(std::move(persisted_executable),
+                                       *module_config);
+    }
+  }
   // Take a copy of the module config, as compilation introduces layouts where
   // layouts were optional before.
   HloModuleConfig original_module_config = *module_config;
@@ -477,10 +501,68 @@ StatusOr<std::shared_ptr<Executable>> Service::BuildAndCacheExecutable(
     profile->set_compilation_cache_hit(false);
     profile->set_compile_time_ms(milliseconds);
   }
+  if (!persistent_cache_key.empty()) {
+    StatusOr<string> serialized =
+        backend->compiler()->SerializeExecutable(*executable_unique_ptr);
+    Status status = serialized.status();
+    if (status.ok()) {
+      status = persistent_cache->Insert(persistent_cache_key,
+                                        serialized.ValueOrDie());
+    }
+    if (!status.ok()) {
+      LOG(WARNING) << "Not storing " << versioned_handle.ToString()
+                   << " in the persistent compilation cache: " << status;
+    }
+  }
   // Insert executable into the cache.
   return compilation_cache_.Insert(std::move(executable_unique_ptr),
                                    original_module_config);
 }
+std::unique_ptr<Executable> Service::LookUpPersistentCompilationCache(
+    const PersistentCompilationCache& cache,
+    const VersionedComputationHandle& versioned_handle,
+    const HloModuleConfig& module_config, Backend* backend,
+    perftools::gputools::StreamExecutor* executor, string* key) {
+  key->clear();
+  // The key is computed over the unoptimized module, which is cheap to build
+  // compared to running the HLO passes and the backend.
+  StatusOr<std::unique_ptr<HloModule>> module =
+      computation_tracker_.BuildHloModule(versioned_handle, module_config,
+                                          /*include_unreachable_instructions=*/
+                                          true);
+  if (!module.ok()) {
+    VLOG(1) << "Not using the persistent compilation cache: "
+            << module.status();
+    return nullptr;
+  }
+  StatusOr<string> computed_key = PersistentCompilationCache::ComputeKey(
+      *module.ValueOrDie(), *backend->compiler(), executor);
+  if (!computed_key.ok()) {
+    VLOG(1) << "Not using the persistent compilation cache: "
+            << computed_key.status();
+    return nullptr;
+  }
+  *key = computed_key.ConsumeValueOrDie();
+  StatusOr<string> serialized = cache.LookUp(*key);
+  if (!serialized.ok()) {
+    if (serialized.status().code() != tensorflow::error::NOT_FOUND) {
+      LOG(WARNING) << "Ignoring persistent compilation cache entry " << *key
+                   << ": " << serialized.status();
+    }
+    return nullptr;
+  }
+  StatusOr<std::unique_ptr<Executable>> executable =
+      backend->compiler()->DeserializeExecutable(
+          serialized.ValueOrDie(), module_config, versioned_handle, executor);
+  if (!executable.ok()) {
+    LOG(WARNING) << "Ignoring persistent compilation cache entry " << *key
+                 << ": " << executable.status();
+    return nullptr;
+  }
+  VLOG(1) << "Loaded " << versioned_handle.ToString()
+          << " from persistent compilation cache entry " << *key;
+  return executable.ConsumeValueOrDie();
+}
 StatusOr<std::vector<GlobalDataHandle>>
 Service::ExecuteParallelAndRegisterResult(
     tensorflow::gtl::ArraySlice<Executable*> executables,
@@ -1208,6 +1290,46 @@ tensorflow::Status Service::TransferToServer(const TransferToServerRequest* arg,
                                  ShapeUtil::HumanString(shape))));
   return tensorflow::Status::OK();
 }
+namespace {
+// Enqueues 'literal' on the host infeed ring, one entry per element if it is
+// a tuple, in the order the CPU backend's infeeds dequeue them.  A tuple is
+// enqueued whole or not at all.
+tensorflow::Status EnqueueLiteralToXfeedRing(const Literal& literal,
+                                             XfeedRing* ring) {
+  const Shape& shape = literal.shape();
+  if (!ShapeUtil::IsTuple(shape)) {
+    return ring->Enqueue(literal.untyped_data(), ShapeUtil::ByteSizeOf(shape));
+  }
+  std::vector<std::pair<const void*, int64>> entries;
+  for (int64 i = 0; i < ShapeUtil::TupleElementCount(shape); ++i) {
+    const Shape& element_shape = ShapeUtil::GetTupleElementShape(shape, i);
+    if (ShapeUtil::IsTuple(element_shape)) {
+      return Unimplemented("infeed of nested tuples is not supported");
+    }
+    entries.emplace_back(literal.untyped_data({i}),
+                         ShapeUtil::ByteSizeOf(element_shape));
+  }
+  return ring->EnqueueEntries(entries);
+}
+// Dequeues the entries of 'literal' from the host outfeed ring, the inverse of
+// EnqueueLiteralToXfeedRing.
+tensorflow::Status DequeueLiteralFromXfeedRing(XfeedRing* ring,
+                                               Literal* literal) {
+  const Shape& shape = literal->shape();
+  if (!ShapeUtil::IsTuple(shape)) {
+    return ring->Dequeue(literal->untyped_data(), ShapeUtil::ByteSizeOf(shape));
+  }
+  for (int64 i = 0; i < ShapeUtil::TupleElementCount(shape); ++i) {
+    const Shape& element_shape = ShapeUtil::GetTupleElementShape(shape, i);
+    if (ShapeUtil::IsTuple(element_shape)) {
+      return Unimplemented("outfeed of nested tuples is not supported");
+    }
+    TF_RETURN_IF_ERROR(ring->Dequeue(literal->untyped_data({i}),
+                                     ShapeUtil::ByteSizeOf(element_shape)));
+  }
+  return tensorflow::Status::OK();
+}
+}  // namespace
 tensorflow::Status Service::TransferToInfeed(const TransferToInfeedRequest* arg,
                                              TransferToInfeedResponse* result) {
   const int64 replica_count = options_.number_of_replicas();
@@ -1232,6 +1354,12 @@ tensorflow::Status Service::TransferToInfeed(const TransferToInfeedRequest* arg,
   }
   TF_ASSIGN_OR_RETURN(std::unique_ptr<Literal> literal,
                       Literal::CreateFromProto(arg->literal()));
+  // If the host executables' infeeds read the xfeed rings, copy the data
+  // straight into a ring slot, with no queue handshake.
+  if (executor->platform()->id() == se::host::kHostPlatformId &&
+      XfeedRing::HostTransfersUseRings()) {
+    return EnqueueLiteralToXfeedRing(*literal, XfeedRing::HostInfeed());
+  }
   return execute_backend_->transfer_manager()->TransferLiteralToInfeed(
       executor, *literal);
 }
@@ -1256,6 +1384,15 @@ tensorflow::Status Service::TransferFromOutfeed(
         Replicas(*execute_backend_, SingleComputationDeviceHandle()));
     executor = replicas[arg->replica_id()];
   }
+  if (executor->platform()->id() == se::host::kHostPlatformId &&
+      XfeedRing::HostTransfersUseRings()) {
+    std::unique_ptr<Literal> literal =
+        Literal::CreateFromShape(arg->shape_with_layout());
+    TF_RETURN_IF_ERROR(DequeueLiteralFromXfeedRing(XfeedRing::HostOutfeed(),
+                                                   literal.get()));
+    *result->mutable_literal() = literal->ToProto();
+    return tensorflow::Status::OK();
+  }
   Literal literal;
   TF_RETURN_IF_ERROR(
       execute_backend_->transfer_manager()->TransferLiteralFromOutfeed(
@@ -30,6 +30,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_execution_profile.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/persistent_compilation_cache.h"
 #include "tensorflow/compiler/xla/service/session.pb.h"
 #include "tensorflow/compiler/xla/service/user_computation.h"
 #include "tensorflow/compiler/xla/service/versioned_computation_handle.h"
@@ -310,11 +311,26 @@ class Service : public ServiceInterface {
   // Similar to BuildExecutable, but look in the compilation cache for the
   // executable first. If the executable is not in the cache, it is built and
   // inserted into the cache.
+  //
+  // If the xla_persistent_compilation_cache_dir debug option is set, the
+  // on-disk cache in that directory is consulted after the in-memory one, and
+  // newly built executables are also written to it.
   StatusOr<std::shared_ptr<Executable>> BuildAndCacheExecutable(
       const VersionedComputationHandle& versioned_handle,
       std::unique_ptr<HloModuleConfig> module_config, Backend* backend,
       perftools::gputools::StreamExecutor* executor, ExecutionProfile* profile,
       DeviceMemoryAllocator* device_allocator = nullptr);
+  // Looks up the executable for the given computation in 'cache'.  Returns
+  // null if the cache holds no usable executable for it.  Sets '*key' to the
+  // key under which a newly built executable should be stored, or to the empty
+  // string if the computation cannot be cached persistently.  Failures are
+  // logged rather than returned: the persistent cache is only an
+  // optimization.
+  std::unique_ptr<Executable> LookUpPersistentCompilationCache(
+      const PersistentCompilationCache& cache,
+      const VersionedComputationHandle& versioned_handle,
+      const HloModuleConfig& module_config, Backend* backend,
+      perftools::gputools::StreamExecutor* executor, string* key);
   // Runs the given executable with the given arguments and register the result
   // in the allocation tracker. The handle of the result from the tracker is
   // returned. If the parameter "profile" is not null, it points to an
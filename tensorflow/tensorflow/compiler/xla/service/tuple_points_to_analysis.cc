@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/tuple_points_to_analysis.h"
 
+#include <algorithm>
+#include <functional>
 #include <ostream>
 #include <utility>
 #include <vector>
@@ -27,6 +29,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
@@ -45,6 +48,59 @@ std::ostream& operator<<(std::ostream& out, const BufferAlias& buffer_alias) {
   return out;
 }
 
+PointsToSet::Interner::Interner() {
+  empty_buffers_ = InternBuffers(BufferList());
+  empty_sources_ = InternSources(SourceSet());
+}
+
+const PointsToSet::BufferList* PointsToSet::Interner::InternBuffers(
+    const BufferList& buffers) {
+  uint64 hash = buffers.size();
+  for (const LogicalBuffer* buffer : buffers) {
+    hash = tensorflow::Hash64Combine(hash, buffer->id());
+  }
+  auto range = buffer_lists_by_hash_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (*it->second == buffers) {
+      return it->second;
+    }
+  }
+  buffer_lists_.push_back(buffers);
+  const BufferList* interned = &buffer_lists_.back();
+  buffer_lists_by_hash_.emplace(hash, interned);
+  return interned;
+}
+
+const PointsToSet::SourceSet* PointsToSet::Interner::InternSources(
+    const SourceSet& sources) {
+  // Sets do not have a canonical iteration order, so combine the hashes of
+  // their elements with an order-independent sum.
+  uint64 hash = sources.size();
+  for (HloInstruction* source : sources) {
+    hash += tensorflow::Hash64Combine(0, std::hash<HloInstruction*>()(source));
+  }
+  auto range = source_sets_by_hash_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const SourceSet& candidate = *it->second;
+    if (candidate.size() == sources.size() &&
+        std::all_of(sources.begin(), sources.end(),
+                    [&candidate](HloInstruction* source) {
+                      return candidate.count(source) != 0;
+                    })) {
+      return it->second;
+    }
+  }
+  source_sets_.push_back(sources);
+  const SourceSet* interned = &source_sets_.back();
+  source_sets_by_hash_.emplace(hash, interned);
+  return interned;
+}
+
+PointsToSet::PointsToSet(const Shape* shape, Interner* interner)
+    : interner_(interner),
+      tree_(shape,
+            Elem{interner->empty_buffers(), interner->empty_sources()}) {}
+
 bool PointsToSet::IsAmbiguous() const {
   bool ambiguous = false;
   ForEachElement(
@@ -109,17 +165,36 @@ void PointsToSet::AddPointedToBuffer(const LogicalBuffer& buffer,
   if (ContainsBufferAtIndex(buffer, index)) {
     return;
   }
-  mutable_element(index)->push_back(&buffer);
+  BufferList buffers = element(index);
+  buffers.push_back(&buffer);
+  set_element(index, buffers);
+}
+
+void PointsToSet::set_element(const ShapeIndex& index,
+                              const BufferList& buffers) {
+  tree_.mutable_element(index)->buffers = interner_->InternBuffers(buffers);
+}
+
+void PointsToSet::CopyElement(const ShapeIndex& index, const PointsToSet& src,
+                              const ShapeIndex& src_index) {
+  DCHECK_EQ(interner_, src.interner_);
+  *tree_.mutable_element(index) = src.tree_.element(src_index);
 }
 
 const PointsToSet::SourceSet& PointsToSet::tuple_sources(
     const ShapeIndex& index) const {
-  return tree_.element(index).tuple_sources;
+  return *tree_.element(index).tuple_sources;
 }
 
 void PointsToSet::add_tuple_source(const ShapeIndex& index,
                                    HloInstruction* tuple) {
-  tree_.mutable_element(index)->tuple_sources.insert(tuple);
+  Elem* elem = tree_.mutable_element(index);
+  if (elem->tuple_sources->count(tuple) != 0) {
+    return;
+  }
+  SourceSet tuple_sources = *elem->tuple_sources;
+  tuple_sources.insert(tuple);
+  elem->tuple_sources = interner_->InternSources(tuple_sources);
 }
 
 namespace {
@@ -180,6 +255,9 @@ Status TuplePointsToAnalysis::Analyze() {
         PopulateDefinedBuffersAndAliases(instruction->fused_instructions()));
   }
 
+  VLOG(2) << "Points-to analysis of " << module_->name() << " interned "
+          << interner_.num_buffer_lists() << " buffer lists and "
+          << interner_.num_source_sets() << " tuple source sets";
   XLA_VLOG_LINES(3, ToString());
 
   return Status::OK();
@@ -211,11 +289,14 @@ Status TuplePointsToAnalysis::DefaultAction(HloInstruction* hlo_instruction) {
   // contains a single element LogicalBuffer(hlo_instruction, i). This indicates
   // that this instruction is the source of all buffers in its own output.
   PointsToSet& points_to_set = CreateEmptyPointsToSet(hlo_instruction);
-  points_to_set.ForEachMutableElement(
-      [this, hlo_instruction](const ShapeIndex& index,
-                              PointsToSet::BufferList* buffers) {
-        buffers->push_back(
-            &logical_buffer_analysis_->GetBuffer(hlo_instruction, index));
+  ShapeUtil::ForEachSubshape(
+      hlo_instruction->shape(),
+      [this, hlo_instruction, &points_to_set](const Shape& /*subshape*/,
+                                              const ShapeIndex& index) {
+        points_to_set.set_element(
+            index, PointsToSet::BufferList(
+                       {&logical_buffer_analysis_->GetBuffer(hlo_instruction,
+                                                             index)}));
       });
 
   if (ShapeUtil::IsTuple(hlo_instruction->shape())) {
@@ -239,9 +320,9 @@ Status TuplePointsToAnalysis::HandleGetTupleElement(
 
   // Copy the points-to set (and tuple sources) at index {element_index} of the
   // operand to the points-to set for this GetTupleElement instruction.
-  points_to_set.ForEachMutableElement(
-      [&, this](const ShapeIndex& target_index,
-                PointsToSet::BufferList* points_to) {
+  ShapeUtil::ForEachSubshape(
+      get_tuple_element->shape(),
+      [&](const Shape& /*subshape*/, const ShapeIndex& target_index) {
         // Construct an index into the operand by prepending element_index to
         // the index for the GetTupleElement instruction's points-to set.
         ShapeIndex src_index;
@@ -250,11 +331,8 @@ Status TuplePointsToAnalysis::HandleGetTupleElement(
           src_index.push_back(element);
         }
 
-        *points_to = operand_points_to_set.element(src_index);
-        for (HloInstruction* tuple :
-             operand_points_to_set.tuple_sources(src_index)) {
-          points_to_set.add_tuple_source(target_index, tuple);
-        }
+        points_to_set.CopyElement(target_index, operand_points_to_set,
+                                  src_index);
       });
 
   return Status::OK();
@@ -265,10 +343,10 @@ Status TuplePointsToAnalysis::HandleCopy(HloInstruction* copy) {
   // buffer (index={}) is newly created, but all other buffers (in the case of a
   // tuple shape) come from the operand
   PointsToSet& points_to_set = CreateCopiedPointsToSet(copy, copy->operand(0));
-  points_to_set.mutable_element(/*index=*/{})->clear();
-  points_to_set.AddPointedToBuffer(
-      logical_buffer_analysis_->GetBuffer(copy, /*index=*/{}),
-      /*index=*/{});
+  const LogicalBuffer* copy_buffer =
+      &logical_buffer_analysis_->GetBuffer(copy, /*index=*/{});
+  points_to_set.set_element(/*index=*/{},
+                            PointsToSet::BufferList({copy_buffer}));
 
   return Status::OK();
 }
@@ -298,18 +376,15 @@ Status TuplePointsToAnalysis::HandleRecvDone(HloInstruction* recv_done) {
       GetPointsToSet(recv_done->operand(0));
 
   // Recursively copy the points to set of the operand tuple {0}.
-  points_to_set.ForEachMutableElement(
-      [this, &points_to_set, &operand_points_to_set](
-          const ShapeIndex& index, PointsToSet::BufferList* buffers) {
+  ShapeUtil::ForEachSubshape(
+      recv_done->shape(),
+      [&points_to_set, &operand_points_to_set](const Shape& /*subshape*/,
+                                               const ShapeIndex& index) {
         ShapeIndex src_index({0});
         for (auto element : index) {
           src_index.push_back(element);
         }
-        *buffers = operand_points_to_set.element(src_index);
-        for (auto& tuple_source :
-             operand_points_to_set.tuple_sources(src_index)) {
-          points_to_set.add_tuple_source(index, tuple_source);
-        }
+        points_to_set.CopyElement(index, operand_points_to_set, src_index);
       });
   return Status::OK();
 }
@@ -319,14 +394,14 @@ Status TuplePointsToAnalysis::HandleSend(HloInstruction* send) {
   PointsToSet& points_to_set = CreateEmptyPointsToSet(send);
 
   // Creates the points to set for the tuple and its element at {1}.
-  auto top_buffer = points_to_set.mutable_element(ShapeIndex({}));
-  top_buffer->push_back(
-      &logical_buffer_analysis_->GetBuffer(send, ShapeIndex({})));
+  points_to_set.AddPointedToBuffer(
+      logical_buffer_analysis_->GetBuffer(send, ShapeIndex({})),
+      ShapeIndex({}));
   points_to_set.add_tuple_source({}, send);
 
-  auto context_buffer = points_to_set.mutable_element(ShapeIndex({1}));
-  context_buffer->push_back(
-      &logical_buffer_analysis_->GetBuffer(send, ShapeIndex({1})));
+  points_to_set.AddPointedToBuffer(
+      logical_buffer_analysis_->GetBuffer(send, ShapeIndex({1})),
+      ShapeIndex({1}));
 
   // Recursively copy the points to set of the operand to output tuple {0}.
   const PointsToSet& operand_points_to_set = GetPointsToSet(send->operand(0));
@@ -338,12 +413,8 @@ Status TuplePointsToAnalysis::HandleSend(HloInstruction* send) {
         for (auto element : src_index) {
           target_index.push_back(element);
         }
-        *points_to_set.mutable_element(target_index) = points_to;
-
-        for (HloInstruction* tuple :
-             operand_points_to_set.tuple_sources(src_index)) {
-          points_to_set.add_tuple_source(target_index, tuple);
-        }
+        points_to_set.CopyElement(target_index, operand_points_to_set,
+                                  src_index);
       });
 
   return Status::OK();
@@ -374,12 +445,8 @@ Status TuplePointsToAnalysis::HandleTuple(HloInstruction* tuple) {
             target_index.push_back(element);
           }
 
-          *points_to_set.mutable_element(target_index) = points_to;
-
-          for (HloInstruction* tuple :
-               operand_points_to_set.tuple_sources(src_index)) {
-            points_to_set.add_tuple_source(target_index, tuple);
-          }
+          points_to_set.CopyElement(target_index, operand_points_to_set,
+                                    src_index);
         });
   }
 
@@ -400,11 +467,21 @@ Status TuplePointsToAnalysis::HandleSelect(HloInstruction* select) {
   auto on_false = select->operand(2);
   PointsToSet& points_to_set = CreateCopiedPointsToSet(select, on_true);
   const PointsToSet& false_points_to_set = *PerInst(on_false)->points_to_set;
-  points_to_set.ForEachMutableElement(
-      [&](const ShapeIndex& index, PointsToSet::BufferList* buffers) {
-        for (const LogicalBuffer* false_buffer :
-             false_points_to_set.element(index)) {
-          points_to_set.AddPointedToBuffer(*false_buffer, index);
+  ShapeUtil::ForEachSubshape(
+      select->shape(),
+      [&](const Shape& /*subshape*/, const ShapeIndex& index) {
+        // Interned lists are shared, so equal sides need no merging.
+        if (&points_to_set.element(index) !=
+            &false_points_to_set.element(index)) {
+          PointsToSet::BufferList buffers = points_to_set.element(index);
+          for (const LogicalBuffer* false_buffer :
+               false_points_to_set.element(index)) {
+            if (std::find(buffers.begin(), buffers.end(), false_buffer) ==
+                buffers.end()) {
+              buffers.push_back(false_buffer);
+            }
+          }
+          points_to_set.set_element(index, buffers);
         }
 
         for (HloInstruction* tuple : false_points_to_set.tuple_sources(index)) {
@@ -414,10 +491,10 @@ Status TuplePointsToAnalysis::HandleSelect(HloInstruction* select) {
 
   // Select creates a new (top-level) buffer to store its result, so its
   // respective element in the points-to set should contain only itself.
-  points_to_set.mutable_element({})->clear();
-  points_to_set.AddPointedToBuffer(
-      logical_buffer_analysis_->GetBuffer(select, /*index=*/{}),
-      /*index=*/{});
+  const LogicalBuffer* select_buffer =
+      &logical_buffer_analysis_->GetBuffer(select, /*index=*/{});
+  points_to_set.set_element(/*index=*/{},
+                            PointsToSet::BufferList({select_buffer}));
   return Status::OK();
 }
 
@@ -431,7 +508,7 @@ PointsToSet& TuplePointsToAnalysis::CreateEmptyPointsToSet(
   PerInstruction* pi = PerInst(instruction);
   CHECK(pi->points_to_set == nullptr)
       << "instruction should not have been present in the map.";
-  auto set = MakeUnique<PointsToSet>(&instruction->shape());
+  auto set = MakeUnique<PointsToSet>(&instruction->shape(), &interner_);
   pi->points_to_set = std::move(set);
   // Return *set using the iterator returned by emplace.
   return *pi->points_to_set;
@@ -532,16 +609,14 @@ Status TuplePointsToAnalysis::GatherBuffersDefinedByInstruction(
 PointsToSet& TuplePointsToAnalysis::CreateCopiedPointsToSet(
     const HloInstruction* instruction, const HloInstruction* src) {
   // PointsToSet doesn't have a copy constructor so copy over element-by-element
-  // from src PointsToSet.
+  // from src PointsToSet.  The interned sets themselves are shared.
   PointsToSet& dst_points_to_set = CreateEmptyPointsToSet(instruction);
   const PointsToSet& src_points_to_set = GetPointsToSet(src);
-  dst_points_to_set.ForEachMutableElement(
-      [this, &dst_points_to_set, &src_points_to_set](
-          const ShapeIndex& index, PointsToSet::BufferList* buffers) {
-        *buffers = src_points_to_set.element(index);
-        for (auto& tuple_source : src_points_to_set.tuple_sources(index)) {
-          dst_points_to_set.add_tuple_source(index, tuple_source);
-        }
+  ShapeUtil::ForEachSubshape(
+      instruction->shape(),
+      [&dst_points_to_set, &src_points_to_set](const Shape& /*subshape*/,
+                                               const ShapeIndex& index) {
+        dst_points_to_set.CopyElement(index, src_points_to_set, index);
       });
   return *PerInst(instruction)->points_to_set;
 }
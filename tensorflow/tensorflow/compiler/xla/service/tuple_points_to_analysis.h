@@ -19,10 +19,12 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_TUPLE_POINTS_TO_ANALYSIS_H_
 
 #include <stddef.h>
+#include <deque>
 #include <iosfwd>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "tensorflow/compiler/xla/service/dfs_hlo_visitor_with_default.h"
@@ -50,12 +52,21 @@ namespace xla {
 // nested tuple). Each node in this tree corresponds to a single buffer in the
 // instruction's output and contains the set of Buffers which might define
 // the corresponding buffer.
+//
+// The buffer list and tuple source set of each node are interned: they are
+// immutable, owned by an Interner shared by all points-to sets of an analysis,
+// and referenced by pointer.  Equal lists are stored once, so nodes which
+// merely forward an operand's buffers (get-tuple-element, bitcast, copy,
+// tuple) cost two pointers rather than a copy of the sets.
 class PointsToSet {
  public:
+  class Interner;
+
   // Construct our ShapeTree with a pointer rather than a reference to a Shape
   // because this is very hot code, and copying (and then destroying) all these
-  // Shapes is slow.
-  explicit PointsToSet(const Shape* shape) : tree_(shape) {}
+  // Shapes is slow.  Every node starts out with no buffers and no tuple
+  // sources.  'interner' must outlive the set.
+  PointsToSet(const Shape* shape, Interner* interner);
 
   // Returns true if any points-to sets for any subshape element is not a
   // singleton.
@@ -115,38 +126,39 @@ class PointsToSet {
 
   // Return the list of logical buffers for the subshape at index.
   const BufferList& element(const ShapeIndex& index) const {
-    return tree_.element(index).buffers;
-  }
-  BufferList* mutable_element(const ShapeIndex& index) {
-    return &tree_.mutable_element(index)->buffers;
+    return *tree_.element(index).buffers;
   }
 
+  // Replaces the list of logical buffers for the subshape at index.
+  void set_element(const ShapeIndex& index, const BufferList& buffers);
+
+  // Makes the subshape at 'index' point to the buffers and tuple sources of
+  // the subshape at 'src_index' of 'src', which must use the same interner.
+  // Only the pointers to the interned sets are copied.
+  void CopyElement(const ShapeIndex& index, const PointsToSet& src,
+                   const ShapeIndex& src_index);
+
   // Call fn(index, buflist) for every subshape index.
   template <typename Fn>
   void ForEachElement(const Fn& fn) const {
     tree_.ForEachElement([&fn](const ShapeIndex& index, const Elem& elem) {
-      fn(index, elem.buffers);
-    });
-  }
-  template <typename Fn>
-  void ForEachMutableElement(const Fn& fn) {
-    tree_.ForEachMutableElement([&fn](const ShapeIndex& index, Elem* elem) {
-      fn(index, &elem->buffers);
+      fn(index, *elem.buffers);
     });
   }
   template <typename Fn>
   Status ForEachElementWithStatus(const Fn& fn) const {
     return tree_.ForEachElementWithStatus(
         [&fn](const ShapeIndex& index, const Elem& elem) {
-          return fn(index, elem.buffers);
+          return fn(index, *elem.buffers);
         });
   }
 
  private:
   struct Elem {
-    BufferList buffers;
-    SourceSet tuple_sources;
+    const BufferList* buffers;
+    const SourceSet* tuple_sources;
   };
+  Interner* interner_;
   ShapeTree<Elem> tree_;
 
   // PointsToSet contains references (const LogicalBuffer*) to elements within
@@ -154,6 +166,42 @@ class PointsToSet {
   TF_DISALLOW_COPY_AND_ASSIGN(PointsToSet);
 };
 
+// Owns the distinct buffer lists and tuple source sets referenced by the
+// points-to sets of one analysis.  Each distinct value is stored once and never
+// changes; interning an equal value again returns the same pointer.  Buffer
+// lists are equal if they hold the same buffers in the same order, tuple
+// source sets if they hold the same instructions.
+class PointsToSet::Interner {
+ public:
+  Interner();
+
+  // Returns the interned list equal to 'buffers'.
+  const BufferList* InternBuffers(const BufferList& buffers);
+
+  // Returns the interned set equal to 'sources'.
+  const SourceSet* InternSources(const SourceSet& sources);
+
+  const BufferList* empty_buffers() const { return empty_buffers_; }
+  const SourceSet* empty_sources() const { return empty_sources_; }
+
+  // Returns the number of distinct lists and sets interned so far.
+  int64 num_buffer_lists() const { return buffer_lists_.size(); }
+  int64 num_source_sets() const { return source_sets_.size(); }
+
+ private:
+  // The interned values, in deques so that their addresses stay stable, and
+  // indexed by hash.
+  std::deque<BufferList> buffer_lists_;
+  std::unordered_multimap<uint64, const BufferList*> buffer_lists_by_hash_;
+  std::deque<SourceSet> source_sets_;
+  std::unordered_multimap<uint64, const SourceSet*> source_sets_by_hash_;
+
+  const BufferList* empty_buffers_;
+  const SourceSet* empty_sources_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Interner);
+};
+
 // This class describes a particular subshape in a computation (instruction and
 // shape index) and the logical buffer which may be a source of the subshape
 // value.
@@ -321,6 +369,9 @@ class TuplePointsToAnalysis : public DfsHloVisitorWithDefault {
   // The logical buffers for this module.
   const std::unique_ptr<LogicalBufferAnalysis> logical_buffer_analysis_;
 
+  // The buffer lists and tuple source sets of all points-to sets.
+  PointsToSet::Interner interner_;
+
   // A map from instruction->unique_id() to
   std::vector<PerInstruction> per_instruction_;
 
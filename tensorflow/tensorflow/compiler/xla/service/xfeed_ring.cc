@@ -0,0 +1,284 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/xfeed_ring.h"
+
+#include <string.h>
+
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace xla {
+namespace {
+
+// Slots are aligned to a cache line, which also suits every element type.
+constexpr int64 kSlotAlignment = 64;
+
+tensorflow::mutex host_rings_mu(tensorflow::LINKER_INITIALIZED);
+
+// Published with release semantics once constructed, and never destroyed, so
+// that emitted code can read them without taking 'host_rings_mu'.
+std::atomic<XfeedRing*> host_infeed{nullptr};
+std::atomic<XfeedRing*> host_outfeed{nullptr};
+
+// How the host executables built so far consume their xfeeds.
+enum class HostXfeedMode { kUnset, kQueue, kRing };
+HostXfeedMode host_xfeed_mode GUARDED_BY(host_rings_mu) =
+    HostXfeedMode::kUnset;
+
+}  // namespace
+
+XfeedRing::XfeedRing(int64 num_slots, int64 slot_bytes)
+    : num_slots_(num_slots),
+      slot_bytes_(RoundUpToNearest(slot_bytes, kSlotAlignment)),
+      slots_(static_cast<char*>(tensorflow::port::AlignedMalloc(
+          num_slots_ * slot_bytes_, kSlotAlignment))),
+      lengths_(num_slots, 0),
+      head_(0),
+      tail_(0),
+      released_(num_slots, false),
+      waiters_(0) {
+  CHECK_GT(num_slots_, 0);
+  CHECK_GT(slot_bytes_, 0);
+  CHECK(slots_ != nullptr);
+}
+
+XfeedRing::~XfeedRing() { tensorflow::port::AlignedFree(slots_); }
+
+char* XfeedRing::SlotAddress(int64 position) const {
+  return slots_ + (position % num_slots_) * slot_bytes_;
+}
+
+void XfeedRing::WaitUntil(const std::function<bool()>& ready) {
+  tensorflow::mutex_lock lock(wait_mu_);
+  waiters_.fetch_add(1);
+  // Pairs with the fence in WakeWaiters: either this thread sees the other
+  // side's progress, or the other side sees this waiter and signals.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!ready()) {
+    wait_cv_.wait(lock);
+  }
+  waiters_.fetch_sub(1);
+}
+
+void XfeedRing::WakeWaiters() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters_.load(std::memory_order_relaxed) > 0) {
+    tensorflow::mutex_lock lock(wait_mu_);
+    wait_cv_.notify_all();
+  }
+}
+
+void* XfeedRing::NextWriteSlot() {
+  if (write_position_ - cached_tail_ == num_slots_) {
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    if (write_position_ - cached_tail_ == num_slots_) {
+      return nullptr;
+    }
+  }
+  return SlotAddress(write_position_);
+}
+
+void* XfeedRing::BeginWrite() {
+  producer_mu_.lock();
+  void* slot = NextWriteSlot();
+  if (slot == nullptr) {
+    WaitUntil([this, &slot]() { return (slot = NextWriteSlot()) != nullptr; });
+  }
+  return slot;
+}
+
+void* XfeedRing::TryBeginWrite() {
+  producer_mu_.lock();
+  void* slot = NextWriteSlot();
+  if (slot == nullptr) {
+    producer_mu_.unlock();
+  }
+  return slot;
+}
+
+void XfeedRing::Publish(int64 length) {
+  CHECK_LE(length, slot_bytes_);
+  lengths_[write_position_ % num_slots_] = length;
+  ++write_position_;
+  head_.store(write_position_, std::memory_order_release);
+}
+
+void XfeedRing::EndWrite(int64 length) {
+  Publish(length);
+  producer_mu_.unlock();
+  WakeWaiters();
+}
+
+void* XfeedRing::NextReadSlot(int64* length) {
+  if (read_position_ == cached_head_) {
+    cached_head_ = head_.load(std::memory_order_acquire);
+    if (read_position_ == cached_head_) {
+      return nullptr;
+    }
+  }
+  *length = lengths_[read_position_ % num_slots_];
+  return SlotAddress(read_position_++);
+}
+
+void* XfeedRing::BeginRead(int64* length) {
+  void* slot = TryBeginRead(length);
+  if (slot == nullptr) {
+    WaitUntil([this, &slot, length]() {
+      return (slot = TryBeginRead(length)) != nullptr;
+    });
+  }
+  return slot;
+}
+
+void* XfeedRing::TryBeginRead(int64* length) {
+  tensorflow::mutex_lock lock(consumer_mu_);
+  return NextReadSlot(length);
+}
+
+void XfeedRing::EndRead(void* slot) {
+  const int64 offset = static_cast<char*>(slot) - slots_;
+  CHECK(offset >= 0 && offset < num_slots_ * slot_bytes_ &&
+        offset % slot_bytes_ == 0)
+      << "not a slot of this ring";
+  {
+    tensorflow::mutex_lock lock(consumer_mu_);
+    released_[offset / slot_bytes_] = true;
+
+    // Only the oldest slots can be recycled; later ones wait for them.
+    int64 tail = tail_.load(std::memory_order_relaxed);
+    const int64 old_tail = tail;
+    while (tail < read_position_ && released_[tail % num_slots_]) {
+      released_[tail % num_slots_] = false;
+      ++tail;
+    }
+    if (tail == old_tail) {
+      return;
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+  WakeWaiters();
+}
+
+Status XfeedRing::Enqueue(const void* data, int64 length) {
+  return EnqueueEntries({{data, length}});
+}
+
+Status XfeedRing::EnqueueEntries(
+    const std::vector<std::pair<const void*, int64>>& entries) {
+  for (const auto& entry : entries) {
+    if (entry.second > slot_bytes_) {
+      return InvalidArgument(
+          "xfeed entry of %lld bytes does not fit in a ring slot of %lld "
+          "bytes",
+          entry.second, slot_bytes_);
+    }
+  }
+  {
+    tensorflow::mutex_lock lock(producer_mu_);
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    const int64 free_slots = num_slots_ - (write_position_ - cached_tail_);
+    if (free_slots < static_cast<int64>(entries.size())) {
+      return ResourceExhausted(
+          "xfeed ring is full: %lld entries do not fit in the %lld free of "
+          "%lld slots",
+          static_cast<int64>(entries.size()), free_slots, num_slots_);
+    }
+    for (const auto& entry : entries) {
+      memcpy(SlotAddress(write_position_), entry.first, entry.second);
+      Publish(entry.second);
+    }
+  }
+  WakeWaiters();
+  return Status::OK();
+}
+
+Status XfeedRing::Dequeue(void* data, int64 length) {
+  int64 entry_length;
+  void* slot = BeginRead(&entry_length);
+  Status status;
+  if (entry_length == length) {
+    memcpy(data, slot, length);
+  } else {
+    status = InvalidArgument(
+        "xfeed entry holds %lld bytes, but %lld were requested", entry_length,
+        length);
+  }
+  EndRead(slot);
+  return status;
+}
+
+/* static */ Status XfeedRing::ConfigureHostRings(int64 num_slots,
+                                                  int64 slot_bytes) {
+  if (num_slots <= 0 || slot_bytes <= 0) {
+    return InvalidArgument(
+        "invalid xfeed ring geometry: %lld slots of %lld bytes", num_slots,
+        slot_bytes);
+  }
+  tensorflow::mutex_lock lock(host_rings_mu);
+  XfeedRing* infeed = host_infeed.load(std::memory_order_relaxed);
+  if (infeed != nullptr) {
+    if (infeed->num_slots() != num_slots ||
+        infeed->slot_bytes() != RoundUpToNearest(slot_bytes, kSlotAlignment)) {
+      return FailedPrecondition(
+          "the host xfeed rings already have %lld slots of %lld bytes",
+          infeed->num_slots(), infeed->slot_bytes());
+    }
+    return Status::OK();
+  }
+  host_infeed.store(new XfeedRing(num_slots, slot_bytes),
+                    std::memory_order_release);
+  host_outfeed.store(new XfeedRing(num_slots, slot_bytes),
+                     std::memory_order_release);
+  return Status::OK();
+}
+
+/* static */ XfeedRing* XfeedRing::HostInfeed() {
+  return host_infeed.load(std::memory_order_acquire);
+}
+
+/* static */ XfeedRing* XfeedRing::HostOutfeed() {
+  return host_outfeed.load(std::memory_order_acquire);
+}
+
+/* static */ Status XfeedRing::RegisterHostXfeedUser(bool uses_rings) {
+  tensorflow::mutex_lock lock(host_rings_mu);
+  const HostXfeedMode mode =
+      uses_rings ? HostXfeedMode::kRing : HostXfeedMode::kQueue;
+  if (host_xfeed_mode == HostXfeedMode::kUnset) {
+    CHECK(!uses_rings ||
+          host_infeed.load(std::memory_order_relaxed) != nullptr);
+    host_xfeed_mode = mode;
+    return Status::OK();
+  }
+  if (host_xfeed_mode != mode) {
+    return FailedPrecondition(
+        "this process already runs host executables whose infeeds and "
+        "outfeeds %s the xfeed rings; executables with and without "
+        "xla_cpu_xfeed_ring_slots cannot be mixed",
+        uses_rings ? "do not use" : "use");
+  }
+  return Status::OK();
+}
+
+/* static */ bool XfeedRing::HostTransfersUseRings() {
+  tensorflow::mutex_lock lock(host_rings_mu);
+  return host_xfeed_mode == HostXfeedMode::kRing;
+}
+
+}  // namespace xla
@@ -0,0 +1,184 @@
+/** \file
+ */
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_XFEED_RING_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_XFEED_RING_H_
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace xla {
+
+/**
+ * A bounded queue of infeed or outfeed buffers for host backends.
+ *
+ * The ring owns `num_slots` buffers of `slot_bytes` each, allocated once and
+ * aligned for any element type.  Entries are written and read in place:
+ * `BeginWrite` hands the producer the next free slot and `EndWrite` publishes
+ * it; `BeginRead` hands the consumer the oldest published slot, which stays
+ * valid until it is passed to `EndRead`.  Slots may be released in any order,
+ * but are recycled in FIFO order.
+ *
+ * Producer and consumer do not share a lock.  Each side owns a cache line
+ * holding its position and a cached copy of the other side's position, so
+ * that the shared positions are only read when the cached copy runs out: the
+ * consumer takes every entry published since its last refresh as one batch,
+ * and a streaming loop that keeps the ring ahead touches no shared state on
+ * most iterations.  A side that finds the ring full (or empty) blocks on a
+ * condition variable, which the other side only signals while someone waits.
+ *
+ * Several producers, or several consumers, are serialized by a mutex per
+ * side: a producer holds its side from `BeginWrite` to `EndWrite`, while a
+ * consumer only holds it within each call, so that slots read in place by one
+ * execution do not stall another.  Concurrent consumers receive the entries in
+ * an unspecified interleaving, as with `XfeedManager`.
+ *
+ * Besides the xfeeds of host backends, rings carry the in-process channels of
+ * the CPU backend's Send and Recv.
+ */
+class XfeedRing {
+ public:
+  XfeedRing(int64 num_slots, int64 slot_bytes);
+  ~XfeedRing();
+
+  int64 num_slots() const { return num_slots_; }
+  int64 slot_bytes() const { return slot_bytes_; }
+
+  // Whether every published entry has been released.  Only meaningful while
+  // neither side is in use.
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // Waits for a free slot and returns it.  The caller is the producer until
+  // it calls EndWrite.
+  void* BeginWrite();
+
+  // Returns a free slot as BeginWrite does, or null if the ring is full.
+  void* TryBeginWrite();
+
+  // Publishes the slot returned by the last BeginWrite, holding 'length'
+  // bytes.
+  void EndWrite(int64 length);
+
+  // Waits for a published slot and returns it, setting '*length' to the
+  // number of bytes it holds.
+  void* BeginRead(int64* length);
+
+  // Returns a published slot as BeginRead does, or null if there is none.
+  void* TryBeginRead(int64* length);
+
+  // Returns 'slot', obtained from BeginRead, to the producer.
+  void EndRead(void* slot);
+
+  // Copies 'length' bytes from 'data' into the next slot.  Returns an error
+  // if they do not fit in a slot, and RESOURCE_EXHAUSTED if the ring is full:
+  // the host side never waits for the program to consume its infeeds.
+  Status Enqueue(const void* data, int64 length);
+
+  // Enqueues each (data, length) entry as Enqueue does, either all of them
+  // in consecutive slots or, if there is not room for all, none.
+  Status EnqueueEntries(
+      const std::vector<std::pair<const void*, int64>>& entries);
+
+  // Waits for the next entry, which must hold exactly 'length' bytes, and
+  // copies it into 'data'.
+  Status Dequeue(void* data, int64 length);
+
+  // Creates the process-wide infeed and outfeed rings of the host platform.
+  // Does nothing if they already exist with the same geometry, and returns an
+  // error if they exist with another one: rings are never resized, because
+  // code emitted against them may still be running.
+  static Status ConfigureHostRings(int64 num_slots, int64 slot_bytes);
+
+  // The host platform's rings, or null if ConfigureHostRings was not called.
+  static XfeedRing* HostInfeed();
+  static XfeedRing* HostOutfeed();
+
+  // Records that an executable with infeeds or outfeeds was built for the
+  // host platform, and whether its code uses the host rings or the
+  // XfeedManager queues.  A transfer request does not name the executable it
+  // is meant for, so the two cannot be in use at once: returns
+  // FailedPrecondition if an executable of the other kind was built before.
+  // Executables are not tracked individually, so the first choice holds for
+  // the life of the process.
+  static Status RegisterHostXfeedUser(bool uses_rings);
+
+  // Whether host transfers go through the rings.  If not, they go through
+  // XfeedManager as before.
+  static bool HostTransfersUseRings();
+
+ private:
+  char* SlotAddress(int64 position) const;
+
+  // Publishes the slot at write_position_, holding 'length' bytes.  The
+  // caller holds producer_mu_.
+  void Publish(int64 length);
+
+  // Return the next free or published slot, or null.  The caller holds the
+  // respective side's mutex.
+  void* NextWriteSlot();
+  void* NextReadSlot(int64* length);
+
+  // Blocks until 'ready' returns true.  'ready' is re-evaluated whenever the
+  // other side makes progress.
+  void WaitUntil(const std::function<bool()>& ready);
+
+  // Wakes the threads blocked in WaitUntil, if any.
+  void WakeWaiters();
+
+  const int64 num_slots_;
+  const int64 slot_bytes_;
+  char* const slots_;
+
+  // Number of bytes held by each slot, written by the producer before the
+  // slot is published.
+  std::vector<int64> lengths_;
+
+  // Producer state.  'head_' counts the entries ever published.
+  alignas(64) std::atomic<int64> head_;
+  int64 write_position_ = 0;
+  int64 cached_tail_ = 0;
+  tensorflow::mutex producer_mu_;
+
+  // Consumer state.  'tail_' counts the entries ever released; the consumer
+  // has handed out the entries in [tail_, read_position_).
+  alignas(64) std::atomic<int64> tail_;
+  int64 read_position_ = 0;
+  int64 cached_head_ = 0;
+  std::vector<bool> released_;
+  tensorflow::mutex consumer_mu_;
+
+  // Threads blocked on a full or empty ring.
+  alignas(64) std::atomic<int64> waiters_;
+  tensorflow::mutex wait_mu_;
+  tensorflow::condition_variable wait_cv_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(XfeedRing);
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_XFEED_RING_H_
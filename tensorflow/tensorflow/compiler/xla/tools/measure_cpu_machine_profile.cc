@@ -0,0 +1,247 @@
+/** \file
+ */
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Usage: measure_cpu_machine_profile [--output=<path>] [--bandwidth_mb=256]
+//
+// Runs a set of micro-benchmarks on the host and writes the resulting
+// xla::cpu::MachineProfile, which the CPU backend's parallel task assignment
+// loads through the --xla_cpu_machine_profile_path debug option.  Run it on an
+// otherwise idle machine of the type the profile is meant for.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/cpu/machine_profile.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace xla {
+namespace tools {
+namespace {
+
+// Number of times each benchmark is repeated; the fastest run is kept.
+constexpr int kRepetitions = 5;
+
+double NowSeconds() {
+  return tensorflow::Env::Default()->NowMicros() * 1e-6;
+}
+
+// Reads the per-core and shared data cache sizes of cpu0 from sysfs, keeping
+// the defaults in 'profile' for anything that cannot be read.
+void MeasureCaches(cpu::MachineProfile* profile) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  for (int index = 0; index < 8; ++index) {
+    const string dir = tensorflow::strings::StrCat(
+        "/sys/devices/system/cpu/cpu0/cache/index", index, "/");
+    string level, type, size;
+    if (!tensorflow::ReadFileToString(env, dir + "level", &level).ok() ||
+        !tensorflow::ReadFileToString(env, dir + "type", &type).ok() ||
+        !tensorflow::ReadFileToString(env, dir + "size", &size).ok()) {
+      break;
+    }
+    tensorflow::str_util::StripTrailingWhitespace(&level);
+    tensorflow::str_util::StripTrailingWhitespace(&type);
+    tensorflow::str_util::StripTrailingWhitespace(&size);
+    if (type == "Instruction") {
+      continue;
+    }
+    int64 scale = 1;
+    if (!size.empty() && (size.back() == 'K' || size.back() == 'M')) {
+      scale = size.back() == 'K' ? 1LL << 10 : 1LL << 20;
+      size.pop_back();
+    }
+    int64 bytes;
+    if (!tensorflow::strings::safe_strto64(size, &bytes)) {
+      continue;
+    }
+    bytes *= scale;
+    if (level == "2") {
+      profile->l2_cache_bytes = bytes;
+    } else if (level == "3") {
+      profile->l3_cache_bytes = bytes;
+    }
+  }
+}
+
+// Streams a[i] = b[i] + s * c[i] over 'n' elements starting at 'offset' and
+// returns the number of bytes moved.
+double Triad(std::vector<double>* a, const std::vector<double>& b,
+             const std::vector<double>& c, int64 offset, int64 n) {
+  const double s = 3.0;
+  double* out = a->data() + offset;
+  const double* x = b.data() + offset;
+  const double* y = c.data() + offset;
+  for (int64 i = 0; i < n; ++i) {
+    out[i] = x[i] + s * y[i];
+  }
+  return 3.0 * sizeof(double) * n;
+}
+
+// Measures streaming bandwidth of one core and of 'num_threads' cores over
+// arrays much larger than the last-level cache.
+void MeasureBandwidth(int64 bandwidth_bytes,
+                      tensorflow::thread::ThreadPool* pool, int num_threads,
+                      cpu::MachineProfile* profile) {
+  const int64 n = std::max<int64>(bandwidth_bytes / (3 * sizeof(double)),
+                                  num_threads);
+  std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+
+  double best = 0;
+  for (int rep = 0; rep < kRepetitions; ++rep) {
+    const double start = NowSeconds();
+    const double bytes = Triad(&a, b, c, 0, n);
+    best = std::max(best, bytes / (NowSeconds() - start));
+  }
+  profile->per_core_bandwidth = best;
+
+  best = 0;
+  for (int rep = 0; rep < kRepetitions; ++rep) {
+    tensorflow::BlockingCounter counter(num_threads);
+    const double start = NowSeconds();
+    for (int t = 0; t < num_threads; ++t) {
+      pool->Schedule([&, t] {
+        const int64 begin = n * t / num_threads;
+        const int64 end = n * (t + 1) / num_threads;
+        Triad(&a, b, c, begin, end - begin);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    best = std::max(best, 3.0 * sizeof(double) * n / (NowSeconds() - start));
+  }
+  profile->aggregate_bandwidth = best;
+}
+
+// Measures scalar flops with independent multiply-add chains, and the cost of
+// expf relative to one flop.
+void MeasureCompute(cpu::MachineProfile* profile) {
+  constexpr int64 kIterations = 1 << 24;
+  constexpr int kChains = 8;
+  volatile float sink = 0;
+
+  double best_flops = 0;
+  for (int rep = 0; rep < kRepetitions; ++rep) {
+    float acc[kChains];
+    for (int j = 0; j < kChains; ++j) {
+      acc[j] = 1.0f + j;
+    }
+    const double start = NowSeconds();
+    for (int64 i = 0; i < kIterations; ++i) {
+      for (int j = 0; j < kChains; ++j) {
+        acc[j] = acc[j] * 0.999999f + 1e-7f;
+      }
+    }
+    const double seconds = NowSeconds() - start;
+    for (int j = 0; j < kChains; ++j) {
+      sink = sink + acc[j];
+    }
+    best_flops = std::max(best_flops, 2.0 * kChains * kIterations / seconds);
+  }
+  profile->per_core_flops = best_flops;
+
+  double best_exp_seconds = 1e30;
+  for (int rep = 0; rep < kRepetitions; ++rep) {
+    float acc = 0;
+    const double start = NowSeconds();
+    for (int64 i = 0; i < kIterations / kChains; ++i) {
+      acc += std::exp(-static_cast<float>(i & 1023) * 1e-3f);
+    }
+    best_exp_seconds = std::min(best_exp_seconds, NowSeconds() - start);
+    sink = sink + acc;
+  }
+  const double exp_per_second = (kIterations / kChains) / best_exp_seconds;
+  profile->transcendental_cost =
+      std::max(1.0, profile->per_core_flops / exp_per_second);
+}
+
+// Measures the cost of forking and joining one empty task on 'pool'.
+void MeasureForkJoin(tensorflow::thread::ThreadPool* pool, int num_threads,
+                     cpu::MachineProfile* profile) {
+  constexpr int kRounds = 1000;
+  const int tasks = std::max(1, num_threads - 1);
+  double best = 1e30;
+  for (int rep = 0; rep < kRepetitions; ++rep) {
+    const double start = NowSeconds();
+    for (int round = 0; round < kRounds; ++round) {
+      tensorflow::BlockingCounter counter(tasks);
+      for (int t = 0; t < tasks; ++t) {
+        pool->Schedule([&counter] { counter.DecrementCount(); });
+      }
+      counter.Wait();
+    }
+    best = std::min(best, (NowSeconds() - start) / (kRounds * tasks));
+  }
+  profile->fork_join_overhead = best;
+}
+
+int RealMain(const string& output, int64 bandwidth_mb) {
+  cpu::MachineProfile profile = cpu::MachineProfile::Default();
+  const int num_threads = profile.num_cores;
+  tensorflow::thread::ThreadPool pool(tensorflow::Env::Default(),
+                                      "measure_cpu_machine_profile",
+                                      num_threads);
+  MeasureCaches(&profile);
+  MeasureBandwidth(bandwidth_mb << 20, &pool, num_threads, &profile);
+  MeasureCompute(&profile);
+  MeasureForkJoin(&pool, num_threads, &profile);
+
+  const string text = profile.ToString();
+  if (output.empty()) {
+    std::cout << text;
+    return 0;
+  }
+  TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(), output,
+                                            text));
+  LOG(INFO) << "Wrote machine profile to " << output << ":\n" << text;
+  return 0;
+}
+
+}  // namespace
+}  // namespace tools
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  string output;
+  tensorflow::int64 bandwidth_mb = 256;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("output", &output,
+                       "File to write the profile to; stdout if empty."),
+      tensorflow::Flag("bandwidth_mb", &bandwidth_mb,
+                       "Total size of the bandwidth benchmark arrays in MB. "
+                       "Should be several times the last-level cache."),
+  };
+  const string usage = tensorflow::Flags::Usage(argv[0], flag_list);
+  bool parse_ok = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parse_ok || argc != 1) {
+    LOG(QFATAL) << usage;
+  }
+  return xla::tools::RealMain(output, bandwidth_mb);
+}